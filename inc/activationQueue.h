@@ -0,0 +1,135 @@
+/*
+ * activationQueue.h
+ *
+ * The candidates of one input: the activity and resonance of every F2 node that passed the choice
+ * function, ordered on activity for match tracking.
+ */
+
+#ifndef ACTIVATIONQUEUE_H_
+#define ACTIVATIONQUEUE_H_
+
+#include <vector>
+#include <cstddef>
+#include "artTypes.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * The value "T" or actually T_j (per node) indicates the similarity between the input vector I and
+ * the weight vector of the j'th F2 memory node. A "PROTOTYPE" is a set of weights from all input
+ * nodes on F1 to a node on F2.
+ */
+struct PROTOTYPE_Activation
+{
+	// The index in F2
+	int id;
+	// The T_j value (the activity of the node)
+	// Used for adjusting the weights subsequently if needed
+	float T;
+	// The resonance value (the actual non mismatch from that node)
+	// The most active node can still be very much off (e.g. it is the only one)
+	float resonance;
+};
+
+/**
+ * Function to sort the prototypes based on their "T" activity levels (depends on the last input).
+ * As you can see the value with the highest "T" value "wins" (in the priority queue will be at
+ * the front). With equal "T" values the highest index always wins.
+ */
+struct ComparePrototype {
+	inline bool operator() (const PROTOTYPE_Activation &pt1, const PROTOTYPE_Activation &pt2) const
+	{
+		if(pt1.T == pt2.T)
+			return pt1.id < pt2.id;
+
+		return pt1.T < pt2.T;
+	}
+	inline bool operator() (const PROTOTYPE_Activation* pt1, const PROTOTYPE_Activation* pt2) const
+	{
+		return (*this)(*pt1, *pt2);
+	}
+};
+
+//! The reverse of ComparePrototype, the most active candidate comes first
+struct MoreActive {
+	inline bool operator() (const PROTOTYPE_Activation &pt1, const PROTOTYPE_Activation &pt2) const
+	{
+		return ComparePrototype()(pt2, pt1);
+	}
+};
+
+/**
+ * A priority queue on the ComparePrototype order that is cheap for the common case. Most inputs
+ * only ever look at the winner, so the candidates are not ordered when they are pushed: the first
+ * top() is a single scan for the best one. Only when match tracking pops the winner the rest is
+ * turned into a heap. The buffer is reused for every input, so after the first inputs there is no
+ * memory allocated anymore.
+ */
+class ActivationQueue
+{
+public:
+	ActivationQueue();
+
+	inline bool empty() const 						{ return d_items.empty(); }
+	inline int size() const 						{ return d_items.size(); }
+
+	//! Remove all candidates, but keep the memory
+	void clear();
+	inline void reserve(int n) 						{ d_items.reserve(n); }
+
+	inline void push(int id, float T, float resonance)
+	{
+		PROTOTYPE_Activation pa;
+		pa.id = id;
+		pa.T = T;
+		pa.resonance = resonance;
+		d_items.push_back(pa);
+		d_best = -1;
+		d_heap = false;
+	}
+
+	//! The most active candidate
+	const PROTOTYPE_Activation& top();
+
+	//! Remove the most active candidate
+	void pop();
+
+	/**
+	 * Pop candidates until the top one resonates (resonance >= vigilance), in one pass over the
+	 * candidates instead of one pop per rejected candidate. Returns false if no candidate is left.
+	 */
+	bool popUntilResonance(float vigilance);
+
+	//! Remove the candidates that are not below "last" in the ComparePrototype order
+	void keepBelow(const PROTOTYPE_Activation &last);
+
+	/**
+	 * Write the (at most) k most active candidates with a resonance of at least "vigilance" to
+	 * "out", the most active first, and return how many there are. The queue is not changed. Only
+	 * k candidates are kept in order at any time, so it costs n log k and not a sort of all of them.
+	 */
+	int selectTop(float vigilance, int k, PROTOTYPE_Activation* out) const;
+
+	//! When the caller already knows the best candidate (e.g. from merging partial scans), the scan
+	//! in top() can be skipped
+	inline void setBest(int index) 					{ d_best = index; }
+
+	//! All candidates in no particular order
+	inline const PROTOTYPE_Activation* data() const { return d_items.empty() ? NULL : &d_items[0]; }
+	inline PROTOTYPE_Activation* data() 			{ return d_items.empty() ? NULL : &d_items[0]; }
+	//! Set the number of candidates, for callers that fill data() directly
+	inline void resize(int n) 						{ d_items.resize(n); d_best = -1; d_heap = false; }
+private:
+	std::vector<PROTOTYPE_Activation> d_items;
+	//! Index of the best candidate if it is known and the items are not a heap yet
+	int d_best;
+	//! The items are a heap (with the best in front)
+	bool d_heap;
+
+	void findBest();
+};
+
+}
+
+#endif /* ACTIVATIONQUEUE_H_ */
@@ -14,50 +14,20 @@
 #define ART_H_
 
 #include <vector>
-#include <queue>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 
+#include "artTypes.h"
+#include "prototypeMatrix.h"
+#include "activationQueue.h"
+#include "artResult.h"
+#include "artContext.h"
+#include "hyperboxIndex.h"
 
-namespace almendeSensorFusion
-{
-
-/**************************************************************************************************************
- * Type definitions that make it easier to understand the code
- *
- * They are not always necessary and sometimes different typedefs are used for the same data structure to
- * tell what something really does
- *************************************************************************************************************/
-
-//! We just use floats here as individual inputs to our nodes
-typedef float ART_TYPE;
-
-//! The "prototype" corresponding to a node in F2 (long-term memory) is stored as a vector of
-//! weights from all F1 nodes to the given node.
-typedef std::vector<ART_TYPE> PROTOTYPE;
 
-//! An "aspect" is a mono-modal view of a perceivable "object" using one (sub)modality
-typedef std::vector< ART_TYPE> ART_ASPECT;
-
-//! Multiple features can also be seen as a "view" of an object using "aspects" from multiple modalities
-typedef std::vector< ART_ASPECT*> ART_VIEW;
-
-//! A class in ART is not just "1" value, it is also represented by a (distributed) vector of values
-//! For all practical purposes, it is also fine to use a vector (1,0) for one class and (0,1) for another.
-typedef std::vector< ART_TYPE> ART_DISTRIBUTED_CLASS;
-
-//! Multiple classes (each represented in a distributed manner)
-typedef std::vector< ART_DISTRIBUTED_CLASS*> ART_DISTRIBUTED_CLASSES;
-
-//! There can be multiple "views" of the same object (over time or from different directions)
-typedef std::vector< ART_VIEW*> ART_VIEWS;
-
-enum ART_COMPUTATION_TYPE
+namespace almendeSensorFusion
 {
-	DEFAULT_ARTMAP,
-	FUZZY_ARTMAP
-};
 
 /**
  * The ART network by Grossberg et al. has by default two layers, called F1 and F2. The input pattern
@@ -67,6 +37,21 @@ enum ART_COMPUTATION_TYPE
  * memory. The long-term memory are the connections between F1 and F2 in the form of the weights. The
  * weights are adjusted automatically when classifyInput() is called.
  */
+struct ArtKernels;
+class Art;
+
+/**
+ * Called when an Art network removed categories (see Art::setMemoryBudget()) with the new index of
+ * every old category, -1 for the removed ones, and the context given with the listener.
+ */
+typedef void (*ART_PRUNE_LISTENER)(void* context, const Art* art, const std::vector<int> &remap);
+
+/**
+ * Called when an Art network created a category or changed its weights, after the change, with the
+ * context given with the listener.
+ */
+typedef void (*ART_CHANGE_LISTENER)(void* context, const Art* art, int category);
+
 class Art
 {
 public:
@@ -83,12 +68,100 @@ public:
 	 */
 	ART_DISTRIBUTED_CLASS* classifyInput(ART_ASPECT &input);
 
+	/**
+	 * The same as classifyInput() above, but the output is written into "result" (which is cleared
+	 * first), so no memory is allocated once "result" is large enough. Returns false if nothing was
+	 * found (only when testing for a match).
+	 */
+	bool classifyInput(ART_ASPECT &input, ArtResult &result);
+	//! classifyInput() with the result returned by value
+	inline ArtResult classify(ART_ASPECT &input) 		{ ArtResult result; classifyInput(input, result); return result; }
+
+	/**
+	 * Classify many inputs at once without learning: the weights are not updated and no categories
+	 * are created. The inputs are a row-major nrInputs x nrFeatures matrix (before complement
+	 * coding). For every input the winning F2 node is written to "winners", or -1 if no node
+	 * resonates, and if given its resonance to "resonances". The winner is the node classifyInput()
+	 * would return with setTestMatch(true).
+	 */
+	void classifyBatch(const ART_TYPE* inputs, int nrInputs, int nrFeatures, int* winners,
+			ART_TYPE* resonances = NULL) const;
+
+	/**
+	 * Classify one input without changing the network: no learning, no new nodes and no match
+	 * tracking, the output is the one of classifyInput() with setTestMatch(true). Everything that
+	 * changes per input is kept in "context", so any number of threads can predict with the same
+	 * network at the same time, each with its own context, as long as no thread changes the
+	 * network. Returns false if no node resonates.
+	 */
+	inline bool predict(const ART_TYPE* input, int nrFeatures, ArtResult &result, ArtContext &context) const
+	{ return predict(input, nrFeatures, result, context, getBaseVigilance()); }
+	inline bool predict(const ART_ASPECT &input, ArtResult &result, ArtContext &context) const
+	{ return predict(input.empty() ? NULL : &input[0], input.size(), result, context, getBaseVigilance()); }
+	//! predict() with the given vigilance instead of the base vigilance
+	bool predict(const ART_TYPE* input, int nrFeatures, ArtResult &result, ArtContext &context, float vigilance) const;
+	inline bool predict(const ART_ASPECT &input, ArtResult &result, ArtContext &context, float vigilance) const
+	{ return predict(input.empty() ? NULL : &input[0], input.size(), result, context, vigilance); }
+
+	/**
+	 * predict() split in two, for a search over parts of F2 (see ShardedArt). predictRange() scores
+	 * only the nodes [first, last) and writes the (at most) k most active of them that resonate to
+	 * "out", the most active first. Their activity and resonance are exactly those of a search over
+	 * all nodes. predictFrom() gives the output of predict() from the candidates of all parts, that
+	 * is the same output as long as every part gave k = getDistributedOutput() candidates.
+	 */
+	int predictRange(const ART_TYPE* input, int nrFeatures, int first, int last, float vigilance, int k,
+			PROTOTYPE_Activation* out, ArtContext &context) const;
+	bool predictFrom(const PROTOTYPE_Activation* candidates, int n, float vigilance, ArtResult &result,
+			ArtContext &context) const;
+
+	/**
+	 * Make this network classify like "source": the parameters and the prototypes are copied, of
+	 * the prototypes only what changed since this was last synchronized with source (see
+	 * PrototypeMatrix::syncFrom()). The hyperbox index is not copied but turned off, predict()
+	 * finds the same nodes without it. The prune listener stays the one of this network.
+	 */
+	void syncFrom(const Art &source);
+
+	/**
+	 * Scale every input feature from [minimum, maximum] to [0, 1] (and clip it) while it is copied
+	 * into F1, so raw sensor values can go straight into classifyInput() and classifyBatch(), as
+	 * complement coding needs values in [0, 1]. The arrays have a value per feature, NULL turns the
+	 * scaling off. The range is not saved by saveArtNetwork(), only in an image.
+	 */
+	void setInputRange(const ART_TYPE* minimum, const ART_TYPE* maximum, int nrFeatures);
+	//! The input range as (x - offset) * scale per feature, empty if the inputs are not scaled
+	inline const std::vector<ART_TYPE>& getInputOffset() const 	{ return d_inputOffset; }
+	inline const std::vector<ART_TYPE>& getInputScale() const 	{ return d_inputScale; }
+
 	void addToVigilanceHistory(ART_TYPE vig);
 	void setVigilanceHistorySize(int size);
 	void saveArtNetwork(std::string fileName);
 	void loadArtNetWork(std::string fileName);
 
-	ART_TYPE getAVGVigilance();
+	/**
+	 * Save the network as a model image (see ModelImage): the parameters, the input range, the
+	 * prototype matrix as it is in memory, with the usage of the categories. Returns false if the
+	 * file cannot be written.
+	 */
+	bool saveArtNetworkImage(std::string fileName) const;
+	/**
+	 * Replace the network by the one in an image. The prototypes are not read but mapped: loading
+	 * takes the same time for any size, and processes that map the same file share its pages until
+	 * they learn. Returns false (and changes nothing) if the file is not an image of a network.
+	 */
+	bool mapArtNetworkImage(std::string fileName);
+
+	/**
+	 * Save the network as a compact model (see CompactWriter), for storage and links where every
+	 * byte counts: the same as an image but without padding, with the weights rounded if the
+	 * options say so. Returns false if the file cannot be written.
+	 */
+	bool saveArtNetworkCompact(std::string fileName, const CompactModelOptions &options = CompactModelOptions()) const;
+	//! Replace the network by a compact model, returns false (and changes nothing) if it is not one
+	bool loadArtNetworkCompact(std::string fileName);
+
+	ART_TYPE getAVGVigilance() const;
 	inline int getCompressionCount() const { return d_compressionCount;}
 
 	inline int getVigilanceHistorySize() const { return d_vigilanceHistorySize; }
@@ -96,8 +169,11 @@ public:
 	inline bool getMatchTrack() const { return d_matchTrack; }
 	inline void setMatchTrack(bool d_matchTrack) { this->d_matchTrack = d_matchTrack; }
 
-	//! Return all incoming weights of F2 node
-	inline PROTOTYPE* getPrototype(int id){ return d_F2[id];}
+	//! Return all incoming weights of F2 node (only valid until the network is changed)
+	inline PrototypeView getPrototype(int id) const { return d_F2.getRow(id); }
+
+	//! The L1-norm |Wj| of an F2 node, kept up to date with the weights
+	inline ART_TYPE getPrototypeNorm(int id) const 	{ return d_F2.getNorm(id); }
 
 	inline float getAlpha() const 						{ return d_alpha; }
 
@@ -113,84 +189,244 @@ public:
 	//! with d_learning_fraction set to "1" the weights are basically set to AND with the input pattern
 	inline void setLearningFraction(float d_learningFraction) { this->d_learningFraction = d_learningFraction; }
 	inline float getVigilance() const 					{ return d_vigilance; }
+	inline ART_COMPUTATION_TYPE getComputationType() const { return d_ACT; }
+	//! DEFAULT_ARTMAP or FUZZY_ARTMAP, see signalToProtoType() for the choice functions
+	inline void setComputationType(ART_COMPUTATION_TYPE type) { d_ACT = type; }
 	inline void setVigilance(float vigilance)			{ d_vigilance = vigilance; }
+	//! The vigilance a node has to reach for an input (before match tracking): the vigilance, the
+	//! average of the history if there is one, and zero for match tracking networks
+	inline float getBaseVigilance() const 				{ return getBaseVigilance(d_matchTrack); }
+	//! The base vigilance of the network if it would (not) match track
+	float getBaseVigilance(bool matchTrack) const;
+	inline bool getUseInputComplement() const 			{ return d_useInputComplement; }
 
 	//! Return all weights of all prototypes (you can see this as the actual network)
-	inline std::vector<PROTOTYPE*>* getF2()  			{ return &d_F2; }
+	inline const PrototypeMatrix* getF2() const 		{ return &d_F2; }
 	inline float getNetworkReliability() const 			{ return d_networkReliability; }
 	inline void setNetworkReliability(float d_networkReliability)
 	{ this->d_networkReliability = d_networkReliability; }
 	inline void setTestMatch(bool test){d_testMatch = test;}
 	inline bool getTestMatch(){return d_testMatch;}
 
-	//! Match the input vector
+	//! Match the input vector, or update the weights of the winner if "finished" (then NULL is
+	//! returned). Thin wrapper around the two functions below, the caller deletes the output.
 	std::vector<ART_TYPE>* matchTrack(bool finished = false, bool raiseVigilance = false);
 
-protected:
-	//! Actually update the weights
-	void updateWeights();
-private:
+	//! Find the winner for the current input (with raised vigilance if the last one was not right)
+	//! and write it into "result". Returns false if there is none.
+	bool matchTrack(ArtResult &result, bool raiseVigilance = false);
+
+	//! End the match tracking of the current input by letting the winner learn
+	inline void finishMatchTrack() 						{ updateWeights(); }
+
+	//! The number of F2 nodes in the output of a network constructed without WTA
+	static const int DEFAULT_OUTPUT_CATEGORIES = 3;
+
 	/**
-	 * The value "T" or actually T_j (per node) indicates the similarity between the input vector I and
-	 * the weight vector of the j'th F2 memory node. A "PROTOTYPE" is a set of weights from all input
-	 * nodes on F1 to a node on F2.
+	 * Return the nrCategories most active F2 nodes that resonate instead of only the winner, with
+	 * their activity T normalized to an activation (see ArtResult). The winner is the same as with
+	 * WTA output and still the only node that learns. One is WTA output. Only whether the output is
+	 * WTA is saved with the network.
 	 */
-	struct PROTOTYPE_Activation
-	{
-		// The index in F2
-		int id;
-		// The T_j value (the activity of the node)
-		// Used for adjusting the weights subsequently if needed
-		float T;
-		// The resonance value (the actual non mismatch from that node)
-		// The most active node can still be very much off (e.g. it is the only one)
-		float resonance;
-	};
+	void setDistributedOutput(int nrCategories);
+	inline int getDistributedOutput() const 			{ return d_useWTA ? 1 : d_nrOutputCategories; }
 
+	//! Below this number of F2 nodes waking up other threads costs more than it saves
+	static const int DEFAULT_MIN_PARALLEL_CATEGORIES = 4096;
+
+	/**
+	 * Score the F2 nodes on nrThreads threads (including the calling one) as soon as there are at
+	 * least minCategories of them. The threads are kept in a pool shared by all networks. The winner
+	 * and the match tracking order are the same as with one thread, also for networks with
+	 * prototypes longer than the input (which raise the input size of the nodes after them, see
+	 * scoreBucket()). One thread (the default) turns it off. A predict() that finds the pool busy
+	 * with another context scores on its own thread instead of waiting for it.
+	 */
+	void setParallelScoring(int nrThreads, int minCategories = DEFAULT_MIN_PARALLEL_CATEGORIES);
 	/**
-	 * Function to sort the prototypes based on their "T" activity levels (depends on the last input).
-	 * As you can see the value with the highest "T" value "wins" (in the priority queue will be at
-	 * the front). With equal "T" values the highest index always wins.
+	 * Keep the prototypes in an R-tree of their boxes (complement coding only), such that an input
+	 * only scores the nodes that can resonate with it instead of all of them. This pays off for
+	 * inputs with few features and many nodes. The results are the same as without the index. It
+	 * is not used for a vigilance of zero (match tracking networks), nor for networks with
+	 * prototypes of different sizes.
 	 */
-	struct ComparePrototype {
-		bool operator() (const PROTOTYPE_Activation* pt1, const PROTOTYPE_Activation* pt2) const
-		{
-			if(pt1->T == pt2->T)
-				return pt1->id < pt2->id;
+	void setHyperboxIndex(bool use);
+	inline bool getHyperboxIndex() const 				{ return d_useHyperboxIndex; }
 
-			return pt1->T < pt2->T;
-		}
-	};
+	/**
+	 * Find the winner with upper bounds of the choice function (complement coding and prototypes
+	 * of the input size only): nodes that cannot reach the vigilance are skipped, and the rest is
+	 * scored from the highest bound down until no node can beat the winner anymore. The results
+	 * are the same as those of the full scan. It pays off when the vigilance is higher than the one
+	 * the network learned with (e.g. classifying with a stricter vigilance), because then most
+	 * nodes are skipped; at the learning vigilance the bounds skip little. The hyperbox index goes
+	 * first if both are on. It is not used for distributed output, which needs every node that
+	 * resonates.
+	 */
+	void setBoundedSearch(bool use);
+	inline bool getBoundedSearch() const 				{ return d_useBoundedSearch; }
+
+	inline int getNrScoringThreads() const 				{ return d_nrScoringThreads; }
+	inline int getMinParallelCategories() const 		{ return d_minParallelCategories; }
+
+	/**
+	 * Keep the network within a budget of at most maxCategories categories and at most maxBytes
+	 * bytes of prototypes (see PrototypeMatrix::getRowBytes()), 0 is no limit. When a new category
+	 * took the network over the budget, the least used categories are removed before the next
+	 * input: a fraction pruneFraction of the budget at once, so the prototypes are compacted in
+	 * bulk and not for every new category. Categories after a removed one get a lower index, the
+	 * prune listener is told how.
+	 */
+	void setMemoryBudget(int maxCategories, size_t maxBytes = 0, float pruneFraction = 0.1);
+	inline int getMaxCategories() const 				{ return d_maxCategories; }
+	inline size_t getMaxBytes() const 					{ return d_maxBytes; }
+	//! The number of categories that fit in the budget, -1 without one
+	int getCategoryBudget() const;
+
+	/**
+	 * The usage of a category: its number of wins (a new category has one), halved for every
+	 * "half life" inputs since its last win. The least used categories are removed first. By
+	 * default the half life is the category budget (or the number of categories without one).
+	 */
+	float getUsage(int category) const;
+	inline void setUsageHalfLife(float inputs) 		{ d_usageHalfLife = inputs; }
+
+	//! Remove the least used categories until nrCategories are left, returns how many were removed
+	int pruneCategories(int nrCategories);
 
+	//! Who is told about removed categories, e.g. the ARTMAP the network is part of (NULL for none)
+	void setPruneListener(ART_PRUNE_LISTENER listener, void* context);
+	//! Remove the given categories, like pruneCategories() does, returns how many were removed
+	int removeCategories(const std::vector<bool> &remove);
+	//! Remove all categories (the prune listener is told)
+	void clearCategories();
+
+	//! Who is told about new and changed categories, e.g. a ModelDeltaLog (NULL for none)
+	void setChangeListener(ART_CHANGE_LISTENER listener, void* context);
+	/**
+	 * Set the weights of a category, or add one with category == getF2()->size(). The size has to
+	 * be that of the category. |Wj| is computed if norm < 0, a copy of another network gives the
+	 * norm of the original so that both choose exactly the same. Returns false if the category
+	 * cannot be set.
+	 */
+	bool setPrototype(int category, const ART_TYPE* weights, int size, ART_TYPE norm = -1);
+
+protected:
+	//! Actually update the weights
+	void updateWeights();
+private:
 	float	d_vigilance;
 
 	//! The "signal rule parameter" denotes how quickly a weight vector of an F2 node shifts towards
 	//! an input pattern
 	float	d_alpha;
-	float 	d_inputSize;
 	float 	d_trackingValue;
 	float	d_learningFraction;
 	float	d_networkReliability;
 	int 	d_vigilanceHistorySize;
 	int 	d_currVHist;
 	int 	d_compressionCount;
-
-	//! Short-term memory input pattern
-	std::vector<ART_TYPE>	d_F1;
+	int		d_nrScoringThreads;
+	int		d_minParallelCategories;
+	bool	d_useHyperboxIndex;
+	bool	d_useBoundedSearch;
+
+	// The memory budget, see setMemoryBudget()
+	int		d_maxCategories;
+	size_t	d_maxBytes;
+	float	d_pruneFraction;
+	float	d_usageHalfLife;
+	//! The number of inputs so far, the clock of the usage statistics of the categories
+	unsigned int d_inputCount;
+	ART_PRUNE_LISTENER	d_pruneListener;
+	void*	d_pruneContext;
+	ART_CHANGE_LISTENER	d_changeListener;
+	void*	d_changeContext;
+
+	//! Short-term memory of the input that is learned, see ArtContext
+	ArtContext				d_context;
+	//! The scaling of the inputs to [0, 1]: (x - offset) * scale, see setInputRange()
+	std::vector<ART_TYPE>	d_inputOffset;
+	std::vector<ART_TYPE>	d_inputScale;
 	//! Long-term memory (which is not a series of nodes, but the weights to each high-level nodes)
-	std::vector<PROTOTYPE*>	d_F2;
+	//! One row per F2 node, all in one contiguous block
+	PrototypeMatrix			d_F2;
 
 	std::vector<ART_TYPE>	d_vigilanceHist;
-	//! A queue with the prototypes ordered on activity ("T" value)
-	std::priority_queue<PROTOTYPE_Activation*, std::vector<PROTOTYPE_Activation*>, ComparePrototype> d_curPTAct;
+	HyperboxIndex			d_index;
 	bool d_matchTrack, d_useInputComplement, d_useWTA, d_testMatch;
 	ART_COMPUTATION_TYPE d_ACT;
-
-	//! Creates values for F1 (and uses two-complementary representation if needed)
-	void createF1(std::vector<ART_TYPE> &input);
+	//! The number of F2 nodes in a distributed output
+	int d_nrOutputCategories;
+
+	//! Pop the nodes of the context that do not resonate and write the winner to "result" (or the
+	//! distributed output), returns false if no node resonates
+	bool findWinner(ArtContext &context, float vigilance, ArtResult &result) const;
+	//! Write the most active nodes that resonate with their activation to "result"
+	void distributedOutput(ArtContext &context, float vigilance, ArtResult &result) const;
+
+	//! Creates values for F1 of the context (and uses two-complementary representation if needed)
+	void createF1(const ART_TYPE* input, int size, ArtContext &context) const;
+	//! Copy (and scale) "size" input values into F1
+	void createF1(const ART_TYPE* input, int size, ART_TYPE* F1) const;
+	//! The size of F1 with the complement
+	inline int getF1Size(const ArtContext &context) const { return d_useInputComplement ? 2*context.d_F1.size() : context.d_F1.size(); }
 
 	//! Calculates activity and resonance values for each prototype in F2
-	void signalToProtoType();
+	void signalToProtoType(ArtContext &context, float vigilance) const;
+	void scoreAllCategories(ArtContext &context) const;
+	bool useHyperboxIndex(const ArtContext &context, float vigilance) const;
+	bool useBoundedSearch(const ArtContext &context) const;
+	//! Score the nodes in order of their upper bounds, only those below "below" if given
+	void boundedSearch(ArtContext &context, float vigilance, const PROTOTYPE_Activation* below) const;
+
+	/**
+	 * Calculates activity and resonance of the F2 nodes [first, last) for the F1 of the context,
+	 * bucket by bucket (see ArtContext::d_alignments), and writes the candidates to "out". Returns
+	 * the number of candidates, "best" is the index in "out" of the most active one (or -1). The
+	 * input size is raised by the longer prototypes of the whole range, as if the nodes were scored
+	 * in order.
+	 */
+	int scoreCategories(const ArtContext &context, int first, int last, float &inputSize, PROTOTYPE_Activation* out,
+			int &best) const;
+
+	//! The alignment of a prototype of the given size to an F1 of nrFeatures inputs
+	CategoryAlignment alignCategory(int size, int nrFeatures) const;
+	//! The alignment of every bucket of d_F2 to an F1 of nrFeatures inputs
+	void alignBuckets(int nrFeatures, std::vector<CategoryAlignment> &alignments) const;
+
+	/**
+	 * Scores the "n" nodes "rows" of bucket "bucket", which all line up with F1 in the same way, and
+	 * writes the candidates to "out" (see scoreCategories()). The input size of a node is the
+	 * largest of "inputSize" and the raises of the buckets that start at or before it, which is
+	 * the input size it would have if all nodes were scored in order.
+	 */
+	int scoreBucket(const ArtKernels &kernels, const ART_TYPE* F1, const std::vector<CategoryAlignment> &alignments,
+			int bucket, const int* rows, int n, float inputSize, PROTOTYPE_Activation* out, int &best) const;
+
+	//! |A n Wj| (or the distance without complement coding) of the prototype Wj for the given F1
+	ART_TYPE fuzzyIntersection(const ArtKernels &kernels, const ART_TYPE* F1, const ART_TYPE* Wj,
+			const CategoryAlignment &alignment) const;
+
+	//! Tj and the resonance of node x from |A n Wj|, returns false if it is no candidate
+	bool activation(ART_TYPE diff, int x, float inputSize, PROTOTYPE_Activation &pa) const;
+
+	//! Activity and resonance of F2 node x for the given F1 (nrFeatures values, without the
+	//! complement), returns false if it is no candidate
+	bool scoreCategory(const ArtKernels &kernels, const ART_TYPE* F1, int nrFeatures, int x, float &inputSize,
+			PROTOTYPE_Activation &pa) const;
+
+	//! The shared state of one parallel scoring job
+	struct ScoringJob
+	{
+		const Art*				art;
+		const ArtContext*		context;
+		PROTOTYPE_Activation*	candidates;
+		int						nrTasks;
+		std::vector<int>		counts;
+		std::vector<int>		best;
+	};
+	static void scoreTask(void* context, int task);
 };
 }
 
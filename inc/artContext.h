@@ -0,0 +1,82 @@
+/*
+ * artContext.h
+ *
+ * The short-term memory of one classification by an ART network, kept apart from the long-term
+ * memory (the weights) so that one network can classify on several threads at the same time
+ */
+
+#ifndef ARTCONTEXT_H_
+#define ARTCONTEXT_H_
+
+#include <vector>
+#include "artTypes.h"
+#include "activationQueue.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * How the prototypes of one size line up with F1, see Art::scoreCategory(). The first "direct"
+ * weights are compared with the input, the "complement" weights from "complementStart" on with its
+ * complement. What is left is summed alone: "restF1" values of the complement of F1 that a shorter
+ * prototype has no weights for, or "restWj" weights of a longer prototype for inputs that F1 does
+ * not have. A longer prototype raises the input size to "raise" (0 if not).
+ */
+struct CategoryAlignment
+{
+	bool	coded;		// prototype and F1 line up exactly
+	int		direct;
+	int		complementStart;
+	int		complement;
+	int		restF1;
+	int		restWj;
+	float	raise;
+	//! The first node of the bucket
+	int		first;
+};
+
+/**
+ * Everything an Art network needs next to its weights to classify one input: F1, the scored F2
+ * nodes and the buffers to score them. A network keeps one for learning, and Art::predict() works
+ * on one of the caller: every thread that classifies with the same network has its own. It is
+ * reused for every input, so after the first inputs nothing is allocated anymore.
+ */
+class ArtContext
+{
+public:
+	ArtContext();
+
+	//! The size of the last input, raised by the prototypes longer than it
+	inline float getInputSize() const 					{ return d_inputSize; }
+private:
+	friend class Art;
+
+	//! Short-term memory input pattern. With complement coding only the first half, the input
+	//! itself: the complement is computed by the kernels.
+	std::vector<ART_TYPE>	d_F1;
+	float					d_inputSize;
+	//! A queue with the prototypes ordered on activity ("T" value)
+	ActivationQueue			d_curPTAct;
+	//! The candidates in d_curPTAct are all nodes with a resonance of at least this (or all nodes if <= 0)
+	float					d_queueVigilance;
+	//! The candidates in d_curPTAct are only those scored by Art::boundedSearch()
+	bool					d_queueBounded;
+	//! The alignment of every bucket of F2 to the current F1
+	std::vector<CategoryAlignment> d_alignments;
+	std::vector<int>		d_indexHits;
+	//! The nodes with the upper bound of their activity, for Art::boundedSearch()
+	std::vector<PROTOTYPE_Activation> d_bounds;
+	//! The nodes of a distributed output
+	std::vector<PROTOTYPE_Activation> d_topCategories;
+};
+
+inline ArtContext::ArtContext(): d_F1(0),
+		d_inputSize(0),
+		d_queueVigilance(-1),
+		d_queueBounded(false)
+{
+}
+
+}
+
+#endif /* ARTCONTEXT_H_ */
@@ -0,0 +1,146 @@
+/*
+ * artKernels.h
+ *
+ * The inner loops of the ART network: the fuzzy intersection |A n Wj| and the L1-norm |Wj| of the
+ * choice function, and the fast/slow learning rule of the weight update. They are implemented once
+ * for every instruction set we run on (plain C++, AVX2, AVX-512 and NEON) and the best set for the
+ * CPU at hand is picked at runtime.
+ *
+ * All sums take the running sum "acc" of the caller, so that a sum over several segments of a
+ * prototype (networks with inputs of different sizes) is still one sequential sum in the plain C++
+ * version. The vectorized versions sum in a different order and can differ in the last bits.
+ */
+
+#ifndef ARTKERNELS_H_
+#define ARTKERNELS_H_
+
+#include "artTypes.h"
+
+namespace almendeSensorFusion
+{
+
+//! Quantized weights: 8 bit fixed point and IEEE half precision
+typedef unsigned char ART_BYTE;
+typedef unsigned short ART_HALF;
+
+//! Conversion to half precision, rounded to nearest even (what F16C and NEON do as well)
+inline ART_HALF floatToHalf(float value)
+{
+	union { float f; unsigned int u; } bits;
+	bits.f = value;
+	unsigned int u = bits.u;
+	unsigned int sign = (u >> 16) & 0x8000;
+	unsigned int mantissa = u & 0x7fffff;
+	int exponent = (int)((u >> 23) & 0xff) - 127 + 15;
+
+	if(((u >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);		// inf or nan
+	if(exponent >= 0x1f)
+		return sign | 0x7c00;								// too large
+	if(exponent <= 0)
+	{
+		// subnormal (or zero) in half precision
+		if(exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int midway = 1u << (shift - 1);
+		if(rest > midway || (rest == midway && (half & 1)))
+			++half;
+		return sign | half;
+	}
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1fff;
+	// a carry into the exponent is still the right result
+	if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		++half;
+	return half;
+}
+
+inline float halfToFloat(ART_HALF half)
+{
+	unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+	int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ff;
+	union { float f; unsigned int u; } bits;
+
+	if(exponent == 0x1f)
+		bits.u = sign | 0x7f800000 | (mantissa << 13);
+	else if(exponent != 0)
+		bits.u = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	else if(mantissa == 0)
+		bits.u = sign;
+	else
+	{
+		// subnormal, normalize it
+		exponent = 1;
+		while(!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			--exponent;
+		}
+		bits.u = sign | ((exponent - 15 + 127) << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	return bits.f;
+}
+
+enum ART_KERNEL_TYPE
+{
+	KERNEL_AUTO,		// the best set the CPU supports
+	KERNEL_SCALAR,		// plain C++, the reference
+	KERNEL_AVX2,
+	KERNEL_AVX512,
+	KERNEL_NEON
+};
+
+struct ArtKernels
+{
+	//! acc + sum |min(a_i, w_i)|, the fuzzy intersection
+	ART_TYPE (*fuzzyMin)(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc);
+
+	//! acc + sum |w_i|, the L1-norm
+	ART_TYPE (*absSum)(const ART_TYPE* w, int n, ART_TYPE acc);
+
+	//! acc + sum |a_i - w_i|, the distance used without complement coding
+	ART_TYPE (*absDiff)(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc);
+
+	//! w_i = beta * min(a_i, w_i) + (1 - beta) * w_i, beta = 1 is fast learning. Returns acc + |w|
+	//! of the new weights, so the norm of a prototype is updated in the same pass.
+	ART_TYPE (*learn)(ART_TYPE* w, const ART_TYPE* a, int n, ART_TYPE beta, ART_TYPE acc);
+
+	//! fuzzyMin() and learn() for a complement coded input A = (x, 1 - x) of 2n values against a
+	//! prototype of 2n weights, from x only. The values of A are made in the registers in the order
+	//! fuzzyMin() and learn() would load them, so the sums are the same to the last bit.
+	ART_TYPE (*fuzzyMinCoded)(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc);
+	ART_TYPE (*learnCoded)(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc);
+
+	//! fuzzyMin() and learn() against the complement 1 - x_i of the input, so that a complement
+	//! coded F1 never has to be written out
+	ART_TYPE (*fuzzyMinComplement)(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc);
+	ART_TYPE (*learnComplement)(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc);
+
+	//! The same sums for quantized prototypes (see QuantizedArt). For 8 bits the input is quantized
+	//! as well and the sums are exact integers: sum min(a_i, w_i) and sum |a_i - w_i|.
+	unsigned int (*minSumU8)(const ART_BYTE* a, const ART_BYTE* w, int n);
+	unsigned int (*absDiffSumU8)(const ART_BYTE* a, const ART_BYTE* w, int n);
+	//! For half precision prototypes against a float input: acc + sum |min(a_i, w_i)| and
+	//! acc + sum |a_i - w_i|
+	ART_TYPE (*fuzzyMinF16)(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc);
+	ART_TYPE (*absDiffF16)(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc);
+
+	ART_KERNEL_TYPE type;
+	const char* name;
+};
+
+//! The kernels used by all ART networks, selected on first use
+const ArtKernels& getArtKernels();
+
+//! Force a kernel set, e.g. KERNEL_SCALAR to compare against. Returns false (and keeps the current
+//! set) if the CPU or the build does not support it.
+bool selectArtKernels(ART_KERNEL_TYPE type);
+
+}
+
+#endif /* ARTKERNELS_H_ */
@@ -25,6 +25,8 @@
 #define ARTMAP_H_
 
 #include "art.h"
+#include "connectionLists.h"
+#include "edgeIndex.h"
 #include <vector>
 #include <utility>
 #include <iostream>
@@ -43,33 +45,38 @@ namespace almendeSensorFusion
  *************************************************************************************************************/
 
 //! A "map field" is used to "synchronize" between two or more ART networks (see artMap class explanation)
-typedef std::vector< ART_TYPE> ART_MAPFIELD;
+//! Only the map field nodes that are activated are in it, as (map field node, activity) sorted on the node
+typedef std::vector<MAPFIELD_CONNECTION> ART_MAPFIELD;
 
 //! The activity of the "map field" calculated for all ART networks
 typedef std::vector<ART_MAPFIELD*> ART_MAPFIELDS;
 
 //! Normal ART_MAPFIELD is about activity, this is also about how many ART networks "vote" for it
-typedef std::pair<int,ART_TYPE> ART_MAPFIELD_NODE_POPULARITY;
+struct ART_MAPFIELD_NODE_POPULARITY
+{
+	int			mapNode;
+	//! The number of ART networks that activate the node positively
+	int			votes;
+	//! The total activation of the node
+	ART_TYPE	activation;
+};
 
-//! Stores the popularity of each node (in a vector)
-typedef std::vector<ART_MAPFIELD_NODE_POPULARITY*> ART_MAPFIELD_POPULARITY;
+//! Stores the popularity of the activated nodes, sorted on the node (in a vector)
+typedef std::vector<ART_MAPFIELD_NODE_POPULARITY> ART_MAPFIELD_POPULARITY;
 
 //! One weight from a given F2 node to a map field node
-typedef std::pair<int, ART_TYPE> F2_NODE_TO_MAPFIELD_NODE;
+typedef MAPFIELD_CONNECTION F2_NODE_TO_MAPFIELD_NODE;
 
 //! Weights from all F2 nodes (from one ART network) to one map field node
 //! A "map field node" is also called often a class, so F2_TO_CLASS would be fine too
 typedef std::vector<F2_NODE_TO_MAPFIELD_NODE*> F2_TO_MAPFIELD_NODE;
 
-//! Weights from all F2 nodes (from one ART network) to all map field nodes
-//! These are considered "classes"
-//! The size of F2_TO_MAPFIELD should be the number of neurons in long-term memory (F2)
+//! Weights from all F2 nodes (from one ART network) to all map field nodes, as
+//! distMapNodeClassification() returns them (the map field itself is kept in ConnectionLists)
 typedef std::vector<F2_TO_MAPFIELD_NODE*> F2_TO_MAPFIELD;
 
 //! One weight from map field node to an F2 node
-typedef std::pair<int, ART_TYPE> MAPFIELD_NODE_TO_F2_NODE;
-typedef std::vector<MAPFIELD_NODE_TO_F2_NODE*> MAPFIELD_TO_F2_NODE;
-typedef std::vector<MAPFIELD_TO_F2_NODE*> MAPFIELD_TO_F2;
+typedef MAPFIELD_CONNECTION MAPFIELD_NODE_TO_F2_NODE;
 
 //! For referencing we use integers, we might use char's for size later.
 typedef int ART_INDEX;
@@ -80,6 +87,19 @@ typedef std::vector< ART_INDEX> ART_NETWORK_INDICES;
 //! The set of map field nodes referenced by index
 typedef std::vector< ART_INDEX> ART_MAPFIELD_INDICES;
 
+//! The short-term memory of ArtMap::predict(), a context per ART network
+typedef std::vector<ArtContext> ArtMapContext;
+
+class ArtMap;
+
+/**
+ * Called when the map field of an ARTMAP changed, after the change. With a network (>= 0) the
+ * connection between the category of that network and the map node was created or got other
+ * weights. Without a network (-1) the map node was created, or with mapNode -1 as well the whole
+ * map field was cleared.
+ */
+typedef void (*ARTMAP_CHANGE_LISTENER)(void* context, const ArtMap* artMap, int network, int category, int mapNode);
+
 /**
  * The most normal ARTMAP exists out of two ART networks that are coupled to each other by a
  * so-called "map field". To one of the ART networks, say ART_a, is an input vector fed, which needs
@@ -102,6 +122,7 @@ public:
 	 * We need a set of ART networks.
 	 */
 	ArtMap(std::vector<Art*>* networks, float learnFraction = 0.5);
+	~ArtMap();
 
 	/**
 	 * The classification routine. Of course the input vectors need to be ordered corresponding to
@@ -109,6 +130,25 @@ public:
 	 */
 	ART_DISTRIBUTED_CLASSES* classify(ART_VIEW& multipleInputVectors);
 
+	/**
+	 * Classify without learning: every ART network with an input predicts its class (see
+	 * Art::predict()) with the vigilance classify() would use, and the networks without an input get
+	 * the class of the winning map field node. A network that finds no class, or that has no class
+	 * for the winning map field node, gets an empty result. Nothing of the ARTMAP or its networks
+	 * is changed, so several threads can predict at the same time as long as each one has its own
+	 * context and nobody trains. Returns false if there was no input at all.
+	 */
+	bool predict(const ART_VIEW& multipleInputVectors, std::vector<ArtResult> &results, ArtMapContext &context) const;
+
+	/**
+	 * Make the map field and the parameters the same as those of "source". The ART networks are not
+	 * copied, to predict like source they have to be synchronized as well (see Art::syncFrom()).
+	 * Of the map field only the lists and the blocks of the edge index written since this was last
+	 * synchronized with source are copied (see ConnectionLists::syncFrom()), finding those still
+	 * reads the write count of every list.
+	 */
+	void syncFrom(const ArtMap &source);
+
 	/**
 	 * Return the distributed activation of the "map field" in between two (or more) ART networks.
 	 * Consider that the input is multiple "ART_VIEWs". So, e.g. in case multiple views from
@@ -120,6 +160,25 @@ public:
 
 	void saveArtMap(std::string fileName);
 	void loadArtMap(std::string fileName);
+
+	/**
+	 * Save the map field as a model image (see ModelImage), both directions as flat arrays: per
+	 * network (or map node) the range of its lists, per list the range of its connections. The ART
+	 * networks have images of their own (see Art::saveArtNetworkImage()).
+	 */
+	bool saveArtMapImage(std::string fileName) const;
+	//! Replace the map field by the one of an image, returns false (and changes nothing) if it has none
+	bool loadArtMapImage(std::string fileName);
+
+	/**
+	 * Save the map field as a compact model (see CompactWriter): a connection is the difference of
+	 * its index with the one before it, and its weight as a multiple of the learning fraction when
+	 * it is one, which it is unless the learning fraction changed. The ART networks have compact
+	 * models of their own (see Art::saveArtNetworkCompact()).
+	 */
+	bool saveArtMapCompact(std::string fileName, const CompactModelOptions &options = CompactModelOptions()) const;
+	//! Replace the map field by the one of a compact model, returns false (and changes nothing) if it is not one
+	bool loadArtMapCompact(std::string fileName);
 	void printArtMap();
 
 
@@ -131,14 +190,49 @@ public:
 	inline void setLearningFraction(float d_learningFraction) { this->d_learningFraction = d_learningFraction; }
 	inline float getVigilance() const { return d_vigilance; }
 	inline void setVigilance(float d_vigilance) { this->d_vigilance = d_vigilance; }
-	inline void addArtNetwork(Art* artNetwork) { d_artNetworks->push_back(artNetwork); }
+	void addArtNetwork(Art* artNetwork);
 	inline Art* getArtNetwork(int networkNr) { return (*d_artNetworks)[networkNr] ;}
+	inline const Art* getArtNetwork(int networkNr) const { return (*d_artNetworks)[networkNr] ;}
+	inline int getNrArtNetworks() const { return d_artNetworks->size(); }
+
+	//! Who is told about changes of the map field, e.g. a ModelDeltaLog (NULL for none)
+	void setChangeListener(ARTMAP_CHANGE_LISTENER listener, void* context);
+	//! Who is told about categories an ART network removed, after the map field followed them
+	void setPruneListener(ART_PRUNE_LISTENER listener, void* context);
+
+	//! The number of categories of a network the map field has connections for
+	int getNrMappedCategories(int networkNr) const;
+	//! The map nodes a category is connected to, in the order of its connections
+	void getMapNodes(int networkNr, int category, std::vector<int> &mapNodes) const;
+	//! The categories of a network a map node is connected to, in the order of its connections
+	void getCategories(int networkNr, int mapNode, std::vector<int> &categories) const;
+	/**
+	 * Put the connections of a map node to a network in the order of "categories" (as given by
+	 * getCategories()), e.g. after they were set in another order. Ties between the weights are
+	 * won by the first, so the order matters.
+	 */
+	void orderCategories(int networkNr, int mapNode, const int* categories, int count);
+	/**
+	 * The weights of the connection between a category and a map node, in both directions (0 for
+	 * a direction that is not there). Returns false if there is no such connection. Older versions
+	 * could connect a class twice to a map node (see addToMapNode()), "occurrence" tells which one
+	 * for their delta logs, the map field is loaded with one connection for each.
+	 */
+	bool getConnection(int networkNr, int category, int mapNode, ART_TYPE &weight, ART_TYPE &backWeight,
+			int occurrence = 0) const;
+	//! Set both weights of a connection, it is created (and the map node if needed) when it is new
+	void setConnection(int networkNr, int category, int mapNode, ART_TYPE weight, ART_TYPE backWeight,
+			int occurrence = 0);
+	//! Make sure there are at least the given number of map nodes, also the ones without connections
+	void reserveMapNodes(int nrMapNodes);
+	//! Remove all map nodes and connections
+	void clearMapField();
 
 protected:
 	//! Winner-take-all of all field map nodes
-	int getMapNodeWTA(ART_INDEX artNetworkNr, ART_INDEX classId);
+	int getMapNodeWTA(ART_INDEX artNetworkNr, ART_INDEX classId) const;
 	//! Winner-take-all of all F2 nodes
-	int getArtClassWTA(int artNetworkNr, int mapNode);
+	int getArtClassWTA(int artNetworkNr, int mapNode) const;
 private:
 	float 		d_learningFraction;
 	float		d_vigilance;
@@ -148,16 +242,54 @@ private:
 
 	std::vector<Art*>*	d_artNetworks;
 
-	//! From all ART networks to "map field" structure
-	//! The size of d_artF2 is equal to the number of ART networks
-	std::vector<F2_TO_MAPFIELD*> d_artF2;
-
-	//! From "map field" to all ART networks
-	//! The size of d_mapNodes is equal to the number of map field nodes
-	std::vector<MAPFIELD_TO_F2*> d_mapNodes;
+	//! From all ART networks to "map field" structure: per network a list for each of its F2 nodes
+	//! The size of d_artF2 is equal to the number of ART networks with connections
+	std::vector<ConnectionLists> d_artF2;
+
+	//! From "map field" to all ART networks: per network a list for each map field node (up to the
+	//! last one connected to it), d_mapNodes has the same size as d_artF2
+	std::vector<ConnectionLists> d_mapNodes;
+
+	//! Per network where the connections of long lists are in both directions (see locateConnection()),
+	//! a category and a map node have one connection at most
+	std::vector<EdgeIndex> d_edgeIndex;
+	//! The connections of lists of at least this size are in d_edgeIndex
+	static const int INDEXED_LIST_SIZE = 8;
+
+	ARTMAP_CHANGE_LISTENER	d_changeListener;
+	void*	d_changeContext;
+	ART_PRUNE_LISTENER	d_pruneListener;
+	void*	d_pruneContext;
+
+	inline void notifyChange(int networkNr, int category, int mapNode)
+	{ if(d_changeListener != NULL) d_changeListener(d_changeContext, this, networkNr, category, mapNode); }
+
+	//! The number of connections of a map node to a network
+	inline int getNrConnections(int networkNr, int mapNode) const
+	{
+		return networkNr >= 0 && mapNode >= 0 && networkNr < (int)d_mapNodes.size() && mapNode < d_mapNodes[networkNr].size() ?
+				d_mapNodes[networkNr].size(mapNode) : 0;
+	}
+	//! Make sure both directions of the map field have lists for the given number of networks
+	void reserveNetworks(int nrNetworks);
+	//! Add a connection that is not there yet at the end of its lists in both directions, which are created if needed
+	void addConnection(int networkNr, int category, int mapNode, ART_TYPE weight, ART_TYPE backWeight);
+	//! Fill the edge index again after the lists changed, merging connections that are there twice
+	void indexConnections();
+	/**
+	 * Where the first connection between a category and a map node is in the list of the category
+	 * and in that of the map node (-1 if it is not there). False if it is in neither.
+	 */
+	bool locateConnection(int networkNr, int category, int mapNode, int &categoryPosition, int &mapNodePosition) const;
+	//! Update the index after a connection was added at the end of one or both of its lists
+	void connectionAdded(int networkNr, int category, int mapNode, int categoryPosition, int mapNodePosition);
+	//! Put the connections of a list in the index, those that are not there yet
+	void indexList(int networkNr, int list, bool byMapNode);
 
 	//! Calculate map field activity for each ART network
 	ART_MAPFIELDS* calcMapNodeActivation(ART_VIEW* inputVectors);
+	//! The same on the map field as it is, the classes it does not know yet activate nothing
+	ART_MAPFIELDS* mapNodeActivation(const ART_VIEW* inputVectors) const;
 
 	//! Create a new map field node
 	void createNewMapNode(ART_VIEW* inputVectors);
@@ -165,13 +297,17 @@ private:
 	void addToMapNode(int mapNodeNr, ART_ASPECT* inputVectors);
 
 	//! Get the ART networks
-	ART_NETWORK_INDICES* getSupervisors(ART_VIEW* inputVectors);
+	ART_NETWORK_INDICES* getSupervisors(const ART_VIEW* inputVectors) const;
 
 	void updateConnections(int winningMapNode, ART_VIEW* inputVectors);
 
+	//! Follow the categories an ART network removed (see Art::setMemoryBudget())
+	static void onArtPruned(void* context, const Art* art, const std::vector<int> &remap);
+	void remapArtNetwork(int artNr, const std::vector<int> &remap);
+
 	//! The "popularity" of each map field node
 	ART_MAPFIELD_POPULARITY* calcWinningNode(ART_MAPFIELDS* mnActList, ART_ASPECT* artN_new_nodes,
-			ART_MAPFIELD_INDICES* input_map_nodes, ART_NETWORK_INDICES* nrSv, int *maxNodeNr, ART_TYPE *maxNodeCount);
+			ART_MAPFIELD_INDICES* input_map_nodes, ART_NETWORK_INDICES* nrSv, int *maxNodeNr, ART_TYPE *maxNodeCount) const;
 
 	bool mapClasses(ART_VIEW* inputVectors);
 };
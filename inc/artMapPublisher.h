@@ -0,0 +1,125 @@
+/*
+ * artMapPublisher.h
+ *
+ * Train an ARTMAP on one thread while other threads classify with it: the trainer publishes
+ * read-only snapshots of the ARTMAP and its ART networks, and a reader picks up the latest one
+ * without locks and without waiting for the trainer.
+ */
+
+#ifndef ARTMAPPUBLISHER_H_
+#define ARTMAPPUBLISHER_H_
+
+#include <vector>
+#include "artMap.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * A copy of an ARTMAP and of its ART networks that is never changed while readers can see it. It
+ * owns its networks, they classify like the ones of the ARTMAP at the time of publication.
+ */
+class ArtMapSnapshot
+{
+public:
+	//! The number of the publication this is, see ArtMapPublisher::publish()
+	inline unsigned int getVersion() const 				{ return d_version; }
+	inline const ArtMap& getArtMap() const 				{ return *d_artMap; }
+	inline const Art& getArtNetwork(int networkNr) const { return *d_artNetworks[networkNr]; }
+	inline int getNrArtNetworks() const 				{ return d_artNetworks.size(); }
+
+	//! See ArtMap::predict()
+	inline bool predict(const ART_VIEW& multipleInputVectors, std::vector<ArtResult> &results, ArtMapContext &context) const
+	{ return d_artMap->predict(multipleInputVectors, results, context); }
+private:
+	friend class ArtMapPublisher;
+
+	ArtMapSnapshot(const ArtMap &source);
+	~ArtMapSnapshot();
+
+	//! Make this equal to source again, copying only what changed since the last time
+	void syncFrom(const ArtMap &source);
+
+	std::vector<Art*>	d_artNetworks;
+	ArtMap*				d_artMap;
+	unsigned int		d_version;
+	//! The epoch in which it was replaced by a newer snapshot
+	unsigned long		d_retired;
+
+	// not copyable
+	ArtMapSnapshot(const ArtMapSnapshot&);
+	ArtMapSnapshot& operator=(const ArtMapSnapshot&);
+};
+
+/**
+ * Publishes snapshots of an ARTMAP that is trained on one thread (the "trainer") to any number of
+ * reading threads. Only the trainer calls publish(), between two calls to ArtMap::classify() or
+ * whenever it likes. A reader registers once with addReader() and then calls acquire() for every
+ * input (or batch of inputs) it classifies: that is an atomic load of the latest snapshot after
+ * announcing the current epoch in the slot of the reader. The snapshot stays valid until the next
+ * acquire() or release() of the same reader, a reader that does not classify for a while should
+ * release() so that the old snapshots can be reused.
+ *
+ * A replaced snapshot is retired with the epoch of its replacement. Once every reader announced
+ * that epoch or a later one (or is released) nobody can see it anymore, and it becomes the base of
+ * a next publication: it is brought up to date with the rows and connection lists written since it
+ * was published (see Art::syncFrom() and ArtMap::syncFrom()) instead of copied as a whole. A few of
+ * those are kept, the rest is deleted.
+ */
+class ArtMapPublisher
+{
+public:
+	static const int DEFAULT_MAX_READERS = 64;
+	//! The number of unused snapshots kept for the next publications
+	static const int SPARE_SNAPSHOTS = 2;
+
+	//! Publishes the first snapshot of artMap, which has to outlive the publisher
+	ArtMapPublisher(const ArtMap* artMap, int maxReaders = DEFAULT_MAX_READERS);
+	//! Deletes all snapshots, no reader may use one anymore
+	~ArtMapPublisher();
+
+	//! Make the current state of the ARTMAP visible to the readers, returns the new version
+	unsigned int publish();
+	//! The version of the latest snapshot (any thread)
+	inline unsigned int getVersion() const 				{ return __atomic_load_n(&d_version, __ATOMIC_ACQUIRE); }
+
+	//! Reserve a reader slot, returns its number or -1 if all slots are in use (any thread)
+	int addReader();
+	void removeReader(int reader);
+
+	//! The latest snapshot, which the reader can use until its next acquire() or release()
+	const ArtMapSnapshot* acquire(int reader);
+	void release(int reader);
+private:
+	//! One cache line per reader, so readers do not slow each other down
+	struct ReaderSlot
+	{
+		//! The epoch at the last acquire(), 0 when the reader holds no snapshot
+		unsigned long	epoch;
+		int				used;
+		char			padding[64 - sizeof(unsigned long) - sizeof(int)];
+	};
+
+	const ArtMap*		d_artMap;
+	ReaderSlot*			d_readers;
+	int					d_maxReaders;
+
+	ArtMapSnapshot*		d_latest;
+	unsigned long		d_epoch;
+	unsigned int		d_version;
+	//! Replaced snapshots that might still be used, oldest first
+	std::vector<ArtMapSnapshot*> d_retired;
+	//! Snapshots nobody uses anymore, the most recently published last
+	std::vector<ArtMapSnapshot*> d_spare;
+
+	//! Move the retired snapshots no reader can see anymore to the spare ones
+	void reclaim();
+
+	// not copyable
+	ArtMapPublisher(const ArtMapPublisher&);
+	ArtMapPublisher& operator=(const ArtMapPublisher&);
+};
+
+}
+
+#endif /* ARTMAPPUBLISHER_H_ */
@@ -0,0 +1,69 @@
+/*
+ * artResult.h
+ *
+ * The output of one classification by an ART network, owned by the caller
+ */
+
+#ifndef ARTRESULT_H_
+#define ARTRESULT_H_
+
+#include <vector>
+#include <cstddef>
+#include "artTypes.h"
+
+namespace almendeSensorFusion
+{
+
+//! The number of F2 nodes in an output, see ArtResult
+inline int getNrOutputCategories(const ART_DISTRIBUTED_CLASS &values) { return values.size() > 1 ? values.size() / 2 : values.size(); }
+//! The index of the i-th F2 node of an output, the first one is the winner
+inline int getOutputCategory(const ART_DISTRIBUTED_CLASS &values, int i) { return (int)values[values.size() > 1 ? 2*i : 0]; }
+//! The activation of the i-th F2 node of an output, 1 for a WTA output
+inline ART_TYPE getOutputActivation(const ART_DISTRIBUTED_CLASS &values, int i) { return values.size() > 1 ? values[2*i + 1] : 1; }
+
+/**
+ * The classification of one input: with WTA output a single value, the index of the winning F2
+ * node. A distributed output (see Art::setDistributedOutput()) has pairs of an F2 node and its
+ * activation, [id0, a0, id1, a1, ...], the most active node first and the activations summing to
+ * one, so the first value is the winner in both cases. Pass the same result to every call to
+ * reuse its memory.
+ */
+class ArtResult
+{
+public:
+	ArtResult(): d_values(0) {}
+
+	//! No values means that no node was found (only possible when testing for a match)
+	inline bool empty() const 							{ return d_values.empty(); }
+	inline int size() const 							{ return d_values.size(); }
+	inline ART_TYPE operator[](int index) const 		{ return d_values[index]; }
+
+	//! The winning F2 node, or -1
+	inline int getWinner() const 						{ return d_values.empty() ? -1 : (int)d_values[0]; }
+
+	//! The F2 nodes in the output with their activation, see getOutputCategory()
+	inline int getNrCategories() const 					{ return getNrOutputCategories(d_values); }
+	inline int getCategory(int i) const 				{ return getOutputCategory(d_values, i); }
+	inline ART_TYPE getActivation(int i) const 		{ return getOutputActivation(d_values, i); }
+
+	inline const ART_DISTRIBUTED_CLASS& getValues() const { return d_values; }
+	inline ART_DISTRIBUTED_CLASS& getValues() 			{ return d_values; }
+
+	//! Forget the values, but keep the memory
+	inline void clear() 								{ d_values.clear(); }
+	inline void push_back(ART_TYPE value) 				{ d_values.push_back(value); }
+
+	//! Hand the values over to a new vector, for the old pointer interface
+	inline ART_DISTRIBUTED_CLASS* release()
+	{
+		ART_DISTRIBUTED_CLASS* values = new ART_DISTRIBUTED_CLASS();
+		values->swap(d_values);
+		return values;
+	}
+private:
+	ART_DISTRIBUTED_CLASS d_values;
+};
+
+}
+
+#endif /* ARTRESULT_H_ */
@@ -0,0 +1,54 @@
+/*
+ * artTypes.h
+ *
+ * The basic data types shared by the ART network, its prototype storage and the ARTMAP. They are
+ * kept apart from art.h so that the storage classes can be used without pulling in the network.
+ */
+
+#ifndef ARTTYPES_H_
+#define ARTTYPES_H_
+
+#include <vector>
+
+namespace almendeSensorFusion
+{
+
+/**************************************************************************************************************
+ * Type definitions that make it easier to understand the code
+ *
+ * They are not always necessary and sometimes different typedefs are used for the same data structure to
+ * tell what something really does
+ *************************************************************************************************************/
+
+//! We just use floats here as individual inputs to our nodes
+typedef float ART_TYPE;
+
+//! The "prototype" corresponding to a node in F2 (long-term memory) is stored as a vector of
+//! weights from all F1 nodes to the given node.
+typedef std::vector<ART_TYPE> PROTOTYPE;
+
+//! An "aspect" is a mono-modal view of a perceivable "object" using one (sub)modality
+typedef std::vector< ART_TYPE> ART_ASPECT;
+
+//! Multiple features can also be seen as a "view" of an object using "aspects" from multiple modalities
+typedef std::vector< ART_ASPECT*> ART_VIEW;
+
+//! A class in ART is not just "1" value, it is also represented by a (distributed) vector of values
+//! For all practical purposes, it is also fine to use a vector (1,0) for one class and (0,1) for another.
+typedef std::vector< ART_TYPE> ART_DISTRIBUTED_CLASS;
+
+//! Multiple classes (each represented in a distributed manner)
+typedef std::vector< ART_DISTRIBUTED_CLASS*> ART_DISTRIBUTED_CLASSES;
+
+//! There can be multiple "views" of the same object (over time or from different directions)
+typedef std::vector< ART_VIEW*> ART_VIEWS;
+
+enum ART_COMPUTATION_TYPE
+{
+	DEFAULT_ARTMAP,
+	FUZZY_ARTMAP
+};
+
+}
+
+#endif /* ARTTYPES_H_ */
@@ -0,0 +1,157 @@
+/*
+ * compactModel.h
+ *
+ * A small file format for trained networks, for hosts that get their models over slow links and
+ * keep them on small storage: numbers as variable length integers, weights optionally rounded to
+ * fewer bits, and the whole stream optionally compressed.
+ */
+
+#ifndef COMPACTMODEL_H_
+#define COMPACTMODEL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "modelImage.h"
+
+namespace almendeSensorFusion
+{
+
+//! How the stream after the header is compressed
+enum COMPACT_COMPRESSION
+{
+	COMPACT_NONE = 0,
+	//! Only available when built with USE_ZLIB
+	COMPACT_ZLIB = 1
+};
+
+struct CompactModelOptions
+{
+	/**
+	 * 0 keeps every weight as it is. 2 to 16 rounds the weights of the prototypes to that many
+	 * bits over their range (the map field is always kept as it is).
+	 */
+	int		weightBits;
+	//! Compress the stream, if this is built with a compressor (otherwise it is not compressed)
+	bool	compress;
+
+	CompactModelOptions(int weightBits = 0, bool compress = true): weightBits(weightBits), compress(compress) {}
+};
+
+/**
+ * The file starts with this header, as bytes so that it reads the same on every host. All numbers
+ * after it are written byte by byte as well (see CompactWriter).
+ */
+struct CompactModelHeader
+{
+	char		magic[8];
+	uint8_t		version;
+	uint8_t		kind;
+	uint8_t		weightBits;
+	uint8_t		compression;
+	uint8_t		reserved[4];
+};
+
+/**
+ * Writes a compact model: unsigned numbers as little endian base 128 (7 bits per byte, the high
+ * bit set on all bytes but the last), signed numbers zigzag coded first so small negative numbers
+ * are short too, and floats as their 4 bytes, little endian. The bytes go through a buffer of
+ * BUFFER_SIZE, and through the compressor if there is one, so the file is written in large pieces
+ * and never held as a whole.
+ */
+class CompactWriter
+{
+public:
+	static const int VERSION = 1;
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	CompactWriter();
+	//! Closes the file if that was not done
+	~CompactWriter();
+
+	//! Returns false if the file cannot be created (printed)
+	bool open(const std::string &fileName, MODEL_IMAGE_KIND kind, const CompactModelOptions &options);
+	//! Write what is left, returns false if anything could not be written (printed)
+	bool close();
+
+	inline int getWeightBits() const 					{ return d_weightBits; }
+
+	void putBytes(const void* data, size_t bytes);
+	inline void putByte(uint8_t value)
+	{ if(d_used == BUFFER_SIZE) flush(false); d_buffer[d_used++] = value; }
+	void putUnsigned(uint64_t value);
+	inline void putSigned(int64_t value)				{ putUnsigned(((uint64_t)value << 1) ^ (uint64_t)(value >> 63)); }
+	void putFloat(float value);
+	//! The number of values followed by the values
+	void putFloats(const std::vector<float> &values);
+private:
+	FILE*				d_file;
+	std::string			d_fileName;
+	int					d_weightBits;
+	COMPACT_COMPRESSION	d_compression;
+	//! The bytes that are not written yet, and for the compressor the bytes it made of them
+	std::vector<uint8_t> d_buffer;
+	std::vector<uint8_t> d_compressed;
+	size_t				d_used;
+	//! The state of the compressor (its type is not part of this interface)
+	void*				d_stream;
+	bool				d_failed;
+
+	void flush(bool finish);
+
+	// not copyable
+	CompactWriter(const CompactWriter&);
+	CompactWriter& operator=(const CompactWriter&);
+};
+
+/**
+ * Reads what a CompactWriter wrote, a buffer at a time. A read past the end or of a broken number
+ * returns 0 and marks the reader as failed, so a loader can read a whole part and check once.
+ */
+class CompactReader
+{
+public:
+	CompactReader();
+	~CompactReader();
+
+	//! Open the file and check that it is a compact model of the given kind this build can read
+	bool open(const std::string &fileName, MODEL_IMAGE_KIND kind);
+	void close();
+
+	inline int getWeightBits() const 					{ return d_weightBits; }
+	inline bool failed() const 							{ return d_failed; }
+
+	bool getBytes(void* data, size_t bytes);
+	inline uint8_t getByte()
+	{ if(d_next == d_used && !fill()) return 0; return d_buffer[d_next++]; }
+	uint64_t getUnsigned();
+	inline int64_t getSigned()							{ uint64_t value = getUnsigned(); return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+	float getFloat();
+	//! An unsigned number that has to be at most "limit", e.g. a count (larger marks a failure)
+	uint64_t getCount(uint64_t limit);
+	//! What putFloats() wrote
+	bool getFloats(std::vector<float> &values);
+private:
+	FILE*				d_file;
+	int					d_weightBits;
+	COMPACT_COMPRESSION	d_compression;
+	//! Bytes read from the file, and for the compressor the bytes it made of them
+	std::vector<uint8_t> d_buffer;
+	std::vector<uint8_t> d_compressed;
+	size_t				d_next;
+	size_t				d_used;
+	void*				d_stream;
+	bool				d_failed;
+
+	//! Get the next bytes into the buffer, false at the end
+	bool fill();
+
+	// not copyable
+	CompactReader(const CompactReader&);
+	CompactReader& operator=(const CompactReader&);
+};
+
+}
+
+#endif /* COMPACTMODEL_H_ */
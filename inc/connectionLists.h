@@ -0,0 +1,151 @@
+/*
+ * connectionLists.h
+ *
+ * One direction of the map field of an ARTMAP for one ART network: per F2 node (or per map field
+ * node) the list of its connections to the other side, all lists in one block of memory.
+ */
+
+#ifndef CONNECTIONLISTS_H_
+#define CONNECTIONLISTS_H_
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "artTypes.h"
+
+namespace almendeSensorFusion
+{
+
+//! A connection: the index of the node on the other side and the weight
+typedef std::pair<int, ART_TYPE> MAPFIELD_CONNECTION;
+
+/**
+ * Lists of connections stored like a sparse matrix by rows (CSR): the connections of a list are
+ * next to each other in one array, and a list knows where it starts, its size and its capacity.
+ * A list that is full when a connection is added grows in place if it is the last one in the
+ * array, otherwise it moves to the end with twice the capacity and leaves a gap. The gaps are
+ * closed whenever the array has to be allocated again anyway, compact() also gives every list just
+ * its size as capacity.
+ *
+ * A pointer into a list is valid until a connection is added to, or a list is set on, any list.
+ *
+ * Every list knows its strongest connection, the first one with the largest weight (like a scan of
+ * the list that keeps a larger weight only). Adding a connection or changing a weight through
+ * setWeight() keeps it in O(1), except for lowering the weight of the strongest connection. After
+ * connections were changed or moved through begin(), updateBest() finds it again.
+ *
+ * Like the rows of a PrototypeMatrix, every list remembers the count of its last write (push_back(),
+ * setWeight(), updateBest() and everything that calls it), so that a copy is brought up to date by
+ * copying only the lists written since, see syncFrom(). The copy has its own layout in the array,
+ * only removing lists makes it copy everything again.
+ */
+class ConnectionLists
+{
+public:
+	ConnectionLists();
+	ConnectionLists(const ConnectionLists &other);
+	ConnectionLists& operator=(const ConnectionLists &other);
+
+	//! The number of lists
+	inline int size() const 							{ return d_lists.size(); }
+	//! Add empty lists up to the given number, or remove the last ones
+	void resize(int nrLists);
+	void clear();
+
+	inline int size(int list) const 					{ return d_lists[list].size; }
+	inline const MAPFIELD_CONNECTION* begin(int list) const
+	{ return d_lists[list].size == 0 ? NULL : &d_connections[d_lists[list].offset]; }
+	inline MAPFIELD_CONNECTION* begin(int list)
+	{ return d_lists[list].size == 0 ? NULL : &d_connections[d_lists[list].offset]; }
+	inline const MAPFIELD_CONNECTION* end(int list) const 	{ return begin(list) + size(list); }
+	inline MAPFIELD_CONNECTION* end(int list) 			{ return begin(list) + size(list); }
+
+	//! Add a connection at the end of a list
+	inline void push_back(int list, int index, ART_TYPE weight)
+	{
+		if(d_lists[list].size == d_lists[list].capacity)
+			makeRoom(list, d_lists[list].capacity < 2 ? 2 : 2 * d_lists[list].capacity);
+		List &entry = d_lists[list];
+		d_connections[entry.offset + entry.size] = MAPFIELD_CONNECTION(index, weight);
+		raiseBest(entry, entry.size++, weight);
+		entry.version = ++d_version;
+	}
+	//! Set the weight of the connection at the given position of a list
+	inline void setWeight(int list, int position, ART_TYPE weight)
+	{
+		List &entry = d_lists[list];
+		ART_TYPE &current = d_connections[entry.offset + position].second;
+		bool lower = weight < current;
+		current = weight;
+		if(lower && position == entry.best)
+			updateBest(list);
+		else if(!lower)
+			raiseBest(entry, position, weight);
+		entry.version = ++d_version;
+	}
+	//! The position of the strongest connection of a list, -1 if it has none with a weight above -1
+	inline int getBest(int list) const 					{ return d_lists[list].best; }
+	//! Find the strongest connection of a list again
+	void updateBest(int list);
+	//! Replace the connections of a list
+	void assign(int list, const MAPFIELD_CONNECTION* connections, int count);
+	//! Keep only the first "size" connections of a list
+	void truncate(int list, int size);
+	/**
+	 * Remove the lists whose new index in "remap" is -1, the others move up. The lists after the
+	 * end of "remap" are kept.
+	 */
+	void removeLists(const std::vector<int> &remap);
+
+	//! The number of connections in all lists
+	size_t getNrConnections() const;
+	//! The memory of the lists and of the connections, with what is reserved for growth
+	size_t getBytes() const;
+	//! Close the gaps and give every list its size as capacity
+	void compact();
+
+	/**
+	 * Make these lists equal to "source" again, where this is a copy of source (see
+	 * PrototypeMatrix::syncFrom()). Only the lists written since the last copy are copied, unless
+	 * source removed lists since.
+	 */
+	void syncFrom(const ConnectionLists &source);
+private:
+	struct List
+	{
+		int				offset;
+		int				size;
+		int				capacity;
+		int				best;
+		//! The count of the last write
+		unsigned int	version;
+	};
+	std::vector<List>					d_lists;
+	std::vector<MAPFIELD_CONNECTION>	d_connections;
+
+	//! The number of writes
+	unsigned int	d_version;
+	//! A number no other lists have, that changes when lists are removed
+	unsigned int	d_layout;
+	//! The layout and version of the lists this is a copy of, see syncFrom()
+	unsigned int	d_syncLayout;
+	unsigned int	d_syncVersion;
+
+	//! The connection at the given position is the strongest one if its weight is larger, or equal and before it
+	inline void raiseBest(List &entry, int position, ART_TYPE weight)
+	{
+		ART_TYPE best = entry.best < 0 ? -1 : d_connections[entry.offset + entry.best].second;
+		if(best < weight || (best == weight && position < entry.best))
+			entry.best = position;
+	}
+	//! Give a list at least the given capacity, moving it (or all lists) if needed
+	void makeRoom(int list, int capacity);
+	//! Copy all lists into a new array, the given list (if any) gets the given capacity
+	void rebuild(int list, int capacity, bool slack);
+	//! The capacity list x gets in rebuild()
+	int getCapacity(int x, int list, int capacity, bool slack) const;
+};
+
+}
+
+#endif /* CONNECTIONLISTS_H_ */
@@ -0,0 +1,99 @@
+/*
+ * edgeIndex.h
+ *
+ * Finds a connection of the map field of an ARTMAP by its category and map field node, without
+ * walking the lists of connections (see ConnectionLists).
+ */
+
+#ifndef EDGEINDEX_H_
+#define EDGEINDEX_H_
+
+#include <stdint.h>
+#include <vector>
+#include <cstddef>
+
+namespace almendeSensorFusion
+{
+
+/**
+ * Where a connection is in the list of its category and in the list of its map field node (-1 if
+ * not there). The category and the map field node are one key, the category in the high half.
+ */
+struct MapFieldEdge
+{
+	uint64_t	key;
+	int			categoryPosition;
+	int			mapNodePosition;
+};
+
+/**
+ * A hash table with open addressing for the connections of one ART network: an edge is in the
+ * first free slot from the one its key hashes to, so a lookup reads a few neighbouring slots. The
+ * table doubles when it is three quarters full. There is no removal of single edges, the owner
+ * clears and fills the table again when positions change for many edges (e.g. after categories
+ * were removed).
+ *
+ * The index only finds edges, the order of the connections is that of their lists.
+ *
+ * The slots are counted as written in blocks of BLOCK_SIZE (a found edge can be changed, so finding
+ * one in a non-const index counts as a write of its block), so that a copy is brought up to date by
+ * copying only the blocks written since, see syncFrom(). Growing or clearing the table moves every
+ * edge, after which a copy copies all of it again.
+ */
+class EdgeIndex
+{
+public:
+	EdgeIndex();
+	EdgeIndex(const EdgeIndex &other);
+	EdgeIndex& operator=(const EdgeIndex &other);
+
+	//! NULL if the connection is not there
+	const MapFieldEdge* find(int category, int mapNode) const;
+	//! The edge of a connection to change, NULL if it is not there
+	MapFieldEdge* find(int category, int mapNode);
+	//! Add a connection that is not there yet, returns it
+	MapFieldEdge* insert(int category, int mapNode, int categoryPosition, int mapNodePosition);
+	void clear();
+
+	//! Make this index equal to "source" again, where this is a copy of source (see PrototypeMatrix::syncFrom())
+	void syncFrom(const EdgeIndex &source);
+
+	inline size_t size() const 							{ return d_size; }
+	//! The memory of the table
+	inline size_t getBytes() const
+	{ return d_slots.capacity() * sizeof(MapFieldEdge) + d_blockVersions.capacity() * sizeof(unsigned int); }
+private:
+	std::vector<MapFieldEdge>	d_slots;
+	size_t						d_size;
+
+	//! Slots per block of which the writes are counted
+	static const size_t BLOCK_SIZE = 64;
+	//! The number of writes, and per block the number at its last write
+	unsigned int				d_version;
+	std::vector<unsigned int>	d_blockVersions;
+	//! A number no other index has, that changes when the edges move
+	unsigned int				d_layout;
+	//! The layout and version of the index this is a copy of
+	unsigned int				d_syncLayout;
+	unsigned int				d_syncVersion;
+
+	//! A free slot has the key of category -1 and map field node -1, which is no connection
+	static const uint64_t FREE_KEY = ~(uint64_t)0;
+
+	static inline uint64_t getKey(int category, int mapNode)
+	{ return (uint64_t)(uint32_t)category << 32 | (uint32_t)mapNode; }
+	static inline uint64_t hash(uint64_t key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		return key ^ (key >> 33);
+	}
+	void grow();
+	inline void written(size_t slot) 					{ d_blockVersions[slot / BLOCK_SIZE] = ++d_version; }
+};
+
+}
+
+#endif /* EDGEINDEX_H_ */
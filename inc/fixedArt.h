@@ -0,0 +1,530 @@
+/*
+ * fixedArt.h
+ *
+ * An Art network of which the input size, the choice function and complement coding are fixed at
+ * compile time
+ */
+
+#ifndef FIXEDART_H_
+#define FIXEDART_H_
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdio.h>
+
+#include "artTypes.h"
+#include "activationQueue.h"
+#include "artResult.h"
+#include "artKernels.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * The sums over a prototype of N weights. Short prototypes are summed inline in a loop with a
+ * constant trip count, which the compiler unrolls completely: for those the call into the vector
+ * kernels costs more than the sum itself. Longer ones go to the vector kernels of Art (one
+ * indirect call, no branches on the size), which also makes their results exactly those of Art.
+ */
+template <int N>
+struct FixedKernels
+{
+	//! Prototypes up to this size are summed inline
+	static const int INLINE_SIZE = 8;
+
+	//! |A n W|, the sum of the component-wise minimum
+	static inline ART_TYPE fuzzyMin(const ArtKernels &kernels, const ART_TYPE* a, const ART_TYPE* w)
+	{
+		if(N > INLINE_SIZE)
+			return kernels.fuzzyMin(a, w, N, 0);
+		ART_TYPE sum = 0;
+		for (int i = 0; i < N; ++i)
+			sum += fabs(std::min(a[i], w[i]));
+		return sum;
+	}
+
+	//! The L1 distance between a and w
+	static inline ART_TYPE absDiff(const ArtKernels &kernels, const ART_TYPE* a, const ART_TYPE* w)
+	{
+		if(N > INLINE_SIZE)
+			return kernels.absDiff(a, w, N, 0);
+		ART_TYPE sum = 0;
+		for (int i = 0; i < N; ++i)
+			sum += fabs(a[i] - w[i]);
+		return sum;
+	}
+};
+
+/**
+ * The same network as Art (WTA output, match tracking, vigilance history), for deployments that
+ * always use one input size and one choice function. DIM is the number of input features, ACT the
+ * choice function and COMPLEMENT whether the input is complement coded. Every prototype has exactly
+ * the size of F1, so there is no alignment of prototypes of other sizes and no growing input size,
+ * and the choice function and complement coding are decided by the compiler: scoring a node is one
+ * kernel call (or an unrolled loop) on a std::array without a branch.
+ *
+ * The files of saveArtNetwork() and loadArtNetWork() are those of Art, so a network trained by one
+ * can be used by the other. Only networks of which all prototypes have the size of F1 can be loaded.
+ * The choice function is not in the file, with both it is set in the code.
+ *
+ * Prototypes of up to FixedKernels::INLINE_SIZE weights are summed in order, which is the scalar
+ * kernel of Art; with the vector kernels those results can differ from Art in rounding.
+ */
+template <int DIM, ART_COMPUTATION_TYPE ACT = DEFAULT_ARTMAP, bool COMPLEMENT = true>
+class FixedArt
+{
+public:
+	//! The size of F1 and of every prototype
+	static const int SIZE = COMPLEMENT ? 2*DIM : DIM;
+
+	typedef std::array<ART_TYPE, DIM> Input;
+	typedef std::array<ART_TYPE, SIZE> Prototype;
+
+	//! See Art::Art(), the output is always WTA
+	FixedArt(bool matchTrack);
+
+	//! See Art::classifyInput(), the input has DIM values
+	bool classifyInput(const ART_TYPE* input, ArtResult &result);
+	inline bool classifyInput(const Input &input, ArtResult &result) { return classifyInput(input.data(), result); }
+	inline ArtResult classify(const Input &input) 		{ ArtResult result; classifyInput(input, result); return result; }
+
+	//! See Art::classifyBatch(), the inputs are a row-major nrInputs x DIM matrix
+	void classifyBatch(const ART_TYPE* inputs, int nrInputs, int* winners, ART_TYPE* resonances = NULL) const;
+
+	//! See Art::matchTrack()
+	bool matchTrack(ArtResult &result, bool raiseVigilance = false);
+	inline void finishMatchTrack() 						{ updateWeights(); }
+
+	//! The format of Art::saveArtNetwork(), returns false if the file cannot be written
+	bool saveArtNetwork(std::string fileName) const;
+	//! The format of Art::loadArtNetWork(), returns false (and loads nothing) if the file cannot be
+	//! read or has prototypes of another size
+	bool loadArtNetWork(std::string fileName);
+
+	void addToVigilanceHistory(ART_TYPE vig);
+	void setVigilanceHistorySize(int size);
+	ART_TYPE getAVGVigilance() const;
+	//! See Art::getBaseVigilance()
+	float getBaseVigilance() const;
+
+	//! The number of F2 nodes
+	inline int size() const 							{ return d_F2.size(); }
+	inline const Prototype& getPrototype(int id) const 	{ return d_F2[id]; }
+	inline ART_TYPE getPrototypeNorm(int id) const 		{ return d_norms[id]; }
+
+	inline int getCompressionCount() const 				{ return d_compressionCount; }
+	inline int getVigilanceHistorySize() const 			{ return d_vigilanceHistorySize; }
+	inline bool getMatchTrack() const 					{ return d_matchTrack; }
+	inline void setMatchTrack(bool matchTrack) 			{ d_matchTrack = matchTrack; }
+	inline float getAlpha() const 						{ return d_alpha; }
+	inline void setAlpha(float alpha) 					{ d_alpha = alpha; }
+	inline float getTrackingValue() const 				{ return d_trackingValue; }
+	inline void setTrackingValue(float trackingValue) 	{ d_trackingValue = trackingValue; }
+	inline float getLearningFraction() const 			{ return d_learningFraction; }
+	inline void setLearningFraction(float learningFraction) { d_learningFraction = learningFraction; }
+	inline float getVigilance() const 					{ return d_vigilance; }
+	inline void setVigilance(float vigilance) 			{ d_vigilance = vigilance; }
+	inline float getNetworkReliability() const 			{ return d_networkReliability; }
+	inline void setNetworkReliability(float networkReliability) { d_networkReliability = networkReliability; }
+	inline void setTestMatch(bool test) 				{ d_testMatch = test; }
+	inline bool getTestMatch() const 					{ return d_testMatch; }
+protected:
+	//! Let the winner learn, see Art::updateWeights()
+	void updateWeights();
+private:
+	typedef FixedKernels<SIZE> Kernels;
+
+	float	d_vigilance;
+	float	d_alpha;
+	float	d_trackingValue;
+	float	d_learningFraction;
+	float	d_networkReliability;
+	int		d_vigilanceHistorySize;
+	int		d_currVHist;
+	int		d_compressionCount;
+	bool	d_matchTrack, d_useWTA, d_testMatch;
+
+	Prototype				d_F1;
+	std::vector<Prototype>	d_F2;
+	//! |Wj| of every prototype
+	std::vector<ART_TYPE>	d_norms;
+	std::vector<ART_TYPE>	d_vigilanceHist;
+	ActivationQueue			d_curPTAct;
+
+	static inline void createF1(const ART_TYPE* input, Prototype &F1);
+
+	//! Activity and resonance of F2 node x, returns false if it is no candidate
+	inline bool scoreCategory(const ArtKernels &kernels, const Prototype &F1, int x, PROTOTYPE_Activation &pa) const;
+};
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+FixedArt<DIM, ACT, COMPLEMENT>::FixedArt(bool matchTrack): d_F2(0),
+		d_norms(0),
+		d_vigilanceHist(0)
+{
+	// The defaults of Art
+	d_matchTrack			= matchTrack;
+	d_useWTA				= true;
+	d_vigilance				= 0.65;
+	d_alpha					= 0.01;
+	d_trackingValue			= -0.001;
+	d_learningFraction		= 1;
+	d_testMatch				= false;
+	d_networkReliability	= matchTrack ? 0.9 : 1.0;
+	d_vigilanceHistorySize	= 0;
+	d_currVHist				= 0;
+	d_compressionCount		= 0;
+	d_F1.fill(0);
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+void FixedArt<DIM, ACT, COMPLEMENT>::createF1(const ART_TYPE* input, Prototype &F1)
+{
+	for (int x = 0; x < DIM; ++x)
+		F1[x] = input[x];
+	if(COMPLEMENT)
+		for (int x = 0; x < DIM; ++x)
+			F1[DIM + x] = 1-input[x];
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+bool FixedArt<DIM, ACT, COMPLEMENT>::scoreCategory(const ArtKernels &kernels, const Prototype &F1, int x,
+		PROTOTYPE_Activation &pa) const
+{
+	const float inputSize = DIM;
+	ART_TYPE diff;
+	if(COMPLEMENT)
+		diff = Kernels::fuzzyMin(kernels, F1.data(), d_F2[x].data());
+	else
+		diff = inputSize/(Kernels::absDiff(kernels, F1.data(), d_F2[x].data())+1.0);
+
+	ART_TYPE Tj;
+	if(ACT == DEFAULT_ARTMAP)
+		Tj = diff + (1 - d_alpha) * (inputSize - d_norms[x]);
+	else
+		Tj = diff / (d_alpha + d_norms[x]);
+
+	pa.id			= x;
+	pa.T			= Tj;
+	pa.resonance	= diff/inputSize;
+	return ACT == FUZZY_ARTMAP || !COMPLEMENT || Tj > d_alpha*inputSize;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+bool FixedArt<DIM, ACT, COMPLEMENT>::classifyInput(const ART_TYPE* input, ArtResult &result)
+{
+	createF1(input, d_F1);
+	const ArtKernels &kernels = getArtKernels();
+
+	// every node can become a candidate, they are written straight into the queue
+	int nrCategories = d_F2.size();
+	d_curPTAct.resize(nrCategories);
+	PROTOTYPE_Activation* candidates = d_curPTAct.data();
+	ComparePrototype less;
+	int count = 0;
+	int best = -1;
+	for (int x = 0; x < nrCategories; ++x)
+	{
+		if(!scoreCategory(kernels, d_F1, x, candidates[count]))
+			continue;
+		if(best < 0 || less(candidates[best], candidates[count]))
+			best = count;
+		++count;
+	}
+	d_curPTAct.resize(count);
+	d_curPTAct.setBest(best);
+
+	bool found = matchTrack(result);
+	if(!d_matchTrack)
+		updateWeights();
+	return found;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+bool FixedArt<DIM, ACT, COMPLEMENT>::matchTrack(ArtResult &result, bool raiseVigilance)
+{
+	result.clear();
+	if(!d_useWTA)
+		return false;
+
+	float vigilance = getBaseVigilance();
+	if(raiseVigilance && !d_curPTAct.empty())
+	{
+		vigilance = d_curPTAct.top().resonance+d_trackingValue;
+		d_curPTAct.pop();
+	}
+
+	if(d_curPTAct.popUntilResonance(vigilance))
+	{
+		result.push_back(d_curPTAct.top().id);
+		return true;
+	}
+
+	if(d_testMatch)
+		return false;
+
+	// a new prototype, a copy of F1, with its norm summed like PrototypeMatrix does for Art
+	d_F2.push_back(d_F1);
+	d_norms.push_back(getArtKernels().absSum(d_F1.data(), SIZE, 0));
+	result.push_back(d_F2.size() - 1);
+	return true;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+void FixedArt<DIM, ACT, COMPLEMENT>::updateWeights()
+{
+	if(d_curPTAct.empty()) return;
+
+	if(!d_testMatch)
+	{
+		const PROTOTYPE_Activation &protA = d_curPTAct.top();
+		d_norms[protA.id] = getArtKernels().learn(d_F2[protA.id].data(), d_F1.data(), SIZE, d_learningFraction, 0);
+
+		if(d_vigilanceHistorySize > 0 && d_matchTrack)
+			addToVigilanceHistory(protA.resonance-(d_alpha*10));
+		++d_compressionCount;
+	}
+	d_curPTAct.clear();
+}
+
+/**
+ * Blocks of inputs against blocks of prototypes that fit in the cache, like Art::classifyBatch().
+ */
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+void FixedArt<DIM, ACT, COMPLEMENT>::classifyBatch(const ART_TYPE* inputs, int nrInputs, int* winners,
+		ART_TYPE* resonances) const
+{
+	static const int BATCH_INPUTS	= 32;
+	static const int BATCH_BYTES	= 128*1024;
+	static const int CATEGORY_BLOCK	= BATCH_BYTES / sizeof(Prototype) > 16 ? BATCH_BYTES / sizeof(Prototype) : 16;
+
+	const ArtKernels &kernels = getArtKernels();
+	int nrCategories = d_F2.size();
+	float vigilance = getBaseVigilance();
+	std::array<Prototype, BATCH_INPUTS> F1;
+	std::array<PROTOTYPE_Activation, BATCH_INPUTS> best;
+	ComparePrototype less;
+
+	for (int i0 = 0; i0 < nrInputs; i0 += BATCH_INPUTS)
+	{
+		int n = std::min(BATCH_INPUTS, nrInputs - i0);
+		for (int i = 0; i < n; ++i)
+		{
+			createF1(inputs + (size_t)(i0 + i) * DIM, F1[i]);
+			best[i].id = -1;
+		}
+
+		for (int c0 = 0; c0 < nrCategories; c0 += CATEGORY_BLOCK)
+		{
+			int c1 = std::min(nrCategories, c0 + CATEGORY_BLOCK);
+			for (int i = 0; i < n; ++i)
+			{
+				PROTOTYPE_Activation pa;
+				for (int x = c0; x < c1; ++x)
+					if(scoreCategory(kernels, F1[i], x, pa) && pa.resonance >= vigilance &&
+							(best[i].id < 0 || less(best[i], pa)))
+						best[i] = pa;
+			}
+		}
+
+		for (int i = 0; i < n; ++i)
+		{
+			winners[i0 + i] = best[i].id;
+			if(resonances != NULL)
+				resonances[i0 + i] = best[i].id < 0 ? 0 : best[i].resonance;
+		}
+	}
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+void FixedArt<DIM, ACT, COMPLEMENT>::setVigilanceHistorySize(int vigilanceHistorySize)
+{
+	if(d_vigilanceHistorySize > vigilanceHistorySize)
+		d_vigilanceHist.resize(vigilanceHistorySize);
+
+	d_vigilanceHistorySize = vigilanceHistorySize;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+void FixedArt<DIM, ACT, COMPLEMENT>::addToVigilanceHistory(ART_TYPE vig)
+{
+	if(d_vigilanceHist.size() <= (size_t)d_currVHist)
+		d_vigilanceHist.push_back(vig);
+	else
+		d_vigilanceHist[d_currVHist] = vig;
+	++d_currVHist;
+	if(d_currVHist == d_vigilanceHistorySize)
+		d_currVHist = 0;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+ART_TYPE FixedArt<DIM, ACT, COMPLEMENT>::getAVGVigilance() const
+{
+	ART_TYPE avg = 0;
+	for (size_t x = 0; x < d_vigilanceHist.size(); ++x)
+		avg += d_vigilanceHist[x];
+	if(d_vigilanceHist.size() > 0)
+		avg /= float(d_vigilanceHist.size());
+	if(avg == 0)
+		return d_vigilance;
+	return avg;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+float FixedArt<DIM, ACT, COMPLEMENT>::getBaseVigilance() const
+{
+	float vigilance = d_vigilance;
+	if(d_vigilanceHistorySize > 0)
+		vigilance = getAVGVigilance();
+	if(d_matchTrack)
+		vigilance = 0;
+	return vigilance;
+}
+
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+bool FixedArt<DIM, ACT, COMPLEMENT>::saveArtNetwork(std::string fileName) const
+{
+	std::ofstream outputFile(fileName.c_str(), std::ios::out | std::ios::binary);
+	if(!outputFile)
+	{
+		printf( "Cannot open ART output file.\n");
+		return false;
+	}
+
+	// the input size of Art never grows here
+	float inputSize = DIM;
+	bool useInputComplement = COMPLEMENT;
+	outputFile.write((char *) &d_vigilance, sizeof(float));
+	outputFile.write((char *) &d_alpha, sizeof(float));
+	outputFile.write((char *) &inputSize, sizeof(float));
+	outputFile.write((char *) &d_trackingValue, sizeof(float));
+	outputFile.write((char *) &d_learningFraction, sizeof(float));
+	outputFile.write((char *) &d_networkReliability, sizeof(float));
+	outputFile.write((char *) &d_vigilanceHistorySize, sizeof(int));
+	outputFile.write((char *) &d_currVHist, sizeof(int));
+	outputFile.write((char *) &d_compressionCount, sizeof(int));
+	outputFile.write((char *) &d_matchTrack, sizeof(bool));
+	outputFile.write((char *) &useInputComplement, sizeof(bool));
+	outputFile.write((char *) &d_useWTA, sizeof(bool));
+	outputFile.write((char *) &d_testMatch, sizeof(bool));
+
+	int size = SIZE;
+	outputFile.write((char *) &size, sizeof(int));
+	outputFile.write((char *) d_F1.data(), SIZE * sizeof(ART_TYPE));
+
+	size = d_F2.size();
+	outputFile.write((char *) &size, sizeof(int));
+	for (size_t x = 0; x < d_F2.size(); ++x)
+	{
+		size = SIZE;
+		outputFile.write((char *) &size, sizeof(int));
+		outputFile.write((char *) d_F2[x].data(), SIZE * sizeof(ART_TYPE));
+	}
+	size = d_vigilanceHist.size();
+	outputFile.write((char *) &size, sizeof(int));
+	for (size_t x = 0; x < d_vigilanceHist.size(); ++x)
+		outputFile.write((char *) &(d_vigilanceHist[x]), sizeof(ART_TYPE));
+
+	outputFile.close();
+	return true;
+}
+
+/**
+ * Like Art::loadArtNetWork() the prototypes and the vigilance history are appended to the ones
+ * the network already has.
+ */
+template <int DIM, ART_COMPUTATION_TYPE ACT, bool COMPLEMENT>
+bool FixedArt<DIM, ACT, COMPLEMENT>::loadArtNetWork(std::string fileName)
+{
+	std::ifstream inputFile(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(inputFile.fail())
+	{
+		printf("Failed loading Art input file\n");
+		return false;
+	}
+
+	float vigilance, alpha, inputSize, trackingValue, learningFraction, networkReliability;
+	int vigilanceHistorySize, currVHist, compressionCount;
+	bool matchTrack, useInputComplement, useWTA, testMatch;
+	inputFile.read((char *) &vigilance, sizeof(float));
+	inputFile.read((char *) &alpha, sizeof(float));
+	inputFile.read((char *) &inputSize, sizeof(float));
+	inputFile.read((char *) &trackingValue, sizeof(float));
+	inputFile.read((char *) &learningFraction, sizeof(float));
+	inputFile.read((char *) &networkReliability, sizeof(float));
+	inputFile.read((char *) &vigilanceHistorySize, sizeof(int));
+	inputFile.read((char *) &currVHist, sizeof(int));
+	inputFile.read((char *) &compressionCount, sizeof(int));
+	inputFile.read((char *) &matchTrack, sizeof(bool));
+	inputFile.read((char *) &useInputComplement, sizeof(bool));
+	inputFile.read((char *) &useWTA, sizeof(bool));
+	inputFile.read((char *) &testMatch, sizeof(bool));
+
+	// the last input, it is only kept if it has the right size
+	int size = 0;
+	inputFile.read((char *) &size, sizeof(int));
+	std::vector<ART_TYPE> F1(size > 0 ? size : 0);
+	if(size > 0)
+		inputFile.read((char *) &F1[0], size * sizeof(ART_TYPE));
+
+	int nrCategories = 0;
+	inputFile.read((char *) &nrCategories, sizeof(int));
+	if(!inputFile || useInputComplement != COMPLEMENT || nrCategories < 0)
+	{
+		printf("Cannot load an ART network with another input coding\n");
+		return false;
+	}
+	std::vector<Prototype> F2(nrCategories);
+	for (int x = 0; x < nrCategories; ++x)
+	{
+		inputFile.read((char *) &size, sizeof(int));
+		if(!inputFile || size != SIZE)
+		{
+			printf("Cannot load an ART network with prototypes of size %d, the size is %d\n", size, SIZE);
+			return false;
+		}
+		inputFile.read((char *) F2[x].data(), SIZE * sizeof(ART_TYPE));
+	}
+
+	inputFile.read((char *) &size, sizeof(int));
+	std::vector<ART_TYPE> vigilanceHist(size > 0 ? size : 0);
+	if(size > 0)
+		inputFile.read((char *) &vigilanceHist[0], size * sizeof(ART_TYPE));
+	if(!inputFile)
+	{
+		printf("Failed loading Art input file\n");
+		return false;
+	}
+	printf("Loading Art Network from file\n");
+
+	d_vigilance				= vigilance;
+	d_alpha					= alpha;
+	d_trackingValue			= trackingValue;
+	d_learningFraction		= learningFraction;
+	d_networkReliability	= networkReliability;
+	d_vigilanceHistorySize	= vigilanceHistorySize;
+	d_currVHist				= currVHist;
+	d_compressionCount		= compressionCount;
+	d_matchTrack			= matchTrack;
+	d_useWTA				= useWTA;
+	d_testMatch				= testMatch;
+	if((int)F1.size() == SIZE)
+		std::copy(F1.begin(), F1.end(), d_F1.begin());
+
+	for (int x = 0; x < nrCategories; ++x)
+	{
+		d_F2.push_back(F2[x]);
+		d_norms.push_back(getArtKernels().absSum(F2[x].data(), SIZE, 0));
+	}
+	d_vigilanceHist.insert(d_vigilanceHist.end(), vigilanceHist.begin(), vigilanceHist.end());
+	return true;
+}
+
+}
+
+#endif /* FIXEDART_H_ */
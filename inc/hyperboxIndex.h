@@ -0,0 +1,108 @@
+/*
+ * hyperboxIndex.h
+ *
+ * An R-tree over the F2 prototypes of a complement coded ART network
+ */
+
+#ifndef HYPERBOXINDEX_H_
+#define HYPERBOXINDEX_H_
+
+#include <vector>
+#include <cstddef>
+#include "artTypes.h"
+#include "prototypeMatrix.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * With complement coding a prototype Wj of 2M weights is a box in the M-dimensional input space:
+ * the first half is the lower corner u, one minus the second half the upper corner v. For an input
+ * x the fuzzy intersection is
+ *   |A n Wj| = M - sum_i (max(x_i, v_i) - min(x_i, u_i))
+ * which is M minus the size (sum of the edges) of the box grown to include x. So a node resonates
+ * (|A n Wj| >= vigilance M) exactly if its grown box is not larger than M (1 - vigilance), and the
+ * size of the grown box is the size of the box plus the L1 distance from x to the box.
+ *
+ * The index keeps the boxes in an R-tree. Every tree node has the bounding box of everything below
+ * it and the size of the smallest box below it, and their sum with the distance to the bounding
+ * box is a lower bound for all boxes below, so most of the tree is never visited. The boxes are only
+ * stored in the prototype matrix, the tree refers to them by F2 index.
+ *
+ * All prototypes have to have the same size 2M. Adding a prototype of another size makes the index
+ * invalid until it is rebuilt.
+ */
+class HyperboxIndex
+{
+public:
+	//! The maximum number of entries per tree node
+	static const int CAPACITY = 16;
+
+	HyperboxIndex();
+
+	//! Remove everything, the number of features is set by the next insert()
+	void clear();
+
+	//! Index all prototypes of F2
+	void build(const PrototypeMatrix &F2);
+
+	//! Add prototype "id" of F2, which must be the next one (ids are F2 indices)
+	void insert(const PrototypeMatrix &F2, int id);
+
+	//! The weights of prototype "id" have changed (with learning its box only grows)
+	void update(const PrototypeMatrix &F2, int id);
+
+	/**
+	 * Append to "ids" the prototypes of which the box grown to include x has a size of at most
+	 * maxSize. The test is done with a small margin, so that rounding never drops a node that the
+	 * choice function lets resonate: some nodes just above maxSize can be returned as well.
+	 */
+	void query(const PrototypeMatrix &F2, const ART_TYPE* x, ART_TYPE maxSize, std::vector<int> &ids) const;
+
+	//! The number of indexed prototypes
+	inline int size() const 							{ return d_leafOf.size(); }
+	//! M, the number of features of the input (half the prototype size)
+	inline int getNrFeatures() const 					{ return d_nrFeatures; }
+	//! False after a prototype of another size was added
+	inline bool isValid() const 						{ return d_valid; }
+private:
+	struct Node
+	{
+		int			parent;
+		int			count;
+		bool		leaf;
+		//! The smallest box size below this node
+		ART_TYPE	minSize;
+		//! Child nodes, or F2 indices in a leaf. One extra for the entry that causes a split.
+		int			entries[CAPACITY + 1];
+	};
+
+	std::vector<Node>		d_nodes;
+	//! Lower corner (M values) and upper corner (M values) of every node
+	std::vector<ART_TYPE>	d_bounds;
+	//! The leaf of every prototype
+	std::vector<int>		d_leafOf;
+	int						d_root;
+	int						d_nrFeatures;
+	bool					d_valid;
+
+	inline ART_TYPE* lower(int node) 					{ return &d_bounds[(size_t)node * 2 * d_nrFeatures]; }
+	inline ART_TYPE* upper(int node) 					{ return lower(node) + d_nrFeatures; }
+	inline const ART_TYPE* lower(int node) const 		{ return &d_bounds[(size_t)node * 2 * d_nrFeatures]; }
+	inline const ART_TYPE* upper(int node) const 		{ return lower(node) + d_nrFeatures; }
+
+	int newNode(bool leaf, int parent);
+	//! Recompute bounding box and smallest box size of a node from its entries
+	void recompute(const PrototypeMatrix &F2, int node);
+	//! The child of which the bounding box grows least when the box of "id" is added
+	int chooseChild(const PrototypeMatrix &F2, int node, int id) const;
+	//! Split an overfull node in two halves along the axis with the largest spread
+	void split(const PrototypeMatrix &F2, int node);
+	//! The centre of an entry along an axis
+	ART_TYPE centre(const PrototypeMatrix &F2, int node, int entry, int axis) const;
+	static ART_TYPE boxSize(const ART_TYPE* w, int M);
+};
+
+}
+
+#endif /* HYPERBOXINDEX_H_ */
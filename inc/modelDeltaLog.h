@@ -0,0 +1,167 @@
+/*
+ * modelDeltaLog.h
+ *
+ * Keep copies of an ARTMAP (or of a single ART network) on other hosts up to date by sending what
+ * changed since the version they have, instead of the whole model after every batch of training.
+ */
+
+#ifndef MODELDELTALOG_H_
+#define MODELDELTALOG_H_
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "artMap.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * What a record of the log does. Each one sets something to a value instead of changing it by an
+ * amount, so applying a record twice gives the same model as applying it once.
+ */
+enum MODEL_DELTA_TYPE
+{
+	//! Set the weights (and |Wj|) of a category, or add it if it is the next one
+	DELTA_CATEGORY = 1,
+	//! Remove categories: the new index of every old category follows, -1 if it was removed
+	DELTA_REMOVE,
+	//! Set both weights of a connection between a category and a map node (see ArtMap::setConnection())
+	DELTA_CONNECTION,
+	//! Remove all categories of a network, or with network -1 the whole map field
+	DELTA_RESET,
+	//! There are at least mapNode + 1 map nodes
+	DELTA_MAP_NODES,
+	//! The order of the connections of a map node to a network: its categories follow (int)
+	DELTA_ORDER
+};
+
+/**
+ * A record as it is written, followed by "count" values: the weights (ART_TYPE) of a category, the
+ * remap (int) of a removal or the categories (int) of an order.
+ */
+struct ModelDelta
+{
+	uint64_t	version;
+	uint32_t	type;
+	int32_t		network;
+	int32_t		category;
+	int32_t		mapNode;
+	//! The weight from the category to the map node, or |Wj| of a category
+	float		weight;
+	//! The weight from the map node to the category
+	float		backWeight;
+	uint32_t	count;
+	//! Which of the connections between the category and the map node
+	uint32_t	occurrence;
+};
+
+/**
+ * What is written ahead of the records. A receiver that has fromVersion or a later version can
+ * apply them, it skips those it already has. The records of a whole log start with a checkpoint,
+ * its fromVersion is 0.
+ */
+struct ModelDeltaHeader
+{
+	char		magic[8];
+	uint32_t	byteOrder;
+	uint32_t	typeSize;
+	uint64_t	fromVersion;
+	uint64_t	toVersion;
+	uint64_t	nrRecords;
+};
+
+/**
+ * Records every change of an ARTMAP and its ART networks (or of one ART network) as it is trained,
+ * through the change and prune listeners of the model, each change with the next version number.
+ *
+ * A peer that has version N of the model asks for writeSince(N) and applies that to its copy with
+ * apply(), after which it has the version of the log. A peer that is too far behind (N is older
+ * than the log, see compact()) or that has nothing yet gets the whole log, which starts with a
+ * checkpoint of all the model. The log can also be saved, and replayed on top of the model in the
+ * same state (e.g. an image of it), or from scratch.
+ *
+ * Only what is learned is logged: the peer has to be made with the same networks and parameters.
+ * Changes the model makes without telling its listeners (loading a file or image, syncFrom()) are
+ * not in the log, compact() after them. A peer should not train itself nor prune on its own.
+ */
+class ModelDeltaLog
+{
+public:
+	ModelDeltaLog();
+	//! Detaches from the model
+	~ModelDeltaLog();
+
+	/**
+	 * Start logging the changes of an ARTMAP and of the ART networks it has now, which takes their
+	 * change listeners and the prune listener of the ARTMAP. The log starts with a checkpoint.
+	 */
+	void attach(ArtMap* artMap);
+	//! The same for a network that is not part of an ARTMAP, this takes its prune listener
+	void attach(Art* art);
+	void detach();
+
+	//! The version of the last change, 0 if there are none
+	inline uint64_t getVersion() const 					{ return d_version; }
+	//! The version before the first record of the log, older versions get the whole log
+	inline uint64_t getBaseVersion() const 				{ return d_baseVersion; }
+	inline size_t getNrRecords() const 					{ return d_offsets.size(); }
+	//! The size of the records in memory
+	inline size_t getBytes() const 						{ return d_records.size(); }
+
+	/**
+	 * Replace the log by a checkpoint of the model as it is now, so it does not keep growing with
+	 * changes that were overwritten since. Peers older than this get the whole (short) log after.
+	 * Returns false if no model is attached.
+	 */
+	bool compact();
+
+	//! Write the changes after the given version, returns false if the stream failed
+	bool writeSince(uint64_t version, std::ostream &output) const;
+	bool save(std::string fileName) const;
+
+	/**
+	 * Apply what writeSince() wrote to a copy of the model. "version" is the version the copy has,
+	 * and after it the version of the last record that was applied. Returns false (printed) if
+	 * the records do not fit the copy, or if they need a newer version than it has.
+	 */
+	static bool apply(std::istream &input, ArtMap &artMap, uint64_t &version);
+	static bool apply(std::istream &input, Art &art, uint64_t &version);
+	static bool replay(std::string fileName, ArtMap &artMap, uint64_t &version);
+	static bool replay(std::string fileName, Art &art, uint64_t &version);
+private:
+	ArtMap*				d_artMap;
+	std::vector<Art*>	d_networks;
+	uint64_t			d_version;
+	uint64_t			d_baseVersion;
+	//! The records back to back, and where each one starts
+	std::vector<char>	d_records;
+	std::vector<size_t>	d_offsets;
+
+	//! Append a record with the next version
+	void append(MODEL_DELTA_TYPE type, int network, int category, int mapNode, float weight, float backWeight,
+			const void* values = NULL, int count = 0, size_t valueSize = 0, int occurrence = 0);
+	void appendCategory(int network, int category);
+	//! Append every connection between a category and a map node
+	void appendConnections(int network, int category, int mapNode);
+	//! Append the connections of the map field in the order the ARTMAP has them
+	void appendMapField();
+	int getNetworkNr(const Art* art) const;
+
+	static void onArtChanged(void* context, const Art* art, int category);
+	static void onArtPruned(void* context, const Art* art, const std::vector<int> &remap);
+	static void onArtMapChanged(void* context, const ArtMap* artMap, int network, int category, int mapNode);
+
+	static bool apply(std::istream &input, std::vector<Art*> &networks, ArtMap* artMap, uint64_t &version);
+	static bool applyRecord(const ModelDelta &delta, const std::vector<char> &values, std::vector<Art*> &networks,
+			ArtMap* artMap);
+
+	// not copyable
+	ModelDeltaLog(const ModelDeltaLog&);
+	ModelDeltaLog& operator=(const ModelDeltaLog&);
+};
+
+}
+
+#endif /* MODELDELTALOG_H_ */
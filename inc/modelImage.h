@@ -0,0 +1,187 @@
+/*
+ * modelImage.h
+ *
+ * A binary file format for trained networks that is laid out like the networks are in memory, so
+ * that a file can be mapped and used as it is instead of read value by value.
+ */
+
+#ifndef MODELIMAGE_H_
+#define MODELIMAGE_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace almendeSensorFusion
+{
+
+//! What an image file holds
+enum MODEL_IMAGE_KIND
+{
+	MODEL_IMAGE_ART = 1,
+	MODEL_IMAGE_ARTMAP = 2
+};
+
+/**
+ * The sections of an image. A reader skips the sections it does not know, so new ones can be added
+ * without a new version, as long as the old ones keep their meaning.
+ */
+enum MODEL_IMAGE_SECTION
+{
+	// Art
+	SECTION_ART_PARAMETERS = 1,
+	SECTION_ART_F1,
+	SECTION_ART_VIGILANCE_HISTORY,
+	SECTION_ART_INPUT_OFFSET,
+	SECTION_ART_INPUT_SCALE,
+	// PrototypeMatrix
+	SECTION_PROTOTYPE_ROW_SIZES = 16,
+	SECTION_PROTOTYPE_NORMS,
+	SECTION_PROTOTYPE_WINS,
+	SECTION_PROTOTYPE_LAST_WINS,
+	SECTION_PROTOTYPE_ROWS,
+	// ArtMap
+	SECTION_ARTMAP_PARAMETERS = 32,
+	SECTION_ARTMAP_F2_LISTS,
+	SECTION_ARTMAP_F2_EDGES,
+	SECTION_ARTMAP_F2_IDS,
+	SECTION_ARTMAP_F2_WEIGHTS,
+	SECTION_ARTMAP_NODE_LISTS,
+	SECTION_ARTMAP_NODE_EDGES,
+	SECTION_ARTMAP_NODE_IDS,
+	SECTION_ARTMAP_NODE_WEIGHTS
+};
+
+/**
+ * An image starts with this header and a table of nrSections ModelImageSection, the sections
+ * follow at their offset. The byte order mark is written as a number by the host that wrote the
+ * file: a host with a different byte order (or size of ART_TYPE) cannot map it and refuses it.
+ */
+struct ModelImageHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	kind;
+	uint32_t	byteOrder;
+	uint32_t	typeSize;
+	uint32_t	nrSections;
+	uint32_t	reserved;
+	uint64_t	fileBytes;
+};
+
+struct ModelImageSection
+{
+	uint32_t	id;
+	uint32_t	reserved;
+	uint64_t	offset;
+	uint64_t	bytes;
+};
+
+/**
+ * A file mapped copy-on-write: the pages are those of the page cache, shared by every process that
+ * maps the file, until a process writes to one (e.g. by training), which then gets its own copy
+ * of that page. The file is unmapped when the last owner of a pointer into it releases it.
+ */
+class MappedFile
+{
+public:
+	//! Map a whole file with one reference, NULL if that fails (printed)
+	static MappedFile* open(const std::string &fileName);
+
+	inline char* data() const 							{ return d_data; }
+	inline size_t size() const 							{ return d_size; }
+
+	void retain();
+	void release();
+private:
+	MappedFile(char* data, size_t size);
+	~MappedFile();
+
+	char*	d_data;
+	size_t	d_size;
+	int		d_references;
+
+	// not copyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+/**
+ * Collects the sections of an image and writes them, each at an offset aligned to its alignment
+ * (at least the cache line of PrototypeMatrix), in one write per section.
+ */
+class ModelImageWriter
+{
+public:
+	static const int VERSION = 1;
+	static const size_t SECTION_ALIGNMENT = 64;
+	//! For sections that are used in place as large arrays, so they start on a page of their own
+	static const size_t PAGE_ALIGNMENT = 4096;
+
+	ModelImageWriter(MODEL_IMAGE_KIND kind);
+
+	//! The data is not copied, it has to stay the same until write()
+	void addSection(int id, const void* data, size_t bytes, size_t alignment = SECTION_ALIGNMENT);
+	template<class T> inline void addArray(int id, const std::vector<T> &values, size_t alignment = SECTION_ALIGNMENT)
+	{ addSection(id, values.empty() ? NULL : &values[0], values.size() * sizeof(T), alignment); }
+
+	//! Returns false if the file cannot be written (printed)
+	bool write(const std::string &fileName) const;
+private:
+	struct Pending
+	{
+		int			id;
+		const void*	data;
+		size_t		bytes;
+		size_t		alignment;
+	};
+	MODEL_IMAGE_KIND		d_kind;
+	std::vector<Pending>	d_sections;
+};
+
+/**
+ * A mapped image. The sections are pointers into the mapping, valid as long as the image is open,
+ * or as long as a reference to getFile() is kept.
+ */
+class ModelImage
+{
+public:
+	ModelImage();
+	~ModelImage();
+
+	//! Map the file and check that it is an image of the given kind this host can use
+	bool open(const std::string &fileName, MODEL_IMAGE_KIND kind);
+	void close();
+
+	inline MappedFile* getFile() const 					{ return d_file; }
+
+	//! A section, NULL (and 0 bytes) if the image does not have it
+	const void* getSection(int id, size_t &bytes) const;
+	//! A section as an array of "count" values
+	template<class T> inline const T* getArray(int id, int &count) const
+	{
+		size_t bytes = 0;
+		const T* values = (const T*) getSection(id, bytes);
+		count = bytes / sizeof(T);
+		return values;
+	}
+	//! Copy a section into a vector, returns false if it is not there
+	template<class T> inline bool getArray(int id, std::vector<T> &values) const
+	{
+		int count = 0;
+		const T* data = getArray<T>(id, count);
+		values.assign(data, data + count);
+		return data != NULL;
+	}
+private:
+	MappedFile*	d_file;
+
+	// not copyable
+	ModelImage(const ModelImage&);
+	ModelImage& operator=(const ModelImage&);
+};
+
+}
+
+#endif /* MODELIMAGE_H_ */
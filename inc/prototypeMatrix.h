@@ -0,0 +1,208 @@
+/*
+ * prototypeMatrix.h
+ *
+ * The long-term memory of an ART network stored as one contiguous block of memory. Every F2 node
+ * owns one row of the matrix, all rows have the same (padded) stride, and the block itself is
+ * aligned on a cache line. Scoring an input against all prototypes is then a linear walk through
+ * memory instead of a pointer chase per node.
+ */
+
+#ifndef PROTOTYPEMATRIX_H_
+#define PROTOTYPEMATRIX_H_
+
+#include <vector>
+#include <cstddef>
+#include "artTypes.h"
+#include "modelImage.h"
+#include "compactModel.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * A read-only view on the weights of one F2 node. It does not own the weights, so it is only valid
+ * as long as the network is not changed (a new prototype might move the underlying storage).
+ */
+class PrototypeView
+{
+public:
+	PrototypeView(): d_data(NULL), d_size(0) {}
+	PrototypeView(const ART_TYPE* data, int size): d_data(data), d_size(size) {}
+
+	inline int size() const 						{ return d_size; }
+	inline bool empty() const 						{ return d_size == 0; }
+	inline const ART_TYPE* data() const 			{ return d_data; }
+	inline ART_TYPE operator[](int i) const 		{ return d_data[i]; }
+	inline ART_TYPE at(int i) const 				{ return d_data[i]; }
+
+	//! Copy the weights, for the (rare) case they have to outlive the network
+	inline PROTOTYPE toPrototype() const 			{ return PROTOTYPE(d_data, d_data + d_size); }
+private:
+	const ART_TYPE* d_data;
+	int d_size;
+};
+
+/**
+ * The rows of one length, in the order of their index. Nearly every network has a single bucket, one
+ * that saw inputs of different sizes has one per size.
+ */
+struct RowBucket
+{
+	int					size;
+	std::vector<int>	rows;
+};
+
+/**
+ * The prototype matrix has a row per F2 node. A network can see inputs of different sizes over its
+ * lifetime (e.g. when sensors are added to a robot), so each row remembers its own length. The
+ * stride is the longest row rounded up to a cache line, the padding is always zero.
+ *
+ * Next to the weights the matrix keeps the L1-norm |Wj| of every row. It is computed when a row is
+ * added, whoever writes into a row through getRowData() has to store the new norm with setNorm().
+ * The rows are also grouped by their length (see RowBucket), so the alignment of a prototype to F1
+ * can be worked out once for all rows of a size, and every row has usage statistics (how often and
+ * when it last won) to decide which prototypes to remove when the network is over its budget.
+ *
+ * Every write is counted: a row remembers the count of its last write (appendRow(), setNorm(),
+ * recordWin()), so that a copy of the matrix can be brought up to date by copying only the rows
+ * written since, see syncFrom(). Removing rows changes the layout, after which a copy is copied again as a whole.
+ *
+ * The weights can also be those of a mapped model image (see mapImage()), used in place. Writing
+ * into them only changes the private copy of the page, appending a row moves all of them to memory
+ * of the matrix itself.
+ */
+class PrototypeMatrix
+{
+public:
+	//! Rows start at a multiple of this many bytes
+	static const int ALIGNMENT = 64;
+
+	PrototypeMatrix();
+	PrototypeMatrix(const PrototypeMatrix &other);
+	PrototypeMatrix& operator=(const PrototypeMatrix &other);
+	~PrototypeMatrix();
+
+	//! The number of prototypes (rows)
+	inline int size() const 						{ return d_rows; }
+	inline bool empty() const 						{ return d_rows == 0; }
+
+	//! Number of floats between the start of two consecutive rows
+	inline int getStride() const 					{ return d_stride; }
+	inline int getRowSize(int row) const 			{ return d_rowSizes[row]; }
+	//! The length of the longest and of the shortest prototype
+	inline int getMaxRowSize() const 				{ return d_maxRowSize; }
+	inline int getMinRowSize() const 				{ return d_minRowSize; }
+	//! The rows grouped by length, the buckets are in the order of their first row
+	inline int getNrBuckets() const 				{ return d_buckets.size(); }
+	inline const RowBucket& getBucket(int bucket) const { return d_buckets[bucket]; }
+
+	inline ART_TYPE* getRowData(int row) 			{ return d_data + (size_t)row * d_stride; }
+	inline const ART_TYPE* getRowData(int row) const { return d_data + (size_t)row * d_stride; }
+	inline PrototypeView getRow(int row) const 		{ return PrototypeView(getRowData(row), d_rowSizes[row]); }
+	inline PrototypeView operator[](int row) const 	{ return getRow(row); }
+	inline PrototypeView at(int row) const 			{ return getRow(row); }
+
+	//! The cached |Wj| of a row, and of all rows (for the kernels)
+	inline ART_TYPE getNorm(int row) const 			{ return d_norms[row]; }
+	inline const ART_TYPE* getNorms() const 		{ return d_norms.empty() ? NULL : &d_norms[0]; }
+	inline void setNorm(int row, ART_TYPE norm) 	{ d_norms[row] = norm; d_rowVersions[row] = ++d_version; }
+
+	//! How often a row won, and the time of its last win (in inputs of the network, see Art)
+	inline unsigned int getWins(int row) const 		{ return d_wins[row]; }
+	inline unsigned int getLastWin(int row) const 	{ return d_lastWins[row]; }
+	inline void recordWin(int row, unsigned int time) { ++d_wins[row]; d_lastWins[row] = time; d_rowVersions[row] = ++d_version; }
+
+	//! Add a prototype at the end, returns its index
+	int appendRow(const ART_TYPE* values, int size);
+	inline int appendRow(const PROTOTYPE &values) 	{ return appendRow(values.empty() ? NULL : &values[0], values.size()); }
+	//! Add the complement coded prototype of the values: the values followed by 1 - the values
+	int appendComplementRow(const ART_TYPE* values, int size);
+
+	/**
+	 * Remove every row for which "remove" is true, in one pass: the rows after a removed one move
+	 * up and keep their order. "remap" gets the new index of every old row, or -1 if it was removed.
+	 */
+	void removeRows(const std::vector<bool> &remove, std::vector<int> &remap);
+
+	/**
+	 * Make this matrix equal to "source" again, where this is a copy of source (by the copy
+	 * constructor, assignment or an earlier syncFrom()). If the layout of source did not change
+	 * since, only the rows written since are copied and the new rows appended, otherwise (or if
+	 * this was never a copy of source) all of it is copied.
+	 */
+	void syncFrom(const PrototypeMatrix &source);
+
+	//! Make room for the given number of rows without moving the matrix again
+	void reserve(int rows);
+	void clear();
+
+	//! Add the sections of the matrix to an image, the rows with their stride on pages of their own
+	void addToImage(ModelImageWriter &image) const;
+	/**
+	 * Replace the matrix by the one in an image, of which the weights are used where they are. The
+	 * rest (row sizes, norms and usage) is copied, it is small next to the weights. Returns false
+	 * (and leaves the matrix empty) if the image has no valid matrix.
+	 */
+	bool mapImage(const ModelImage &image);
+	/**
+	 * Write the rows to a compact model (see CompactWriter), rounded to the weight bits of the
+	 * writer if it has them. With complementCoded the rows are taken to be a prototype followed by
+	 * its complement coded upper bound, and of a row of which the upper bound is the prototype
+	 * itself (a category that learned one input) only the first half is written.
+	 */
+	void writeCompact(CompactWriter &output, bool complementCoded) const;
+	/**
+	 * Replace the matrix by the rows a compact model holds, decoded straight into the rows, which
+	 * are allocated once. Returns false (and leaves the matrix empty) if the rows are not valid.
+	 */
+	bool readCompact(CompactReader &input, bool complementCoded);
+	//! Exchange all rows with those of another matrix, without copying them
+	void swap(PrototypeMatrix &other);
+	//! The weights are in a mapped file
+	inline bool isMapped() const 					{ return d_mapping != NULL; }
+
+	//! Bytes allocated for the weights
+	inline size_t getAllocatedBytes() const 		{ return (size_t)d_capacity * d_stride * sizeof(ART_TYPE); }
+	//! Bytes used per row: the weights at the current stride and what is kept next to them
+	size_t getRowBytes() const;
+private:
+	ART_TYPE*			d_data;
+	//! The file d_data points into, or NULL if d_data was allocated
+	MappedFile*			d_mapping;
+	int					d_rows;
+	int					d_capacity;
+	int					d_stride;
+	int					d_maxRowSize;
+	int					d_minRowSize;
+	std::vector<int>	d_rowSizes;
+	std::vector<ART_TYPE> d_norms;
+	std::vector<RowBucket> d_buckets;
+	std::vector<unsigned int> d_wins;
+	std::vector<unsigned int> d_lastWins;
+	//! The number of writes, and per row the number at its last write
+	unsigned int		d_version;
+	std::vector<unsigned int> d_rowVersions;
+	//! A number no other matrix has, that changes when rows are removed
+	unsigned int		d_layout;
+	//! The layout and version of the matrix this is a copy of, see syncFrom()
+	unsigned int		d_syncLayout;
+	unsigned int		d_syncVersion;
+
+	//! Allocate a new block and copy the existing rows into it
+	void reallocate(int capacity, int stride);
+	//! Free or unmap the weights
+	void releaseData();
+	//! Make room for one more row of the given size, add it to its bucket and return it (d_rows is
+	//! not counted yet)
+	ART_TYPE* newRow(int size);
+	//! Add a row to the bucket of its size
+	void addToBucket(int row, int size);
+	//! Group the rows by length again
+	void rebuildBuckets();
+	static int alignStride(int size);
+	static unsigned int newLayout();
+};
+
+}
+
+#endif /* PROTOTYPEMATRIX_H_ */
@@ -0,0 +1,143 @@
+/*
+ * quantizedArt.h
+ *
+ * A frozen, read-only copy of a trained Art network with 8 bit or half precision weights, for
+ * classifying on hosts where the prototypes do not fit in the cache as floats.
+ */
+
+#ifndef QUANTIZEDART_H_
+#define QUANTIZEDART_H_
+
+#include <vector>
+#include <cstddef>
+#include "art.h"
+#include "artKernels.h"
+
+namespace almendeSensorFusion
+{
+
+enum ART_QUANTIZATION
+{
+	QUANTIZE_UINT8,		// 1 byte per weight, fixed point with one scale for the whole network
+	QUANTIZE_FP16		// 2 bytes per weight, IEEE half precision
+};
+
+/**
+ * How much a quantized network differs from the float network it was made of, on a set of inputs.
+ * See QuantizedArt::compare().
+ */
+struct QuantizationReport
+{
+	int			nrInputs;
+	//! Fraction of the inputs with the same winner (or none for both)
+	float		agreement;
+	//! Fraction of the inputs of which the winner has the right label, -1 without labels
+	float		floatAccuracy;
+	float		quantizedAccuracy;
+	//! Difference in resonance of the winner, for the inputs with the same winner
+	float		maxResonanceError;
+	float		meanResonanceError;
+	//! Memory of the weights (without the float copy for rechecking)
+	size_t		floatBytes;
+	size_t		quantizedBytes;
+};
+
+/**
+ * The prototypes of a trained network, quantized, and the parameters needed to classify with them.
+ * Classifying is the same as Art::classifyBatch() (no learning, winner or -1), but with the
+ * quantized weights. The choice function uses the float |Wj| of the original network, so only the
+ * fuzzy intersection is approximated.
+ *
+ * With 8 bits the weights and the input are rounded to the same grid of 256 steps over [0, 1] (or
+ * the range of the weights if that is larger), so the sums over a prototype are exact integers
+ * and the fuzzy intersection is off by at most half a step per weight. Inputs are expected in
+ * [0, 1], like for complement coding.
+ *
+ * The quantized winner can differ from the float winner when nodes are close. With recheck > 0 a
+ * float copy of the prototypes is kept, and the recheck best nodes of the quantized scores are
+ * scored again with the float weights to pick the winner. That copy is only read for those few
+ * nodes per input.
+ *
+ * Every row is padded to a multiple of 16 bytes, so that rows start on a vector boundary without
+ * wasting much of the cache on small prototypes: a row of 16 weights is 16 bytes with 8 bits and
+ * 32 bytes with half precision. The kernels load unaligned, wider vectors do not need more.
+ *
+ * Only networks of which all prototypes have the same size can be frozen.
+ */
+class QuantizedArt
+{
+public:
+	QuantizedArt(const Art &art, ART_QUANTIZATION type = QUANTIZE_UINT8, int recheck = 0);
+
+	//! False if the network could not be frozen (prototypes of different sizes)
+	inline bool isValid() const 						{ return d_valid; }
+	inline ART_QUANTIZATION getType() const 			{ return d_type; }
+	inline int getRecheck() const 						{ return d_recheck; }
+	//! The number of prototypes
+	inline int size() const 							{ return d_nrCategories; }
+	//! The number of input values (before complement coding)
+	inline int getNrFeatures() const 					{ return d_nrFeatures; }
+	//! Bytes of quantized weights
+	size_t getWeightBytes() const;
+
+	//! The winning node for one input of getNrFeatures() values, or -1 if none resonates
+	int classify(const ART_TYPE* input, ART_TYPE* resonance = NULL) const;
+
+	//! Classify a row-major nrInputs x getNrFeatures() matrix, see Art::classifyBatch()
+	void classifyBatch(const ART_TYPE* inputs, int nrInputs, int* winners, ART_TYPE* resonances = NULL) const;
+
+	/**
+	 * Classify the inputs with the float network "art" (the one this was made of) and with this
+	 * one, and report how much they agree. If the inputs have labels and the nodes of the network
+	 * have labels (e.g. the supervisor classes of an ARTMAP), the accuracy of both is reported too.
+	 */
+	QuantizationReport compare(const Art &art, const ART_TYPE* inputs, int nrInputs,
+			const int* labels = NULL, const std::vector<int>* categoryLabels = NULL) const;
+private:
+	ART_QUANTIZATION	d_type;
+	int					d_recheck;
+	bool				d_valid;
+
+	// Parameters of the network
+	bool				d_useInputComplement;
+	ART_COMPUTATION_TYPE d_ACT;
+	float				d_alpha;
+	float				d_vigilance;
+
+	int					d_nrFeatures;
+	//! Weights per prototype (2 * d_nrFeatures with complement coding)
+	int					d_rowSize;
+	//! Weights between the start of two prototypes, rows are padded to 16 bytes
+	int					d_stride;
+	int					d_nrCategories;
+
+	//! The input range of the network, see Art::setInputRange()
+	std::vector<ART_TYPE> d_inputOffset;
+	std::vector<ART_TYPE> d_inputScale;
+
+	//! 8 bits: w = d_offset + q * d_scale
+	ART_TYPE			d_offset;
+	ART_TYPE			d_scale;
+	//! Half precision: the largest rounding error of a weight
+	ART_TYPE			d_halfError;
+	std::vector<ART_BYTE> d_bytes;
+	std::vector<ART_HALF> d_halves;
+
+	//! |Wj| of the float weights
+	std::vector<ART_TYPE> d_norms;
+	//! The float weights, only with recheck > 0
+	PrototypeMatrix		d_F2;
+
+	//! F1 of an input (scaled to the input range and complement coded if needed), and its 8 bit version
+	void createF1(const ART_TYPE* input, ART_TYPE* F1, ART_BYTE* F1Bytes) const;
+
+	//! The quantized |A n Wj| (or the distance without complement coding) of node x
+	ART_TYPE quantizedDiff(const ArtKernels &kernels, const ART_TYPE* F1, const ART_BYTE* F1Bytes, int x) const;
+
+	//! Tj and resonance from |A n Wj|, as in Art::scoreCategory(). Returns false if x is no candidate.
+	bool activation(ART_TYPE diff, int x, PROTOTYPE_Activation &pa) const;
+};
+
+}
+
+#endif /* QUANTIZEDART_H_ */
@@ -0,0 +1,93 @@
+/*
+ * shardedArt.h
+ *
+ * Classify with an ART network of which F2 is split over several worker processes on the same
+ * host, for networks with more categories than one process can search in time.
+ */
+
+#ifndef SHARDEDART_H_
+#define SHARDEDART_H_
+
+#include <sys/types.h>
+#include <vector>
+#include "art.h"
+
+namespace almendeSensorFusion
+{
+
+/**
+ * Every shard is a process forked from the caller that searches a contiguous range of the F2 nodes
+ * (see Art::predictRange()). The forked process shares the weights with the caller until either of
+ * them writes to them, so a shard only ever reads (and keeps in its caches) its own part of F2.
+ *
+ * predict() sends the input to all shards over their Unix socket, they search at the same time
+ * and send back their best candidates (id, T and resonance), and these are merged in the ComparePrototype
+ * order (see Art::predictFrom()). The output is the same as that of Art::predict() of the network.
+ *
+ * The shards see the network as it was when they were started: after training it, start new ones.
+ * One thread at a time can predict.
+ */
+class ShardedArt
+{
+public:
+	//! Start nrShards processes for "art", which has to outlive this
+	ShardedArt(const Art &art, int nrShards);
+	//! Stops the shards
+	~ShardedArt();
+
+	//! The number of shards that are running, 0 if they could not be started
+	inline int getNrShards() const 						{ return d_shards.size(); }
+	//! The first F2 node of a shard, the last one is the first of the next
+	inline int getShardBegin(int shard) const 			{ return d_shards[shard].begin; }
+	inline int getShardEnd(int shard) const 			{ return d_shards[shard].end; }
+
+	/**
+	 * The output of Art::predict() for the input, with the base vigilance of the network. Returns
+	 * false if no node resonates, or if a shard did not answer (that is printed). In the last case
+	 * all shards are stopped, getNrShards() is 0 after that.
+	 */
+	bool predict(const ART_TYPE* input, int nrFeatures, ArtResult &result);
+	inline bool predict(const ART_ASPECT &input, ArtResult &result)
+	{ return predict(input.empty() ? NULL : &input[0], input.size(), result); }
+private:
+	struct Shard
+	{
+		pid_t	pid;
+		//! The socket of the caller, the shard has the other end
+		int		socket;
+		int		begin;
+		int		end;
+	};
+
+	//! What predict() sends ahead of the input
+	struct Request
+	{
+		//! The number of input features, -1 stops the shard
+		int		nrFeatures;
+		float	vigilance;
+		//! The number of candidates asked for
+		int		k;
+	};
+
+	const Art&				d_art;
+	std::vector<Shard>		d_shards;
+	//! The candidates of all shards, and the short-term memory to merge them
+	std::vector<PROTOTYPE_Activation> d_candidates;
+	ArtContext				d_context;
+
+	//! The loop of a shard process, it ends when the caller stops it or goes away
+	static void serve(const Art &art, int socket, int begin, int end);
+	void stop();
+
+	//! Send or receive all bytes, false if the other side is gone
+	static bool sendAll(int socket, const void* data, size_t bytes);
+	static bool receiveAll(int socket, void* data, size_t bytes);
+
+	// not copyable
+	ShardedArt(const ShardedArt&);
+	ShardedArt& operator=(const ShardedArt&);
+};
+
+}
+
+#endif /* SHARDEDART_H_ */
@@ -0,0 +1,71 @@
+/*
+ * workerPool.h
+ *
+ * A small set of persistent threads that execute the tasks of one job at a time. It is used to
+ * spread the scoring of large F2 layers over several cores without creating threads per input.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <pthread.h>
+#include <vector>
+
+namespace almendeSensorFusion
+{
+
+class WorkerPool
+{
+public:
+	//! A task gets the context of the job and its own index in [0, nrTasks)
+	typedef void (*TASK)(void* context, int task);
+
+	//! Start a pool with nrThreads threads (the thread calling run() helps out as well)
+	WorkerPool(int nrThreads);
+	~WorkerPool();
+
+	inline int getNrThreads() const { return d_threads.size(); }
+
+	/**
+	 * Execute task(context, 0) up to task(context, nrTasks-1) on the pool and the calling thread,
+	 * and return when all of them are done. Jobs of different callers are executed one after the
+	 * other.
+	 */
+	void run(TASK task, void* context, int nrTasks);
+	//! run(), unless the pool is busy with the job of another caller: then false and nothing ran
+	bool tryRun(TASK task, void* context, int nrTasks);
+
+	//! A pool shared by everyone that asks for the same number of threads, it lives until exit
+	static WorkerPool* getShared(int nrThreads);
+private:
+	std::vector<pthread_t> d_threads;
+
+	//! Only one job at a time
+	pthread_mutex_t d_jobMutex;
+
+	//! Protects the state of the current job
+	pthread_mutex_t d_mutex;
+	pthread_cond_t d_start;
+	pthread_cond_t d_done;
+
+	TASK		d_task;
+	void*		d_context;
+	int			d_nrTasks;
+	int			d_nextTask;
+	int			d_busy;
+	unsigned	d_generation;
+	bool		d_stop;
+
+	//! Execute tasks of the current job until there are none left
+	void work(unsigned generation);
+	void execute(TASK task, void* context, int nrTasks);
+	static void* threadMain(void* pool);
+
+	// not copyable
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
+
+}
+
+#endif /* WORKERPOOL_H_ */
@@ -22,11 +22,18 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <time.h>
 #include <assert.h>
+#include <algorithm>
 #include <artMap.h>
 #include <art.h>
+#include <modelDeltaLog.h>
+#include <fixedArt.h>
+#include <artMapPublisher.h>
+#include <shardedArt.h>
 
 #if (RUNONPC==true)
 #include <DataDecorator.h>
@@ -76,15 +83,775 @@ void getRandomSample(ART_ASPECT *aspect, ART_TYPE &class_id) {
 	class_id = cl;
 }
 
+void configure(Art &input, Art &supervisor) {
+	input.setVigilance(0.80);
+	input.setNetworkReliability(0.8);
+	supervisor.setVigilance(0.99);
+	supervisor.setNetworkReliability(1.0);
+}
+
+void trainSamples(ArtMap &artmap, int n) {
+	ART_ASPECT aspect;
+	ART_TYPE class_id;
+	ART_DISTRIBUTED_CLASS cl;
+	ART_VIEW inputVector;
+	for (int t = 0; t < n; ++t) {
+		getRandomSample(&aspect, class_id);
+		cl.clear();
+		cl.push_back(class_id);
+		inputVector.clear();
+		inputVector.push_back(&aspect);
+		inputVector.push_back(&cl);
+		ART_DISTRIBUTED_CLASSES *output = artmap.classify(inputVector);
+		for (int x = 0; x < (int)output->size(); ++x)
+			delete (*output)[x];
+		delete output;
+	}
+}
+
+/**
+ * The same prototypes, and the same norms unless those are computed again on loading (the legacy
+ * format does not have them, and the learning rule sums them in another order).
+ */
+bool sameNetwork(const Art &a, const Art &b, bool norms) {
+	const PrototypeMatrix &F2a = *a.getF2(), &F2b = *b.getF2();
+	if(F2a.size() != F2b.size())
+		return false;
+	for (int x = 0; x < F2a.size(); ++x) {
+		if(F2a.getRowSize(x) != F2b.getRowSize(x) || (norms && F2a.getNorm(x) != F2b.getNorm(x)))
+			return false;
+		for (int i = 0; i < F2a.getRowSize(x); ++i)
+			if(F2a.getRowData(x)[i] != F2b.getRowData(x)[i])
+				return false;
+	}
+	return true;
+}
+
+//! The same connections with the same weights, in the same order
+bool sameMapField(const ArtMap &a, const ArtMap &b) {
+	if(a.getNrMapNodes() != b.getNrMapNodes())
+		return false;
+	std::vector<int> first, second;
+	for (int n = 0; n < a.getNrArtNetworks(); ++n) {
+		for (int c = 0; c < a.getArtNetwork(n)->getF2()->size(); ++c) {
+			a.getMapNodes(n, c, first);
+			b.getMapNodes(n, c, second);
+			if(first != second)
+				return false;
+			for (int i = 0; i < (int)first.size(); ++i) {
+				ART_TYPE wa, ba, wb, bb;
+				a.getConnection(n, c, first[i], wa, ba);
+				b.getConnection(n, c, first[i], wb, bb);
+				if(wa != wb || ba != bb)
+					return false;
+			}
+		}
+		for (int m = 0; m < a.getNrMapNodes(); ++m) {
+			a.getCategories(n, m, first);
+			b.getCategories(n, m, second);
+			if(first != second)
+				return false;
+		}
+	}
+	return true;
+}
+
+//! Both predict the same winners for the input network and the supervisor
+bool samePredictions(const ArtMap &a, const ArtMap &b, int n) {
+	ART_ASPECT aspect;
+	ART_TYPE class_id;
+	ART_VIEW inputVector;
+	ArtMapContext contextA, contextB;
+	std::vector<ArtResult> resultsA, resultsB;
+	for (int t = 0; t < n; ++t) {
+		getRandomSample(&aspect, class_id);
+		inputVector.clear();
+		inputVector.push_back(&aspect);
+		inputVector.push_back(NULL);
+		bool foundA = a.predict(inputVector, resultsA, contextA);
+		bool foundB = b.predict(inputVector, resultsB, contextB);
+		if(foundA != foundB || resultsA.size() != resultsB.size())
+			return false;
+		for (int x = 0; x < (int)resultsA.size(); ++x)
+			if(resultsA[x].getValues() != resultsB[x].getValues())
+				return false;
+	}
+	return true;
+}
+
+bool report(const string &check, bool passed) {
+	cout << check << ": " << (passed ? "ok" : "FAILED") << endl;
+	return passed;
+}
+
+/**
+ * Select the most active candidates that resonate from a queue with many equal activities, and
+ * compare them to a full sort of the candidates.
+ */
+bool checkSelectTop() {
+	const int n = 1000;
+	const float vigilance = 0.5;
+	ActivationQueue queue;
+	std::vector<PROTOTYPE_Activation> sorted;
+	for (int i = 0; i < n; ++i) {
+		// few different values of T, so the order of equal ones (on id) matters
+		float T = (float)(lrand48() % 50), resonance = (float)drand48();
+		queue.push(i, T, resonance);
+		if(resonance >= vigilance) {
+			PROTOTYPE_Activation candidate = { i, T, resonance };
+			sorted.push_back(candidate);
+		}
+	}
+	std::sort(sorted.begin(), sorted.end(), MoreActive());
+
+	const int ks[] = { 1, 3, 10, n };
+	bool same = true;
+	std::vector<PROTOTYPE_Activation> top(n);
+	for (int k = 0; k < (int)(sizeof(ks) / sizeof(ks[0])); ++k) {
+		int count = queue.selectTop(vigilance, ks[k], &top[0]);
+		same &= count == std::min(ks[k], (int)sorted.size());
+		for (int i = 0; same && i < count; ++i)
+			same &= top[i].id == sorted[i].id;
+	}
+	return report("selectTop gives the most active candidates in order", same);
+}
+
+/**
+ * A distributed output starts with the winner of the WTA output, and lists different categories
+ * with activations from high to low that sum to one.
+ */
+bool checkDistributedOutput(Art &art, int nrCategories) {
+	ART_ASPECT aspect;
+	ART_TYPE class_id;
+	ArtContext context;
+	ArtResult wta, distributed;
+	bool same = true;
+	for (int t = 0; t < 1000; ++t) {
+		getRandomSample(&aspect, class_id);
+		art.predict(aspect, wta, context);
+		art.setDistributedOutput(nrCategories);
+		art.predict(aspect, distributed, context);
+		art.setDistributedOutput(1);
+		same &= distributed.getWinner() == wta.getWinner() && distributed.getNrCategories() <= nrCategories;
+		ART_TYPE sum = 0;
+		for (int i = 0; i < distributed.getNrCategories(); ++i) {
+			sum += distributed.getActivation(i);
+			if(i > 0)
+				same &= distributed.getActivation(i) <= distributed.getActivation(i - 1) &&
+						distributed.getCategory(i) != distributed.getCategory(i - 1);
+		}
+		same &= wta.empty() || fabs(sum - 1) < 1e-4;
+	}
+	return report("a distributed output starts with the winner", same);
+}
+
+enum ScanMode { SM_PARALLEL, SM_HYPERBOX, SM_BOUNDED, SM_COUNT };
+
+const char* scanModeNames[SM_COUNT] = { "parallel scoring", "a hyperbox index", "upper bounds" };
+
+void setScanMode(Art &art, ScanMode mode, bool use) {
+	switch (mode) {
+	case SM_HYPERBOX:
+		art.setHyperboxIndex(use);
+		break;
+	case SM_BOUNDED:
+		art.setBoundedSearch(use);
+		break;
+	default:
+		art.setParallelScoring(use ? 4 : 1, 1);
+		break;
+	}
+}
+
+/**
+ * Predict the same inputs with a full scan of F2 on one thread and with each other way to search
+ * it, also with a stricter vigilance than the one the network learned with (which is when the
+ * searches skip the most nodes). The outputs have to be the same.
+ */
+bool checkScanModes(Art &art) {
+	const float vigilances[] = { art.getBaseVigilance(), 0.9, 0.95 };
+	const int nrVigilances = sizeof(vigilances) / sizeof(vigilances[0]);
+	const int n = 1000;
+	ART_TYPE class_id;
+	std::vector<ART_ASPECT> inputs(n);
+	for (int t = 0; t < n; ++t)
+		getRandomSample(&inputs[t], class_id);
+
+	ArtContext context;
+	std::vector<ArtResult> expected(n * nrVigilances);
+	for (int v = 0; v < nrVigilances; ++v)
+		for (int t = 0; t < n; ++t)
+			art.predict(inputs[t], expected[v*n + t], context, vigilances[v]);
+
+	bool passed = true;
+	ArtResult result;
+	for (int m = 0; m < SM_COUNT; ++m) {
+		setScanMode(art, (ScanMode)m, true);
+		bool same = true;
+		for (int v = 0; v < nrVigilances; ++v) {
+			for (int t = 0; t < n; ++t) {
+				art.predict(inputs[t], result, context, vigilances[v]);
+				same &= result.getValues() == expected[v*n + t].getValues();
+			}
+		}
+		setScanMode(art, (ScanMode)m, false);
+		passed &= report(string("a search with ") + scanModeNames[m] + " finds the winners of the plain scan", same);
+	}
+	return passed;
+}
+
+/**
+ * Train an Art network and a FixedArt network on the same random inputs, with match tracking on
+ * every other input if "matchTrack", and compare the winners, the prototypes and the winners of a
+ * batch. Art uses the scalar kernels, which sum in the same order as FixedArt.
+ */
+template <int DIM, ART_COMPUTATION_TYPE ACT>
+bool checkFixedArt(bool matchTrack, float vigilance, int n) {
+	Art art(matchTrack, true, true);
+	FixedArt<DIM, ACT> fixed(matchTrack);
+	art.setComputationType(ACT);
+	art.setVigilance(vigilance);
+	fixed.setVigilance(vigilance);
+
+	ART_ASPECT input(DIM);
+	typename FixedArt<DIM, ACT>::Input fixedInput;
+	ArtResult result, fixedResult;
+	bool same = true;
+	for (int t = 0; t < n; ++t) {
+		for (int i = 0; i < DIM; ++i)
+			fixedInput[i] = input[i] = (ART_TYPE)drand48();
+		art.classifyInput(input, result);
+		fixed.classifyInput(fixedInput, fixedResult);
+		if(matchTrack) {
+			if(t % 2) {
+				art.matchTrack(result, true);
+				fixed.matchTrack(fixedResult, true);
+			}
+			art.finishMatchTrack();
+			fixed.finishMatchTrack();
+		}
+		same &= result.getWinner() == fixedResult.getWinner();
+	}
+
+	same &= art.getF2()->size() == fixed.size();
+	for (int x = 0; same && x < fixed.size(); ++x) {
+		same &= art.getPrototypeNorm(x) == fixed.getPrototypeNorm(x);
+		for (int i = 0; i < fixed.SIZE; ++i)
+			same &= art.getF2()->getRowData(x)[i] == fixed.getPrototype(x)[i];
+	}
+
+	const int nrInputs = 1000;
+	std::vector<ART_TYPE> inputs(nrInputs * DIM);
+	for (int i = 0; i < nrInputs * DIM; ++i)
+		inputs[i] = (ART_TYPE)drand48();
+	std::vector<int> winners(nrInputs), fixedWinners(nrInputs);
+	art.classifyBatch(&inputs[0], nrInputs, DIM, &winners[0]);
+	fixed.classifyBatch(&inputs[0], nrInputs, &fixedWinners[0]);
+	return same && winners == fixedWinners;
+}
+
+bool checkFixedArt() {
+	bool scalar = selectArtKernels(KERNEL_SCALAR);
+	bool passed = report("FixedArt trains like Art", scalar && checkFixedArt<4, DEFAULT_ARTMAP>(false, 0.9, 5000));
+	passed &= report("FixedArt match tracks like Art", scalar && checkFixedArt<16, FUZZY_ARTMAP>(true, 0.7, 2000));
+	selectArtKernels(KERNEL_AUTO);
+	return passed;
+}
+
+//! Keeps the last remap of an ART network, see ArtMap::setPruneListener()
+void onPruned(void* context, const Art* art, const std::vector<int> &remap) {
+	*(std::vector<int>*)context = remap;
+}
+
+//! Every connection of the map field is in the lists of both its category and its map node
+bool connectedBothWays(const ArtMap &artmap, int networkNr) {
+	std::vector<int> mapNodes, categories;
+	int nrCategories = artmap.getArtNetwork(networkNr)->getF2()->size();
+	if(artmap.getNrMappedCategories(networkNr) > nrCategories)
+		return false;
+	for (int c = 0; c < nrCategories; ++c) {
+		artmap.getMapNodes(networkNr, c, mapNodes);
+		for (int i = 0; i < (int)mapNodes.size(); ++i) {
+			artmap.getCategories(networkNr, mapNodes[i], categories);
+			if(std::find(categories.begin(), categories.end(), c) == categories.end())
+				return false;
+		}
+	}
+	for (int m = 0; m < artmap.getNrMapNodes(); ++m) {
+		artmap.getCategories(networkNr, m, categories);
+		for (int i = 0; i < (int)categories.size(); ++i) {
+			if(categories[i] < 0 || categories[i] >= nrCategories)
+				return false;
+			artmap.getMapNodes(networkNr, categories[i], mapNodes);
+			if(std::find(mapNodes.begin(), mapNodes.end(), m) == mapNodes.end())
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Train an ARTMAP whose input network has a memory budget, and then prune half of its categories
+ * at once. The connections of the categories that are left have to move along with them: the
+ * map field after pruning is the one before it with the categories renumbered as in the remap.
+ */
+bool checkPruning() {
+	const int budget = 200;
+	Art input(false, true, true), supervisor(false, true, true);
+	configure(input, supervisor);
+	input.setMemoryBudget(budget, 0, 0.25);
+	std::vector<Art*> networks;
+	networks.push_back(&input);
+	networks.push_back(&supervisor);
+	ArtMap artmap(&networks);
+	std::vector<int> remap;
+	artmap.setPruneListener(onPruned, &remap);
+	trainSamples(artmap, 5000);
+	bool passed = report("pruning keeps the network within its budget", !remap.empty() &&
+			input.getF2()->size() <= budget && connectedBothWays(artmap, 0));
+
+	int nrCategories = input.getF2()->size();
+	std::vector<std::vector<int> > mapNodes(nrCategories), categories(artmap.getNrMapNodes());
+	std::vector<std::vector<ART_TYPE> > weights(nrCategories);
+	for (int c = 0; c < nrCategories; ++c) {
+		artmap.getMapNodes(0, c, mapNodes[c]);
+		for (int i = 0; i < (int)mapNodes[c].size(); ++i) {
+			ART_TYPE weight, backWeight;
+			artmap.getConnection(0, c, mapNodes[c][i], weight, backWeight);
+			weights[c].push_back(weight);
+			weights[c].push_back(backWeight);
+		}
+	}
+	for (int m = 0; m < artmap.getNrMapNodes(); ++m)
+		artmap.getCategories(0, m, categories[m]);
+
+	remap.clear();
+	bool same = input.pruneCategories(nrCategories / 2) == nrCategories - nrCategories / 2 &&
+			(int)remap.size() == nrCategories && connectedBothWays(artmap, 0);
+	std::vector<int> list;
+	for (int c = 0; same && c < nrCategories; ++c) {
+		if(remap[c] < 0)
+			continue;
+		artmap.getMapNodes(0, remap[c], list);
+		same &= list == mapNodes[c];
+		for (int i = 0; same && i < (int)list.size(); ++i) {
+			ART_TYPE weight, backWeight;
+			artmap.getConnection(0, remap[c], list[i], weight, backWeight);
+			same &= weight == weights[c][2*i] && backWeight == weights[c][2*i + 1];
+		}
+	}
+	for (int m = 0; same && m < artmap.getNrMapNodes(); ++m) {
+		std::vector<int> expected;
+		for (int i = 0; i < (int)categories[m].size(); ++i)
+			if(remap[categories[m][i]] >= 0)
+				expected.push_back(remap[categories[m][i]]);
+		artmap.getCategories(0, m, list);
+		same &= list == expected;
+	}
+	passed &= report("pruning remaps the map field", same);
+	return passed;
+}
+
+/**
+ * Split F2 of the network over a few processes and compare their output to that of predict(),
+ * with WTA output and with distributed output (for which every shard sends several candidates).
+ */
+bool checkShards(Art &art) {
+	const int nrShards = 3;
+	const int outputs[] = { 1, 5 };
+	ART_ASPECT aspect;
+	ART_TYPE class_id;
+	ArtContext context;
+	ArtResult expected, result;
+	bool passed = true;
+	for (int o = 0; o < (int)(sizeof(outputs) / sizeof(outputs[0])); ++o) {
+		art.setDistributedOutput(outputs[o]);
+		ShardedArt sharded(art, nrShards);
+		bool same = sharded.getNrShards() == nrShards;
+		for (int t = 0; same && t < 1000; ++t) {
+			getRandomSample(&aspect, class_id);
+			same &= art.predict(aspect, expected, context) == sharded.predict(aspect, result) &&
+					result.getValues() == expected.getValues();
+		}
+		passed &= report(outputs[o] == 1 ? "sharded search finds the winner of predict()" :
+				"sharded search gives the distributed output of predict()", same);
+	}
+	art.setDistributedOutput(1);
+	return passed;
+}
+
+/**
+ * The lists of the map field, by category and by map node, hold the same connections, and no
+ * category is connected to a map node twice.
+ */
+bool checkMapFieldLists(const ArtMap &artmap) {
+	bool same = true;
+	std::vector<int> list;
+	for (int n = 0; n < artmap.getNrArtNetworks(); ++n) {
+		same &= connectedBothWays(artmap, n);
+		size_t nrConnections = 0, nrBack = 0;
+		for (int c = 0; c < artmap.getArtNetwork(n)->getF2()->size(); ++c) {
+			artmap.getMapNodes(n, c, list);
+			nrConnections += list.size();
+			std::sort(list.begin(), list.end());
+			same &= std::adjacent_find(list.begin(), list.end()) == list.end();
+		}
+		for (int m = 0; m < artmap.getNrMapNodes(); ++m) {
+			artmap.getCategories(n, m, list);
+			nrBack += list.size();
+		}
+		same &= nrConnections == nrBack && nrConnections > 0;
+	}
+	return report("the map field lists of the categories and the map nodes agree", same);
+}
+
+//! The category with the strongest connection to a map node, the first one if several are
+int strongestCategory(const ArtMap &artmap, int networkNr, int mapNode) {
+	std::vector<int> categories;
+	artmap.getCategories(networkNr, mapNode, categories);
+	int best = -1;
+	ART_TYPE bestWeight = -1;
+	for (int i = 0; i < (int)categories.size(); ++i) {
+		ART_TYPE weight, backWeight;
+		artmap.getConnection(networkNr, categories[i], mapNode, weight, backWeight);
+		if(backWeight > bestWeight) {
+			best = categories[i];
+			bestWeight = backWeight;
+		}
+	}
+	return best;
+}
+
+/**
+ * The class of the supervisor that is predicted for an output of the input network. The map nodes
+ * are activated by the weights of their connections to the categories of the output, times the
+ * activation of those. The winner is the first activated map node, unless later ones are more
+ * active than it: then the last of those (see ArtMap::calcWinningNode()). The supervisor predicts
+ * its category with the strongest connection to the winner.
+ */
+int expectedClass(const ArtMap &artmap, const ArtResult &output) {
+	std::vector<ART_TYPE> activity(artmap.getNrMapNodes(), 0);
+	std::vector<int> mapNodes;
+	for (int i = 0; i < output.getNrCategories(); ++i) {
+		artmap.getMapNodes(0, output.getCategory(i), mapNodes);
+		for (int j = 0; j < (int)mapNodes.size(); ++j) {
+			ART_TYPE weight, backWeight;
+			artmap.getConnection(0, output.getCategory(i), mapNodes[j], weight, backWeight);
+			activity[mapNodes[j]] += output.getActivation(i) * weight;
+		}
+	}
+	int first = 0;
+	while(first < (int)activity.size() && activity[first] <= 0)
+		++first;
+	if(first == (int)activity.size())
+		return -1;
+	int winner = first;
+	for (int m = first + 1; m < (int)activity.size(); ++m)
+		if(activity[m] > activity[first])
+			winner = m;
+	return strongestCategory(artmap, 1, winner);
+}
+
+//! Predict the supervisor class and compare it to expectedClass()
+bool predictsExpectedClass(const ArtMap &artmap, int n) {
+	ART_ASPECT aspect;
+	ART_TYPE class_id;
+	ART_VIEW inputVector;
+	ArtMapContext context;
+	std::vector<ArtResult> results;
+	bool same = true;
+	for (int t = 0; same && t < n; ++t) {
+		getRandomSample(&aspect, class_id);
+		inputVector.clear();
+		inputVector.push_back(&aspect);
+		inputVector.push_back(NULL);
+		artmap.predict(inputVector, results, context);
+		same &= results[1].getWinner() == expectedClass(artmap, results[0]);
+	}
+	return same;
+}
+
+/**
+ * The map field activity of a prediction follows from the connections of the categories in the
+ * output of the input network, with WTA and with distributed output.
+ */
+bool checkMapNodeActivation(ArtMap &artmap) {
+	Art &input = *artmap.getArtNetwork(0);
+	bool passed = report("the map field is activated by the winning category", predictsExpectedClass(artmap, 1000));
+	input.setDistributedOutput(5);
+	passed &= report("the map field is activated by a distributed output", predictsExpectedClass(artmap, 1000));
+	input.setDistributedOutput(1);
+	return passed;
+}
+
+//! getConnection() finds every connection of the lists and reports the other pairs unconnected
+bool findsConnections(const ArtMap &artmap) {
+	std::vector<int> mapNodes;
+	for (int n = 0; n < artmap.getNrArtNetworks(); ++n) {
+		for (int c = 0; c < artmap.getArtNetwork(n)->getF2()->size(); ++c) {
+			artmap.getMapNodes(n, c, mapNodes);
+			std::vector<bool> connected(artmap.getNrMapNodes(), false);
+			for (int i = 0; i < (int)mapNodes.size(); ++i)
+				connected[mapNodes[i]] = true;
+			for (int m = 0; m < artmap.getNrMapNodes(); ++m) {
+				ART_TYPE weight, backWeight;
+				if(artmap.getConnection(n, c, m, weight, backWeight) != connected[m])
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Look up every pair of a category and a map node in the edge index of a trained ARTMAP, then
+ * connect every tenth category to one more map node and look them up again.
+ */
+bool checkEdgeIndex() {
+	Art input(false, true, true), supervisor(false, true, true);
+	configure(input, supervisor);
+	std::vector<Art*> networks;
+	networks.push_back(&input);
+	networks.push_back(&supervisor);
+	ArtMap artmap(&networks);
+	trainSamples(artmap, 3000);
+	bool passed = report("the edge index finds the connections", findsConnections(artmap));
+
+	bool found = true;
+	std::vector<int> mapNodes;
+	for (int c = 0; c < input.getF2()->size(); c += 10) {
+		artmap.getMapNodes(0, c, mapNodes);
+		int m = 0;
+		while(std::find(mapNodes.begin(), mapNodes.end(), m) != mapNodes.end())
+			++m;
+		artmap.setConnection(0, c, m, 0.5, 0.25);
+		ART_TYPE weight, backWeight;
+		found &= artmap.getConnection(0, c, m, weight, backWeight) && weight == 0.5 && backWeight == 0.25;
+	}
+	passed &= report("the edge index finds new connections", found && findsConnections(artmap));
+	return passed;
+}
+
+//! Set the weight of the connection back from a map node to a category, keeping the other one
+void setBackWeight(ArtMap &artmap, int networkNr, int category, int mapNode, ART_TYPE backWeight) {
+	ART_TYPE weight, oldBackWeight;
+	artmap.getConnection(networkNr, category, mapNode, weight, oldBackWeight);
+	artmap.setConnection(networkNr, category, mapNode, weight, backWeight);
+}
+
+/**
+ * Make another supervisor category the strongest one of every map node, by connecting it with a
+ * larger weight, and then the previous one again, by lowering that weight. The predictions have
+ * to follow the strongest connections (which are kept up to date as the weights change, instead
+ * of searched for on every prediction).
+ */
+bool checkStrongestConnections() {
+	Art input(false, true, true), supervisor(false, true, true);
+	configure(input, supervisor);
+	std::vector<Art*> networks;
+	networks.push_back(&input);
+	networks.push_back(&supervisor);
+	ArtMap artmap(&networks);
+	trainSamples(artmap, 3000);
+
+	int nrClasses = supervisor.getF2()->size();
+	std::vector<int> strongest(artmap.getNrMapNodes()), other(artmap.getNrMapNodes());
+	bool changed = nrClasses > 1;
+	for (int m = 0; m < artmap.getNrMapNodes(); ++m) {
+		strongest[m] = strongestCategory(artmap, 1, m);
+		if(strongest[m] < 0)
+			continue;
+		ART_TYPE weight, backWeight;
+		artmap.getConnection(1, strongest[m], m, weight, backWeight);
+		other[m] = (strongest[m] + 1) % nrClasses;
+		setBackWeight(artmap, 1, other[m], m, backWeight + 1);
+		changed &= strongestCategory(artmap, 1, m) == other[m];
+	}
+	bool passed = report("the strongest connections follow raised weights", changed &&
+			predictsExpectedClass(artmap, 1000));
+
+	for (int m = 0; m < artmap.getNrMapNodes(); ++m) {
+		if(strongest[m] < 0)
+			continue;
+		setBackWeight(artmap, 1, other[m], m, 0);
+		changed &= strongestCategory(artmap, 1, m) == strongest[m];
+	}
+	passed &= report("the strongest connections follow lowered weights", changed &&
+			predictsExpectedClass(artmap, 1000));
+	return passed;
+}
+
+enum ModelFormat { MF_LEGACY, MF_IMAGE, MF_COMPACT, MF_COMPACT_ZLIB, MF_COUNT };
+
+const char* formatNames[MF_COUNT] = { "legacy", "image", "compact", "compact with zlib" };
+
+bool saveNetwork(Art &art, ModelFormat format, const string &fileName) {
+	switch (format) {
+	case MF_LEGACY:
+		art.saveArtNetwork(fileName);
+		return true;
+	case MF_IMAGE:
+		return art.saveArtNetworkImage(fileName);
+	case MF_COMPACT:
+		return art.saveArtNetworkCompact(fileName, CompactModelOptions(0, false));
+	default:
+		// without USE_ZLIB this is not compressed
+		return art.saveArtNetworkCompact(fileName, CompactModelOptions(0, true));
+	}
+}
+
+bool loadNetwork(Art &art, ModelFormat format, const string &fileName) {
+	switch (format) {
+	case MF_LEGACY:
+		art.loadArtNetWork(fileName);
+		return true;
+	case MF_IMAGE:
+		return art.mapArtNetworkImage(fileName);
+	default:
+		return art.loadArtNetworkCompact(fileName);
+	}
+}
+
+bool saveMapField(ArtMap &artmap, ModelFormat format, const string &fileName) {
+	switch (format) {
+	case MF_LEGACY:
+		artmap.saveArtMap(fileName);
+		return true;
+	case MF_IMAGE:
+		return artmap.saveArtMapImage(fileName);
+	case MF_COMPACT:
+		return artmap.saveArtMapCompact(fileName, CompactModelOptions(0, false));
+	default:
+		return artmap.saveArtMapCompact(fileName, CompactModelOptions(0, true));
+	}
+}
+
+bool loadMapField(ArtMap &artmap, ModelFormat format, const string &fileName) {
+	switch (format) {
+	case MF_LEGACY:
+		artmap.loadArtMap(fileName);
+		return true;
+	case MF_IMAGE:
+		return artmap.loadArtMapImage(fileName);
+	default:
+		return artmap.loadArtMapCompact(fileName);
+	}
+}
+
+/**
+ * Save the networks and the map field in every format, load them into new ones, and check that
+ * those are the same and predict the same.
+ */
+bool checkFormats(ArtMap &artmap) {
+	bool passed = true;
+	for (int f = 0; f < MF_COUNT; ++f) {
+		ModelFormat format = (ModelFormat)f;
+		string prefix = string("artmap_test_") + (char)('0' + f);
+		Art &input = *artmap.getArtNetwork(0), &supervisor = *artmap.getArtNetwork(1);
+		bool saved = saveNetwork(input, format, prefix + "_input") &&
+				saveNetwork(supervisor, format, prefix + "_supervisor") &&
+				saveMapField(artmap, format, prefix + "_map");
+
+		Art inputCopy(false, true, true), supervisorCopy(false, true, true);
+		configure(inputCopy, supervisorCopy);
+		std::vector<Art*> networks;
+		networks.push_back(&inputCopy);
+		networks.push_back(&supervisorCopy);
+		ArtMap copy(&networks);
+		bool loaded = saved && loadNetwork(inputCopy, format, prefix + "_input") &&
+				loadNetwork(supervisorCopy, format, prefix + "_supervisor") &&
+				loadMapField(copy, format, prefix + "_map");
+
+		bool norms = format != MF_LEGACY;
+		passed &= report(string("round trip of the ") + formatNames[f] + " format", loaded &&
+				sameNetwork(input, inputCopy, norms) && sameNetwork(supervisor, supervisorCopy, norms) &&
+				sameMapField(artmap, copy) && samePredictions(artmap, copy, 1000));
+		remove((prefix + "_input").c_str());
+		remove((prefix + "_supervisor").c_str());
+		remove((prefix + "_map").c_str());
+	}
+	return passed;
+}
+
+/**
+ * Replay the delta log of a model that is trained further onto an empty replica, then let the
+ * replica catch up after the log was compacted to a checkpoint, and replay the compacted log onto
+ * a second empty replica.
+ */
+bool checkDeltaLog(ArtMap &artmap) {
+	ModelDeltaLog log;
+	log.attach(&artmap);
+	trainSamples(artmap, 2000);
+
+	Art input(false, true, true), supervisor(false, true, true);
+	configure(input, supervisor);
+	std::vector<Art*> networks;
+	networks.push_back(&input);
+	networks.push_back(&supervisor);
+	ArtMap replica(&networks);
+	uint64_t version = 0;
+	std::stringstream all;
+	bool applied = log.writeSince(version, all) && ModelDeltaLog::apply(all, replica, version);
+	bool passed = report("delta log replay onto an empty replica", applied && version == log.getVersion() &&
+			sameNetwork(*artmap.getArtNetwork(0), input, true) && sameNetwork(*artmap.getArtNetwork(1), supervisor, true) &&
+			sameMapField(artmap, replica) && samePredictions(artmap, replica, 1000));
+
+	trainSamples(artmap, 2000);
+	log.compact();
+	trainSamples(artmap, 2000);
+	std::stringstream since;
+	applied = version < log.getBaseVersion() && log.writeSince(version, since) &&
+			ModelDeltaLog::apply(since, replica, version);
+	passed &= report("delta log replay across a checkpoint", applied && version == log.getVersion() &&
+			sameNetwork(*artmap.getArtNetwork(0), input, true) && sameNetwork(*artmap.getArtNetwork(1), supervisor, true) &&
+			sameMapField(artmap, replica) && samePredictions(artmap, replica, 1000));
+
+	Art input2(false, true, true), supervisor2(false, true, true);
+	configure(input2, supervisor2);
+	std::vector<Art*> networks2;
+	networks2.push_back(&input2);
+	networks2.push_back(&supervisor2);
+	ArtMap replica2(&networks2);
+	uint64_t version2 = 0;
+	std::stringstream compacted;
+	applied = log.writeSince(version2, compacted) && ModelDeltaLog::apply(compacted, replica2, version2);
+	passed &= report("compacted delta log replay onto an empty replica", applied && version2 == log.getVersion() &&
+			sameNetwork(*artmap.getArtNetwork(0), input2, true) && sameNetwork(*artmap.getArtNetwork(1), supervisor2, true) &&
+			sameMapField(artmap, replica2) && samePredictions(artmap, replica2, 1000));
+	log.detach();
+	return passed;
+}
+
+/**
+ * Publish snapshots of the ARTMAP while it is trained further. Every snapshot a reader acquires
+ * has to classify like the ARTMAP, also the ones that were synchronized from an older snapshot
+ * instead of copied.
+ */
+bool checkPublisher(ArtMap &artmap) {
+	ArtMapPublisher publisher(&artmap, 4);
+	int reader = publisher.addReader();
+	bool same = reader >= 0;
+	for (int round = 0; same && round < 2 + ArtMapPublisher::SPARE_SNAPSHOTS; ++round) {
+		if(round > 0) {
+			trainSamples(artmap, 1000);
+			publisher.publish();
+		}
+		const ArtMapSnapshot* snapshot = publisher.acquire(reader);
+		same &= snapshot->getVersion() == publisher.getVersion() &&
+				sameNetwork(*artmap.getArtNetwork(0), snapshot->getArtNetwork(0), true) &&
+				sameNetwork(*artmap.getArtNetwork(1), snapshot->getArtNetwork(1), true) &&
+				sameMapField(artmap, snapshot->getArtMap()) && samePredictions(artmap, snapshot->getArtMap(), 500);
+	}
+	publisher.removeReader(reader);
+	return report("a published snapshot classifies like its source", same);
+}
+
 int main(int argc, char *argv[]) {
 	cout << "Test for ARTMAP" << endl;
 	srand48( time(NULL) );
 	Art &input = *new Art(false, true, true);
 	Art &supervisor = *new Art(false, true, true);
-	input.setVigilance(0.80);
-	input.setNetworkReliability(0.8);
-	supervisor.setVigilance(0.99);
-	supervisor.setNetworkReliability(1.0);
+	configure(input, supervisor);
 
 	std::vector<Art*> &networks = *new std::vector<Art*>();
 	networks.push_back(&input);
@@ -141,8 +908,8 @@ int main(int argc, char *argv[]) {
 			output = artmap->classify(inputVector);
 			if(output->size() > 1 && ((*output)[1]) != NULL) {
 				ART_TYPE foundClass = (*((*output)[1]))[0];
-				PROTOTYPE* prot = supervisor.getPrototype(foundClass);
-				ART_TYPE cl_id = (*prot)[0];
+				PrototypeView prot = supervisor.getPrototype(foundClass);
+				ART_TYPE cl_id = prot[0];
 //				cout << "Found class id: " << cl_id << " (with input having # prototypes : ";
 //				cout << input.getF2()->size() << ")" << endl;
 				if(cl_id == class_id)
@@ -163,6 +930,19 @@ int main(int argc, char *argv[]) {
 	}
 	cout << "Number of prototypes necessary: " << input.getF2()->size() << "" << endl;
 	cout << "Classified [correct/incorrect]: [" << correct_classified << "/" << mis_classified << "]" << endl;
+	bool passed = checkScanModes(input);
+	passed &= checkSelectTop();
+	passed &= checkDistributedOutput(input, 5);
+	passed &= checkShards(input);
+	passed &= checkFixedArt();
+	passed &= checkMapFieldLists(*artmap);
+	passed &= checkMapNodeActivation(*artmap);
+	passed &= checkEdgeIndex();
+	passed &= checkStrongestConnections();
+	passed &= checkPruning();
+	passed &= checkFormats(*artmap);
+	passed &= checkDeltaLog(*artmap);
+	passed &= checkPublisher(*artmap);
 	delete artmap;
 
 #if (RUNONPC==true)
@@ -186,7 +966,7 @@ int main(int argc, char *argv[]) {
 	delete [] data;
 #endif
 
-	return EXIT_SUCCESS;
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 
@@ -0,0 +1,140 @@
+/*
+ * activationQueue.cpp
+ *
+ * Lazily ordered queue of F2 node activations
+ */
+
+#include "activationQueue.h"
+
+#include <algorithm>
+
+namespace almendeSensorFusion
+{
+
+ActivationQueue::ActivationQueue(): d_items(0),
+		d_best(-1),
+		d_heap(false)
+{
+}
+
+void ActivationQueue::clear()
+{
+	d_items.clear();
+	d_best = -1;
+	d_heap = false;
+}
+
+void ActivationQueue::findBest()
+{
+	ComparePrototype less;
+	int best = 0;
+	for (int i = 1; i < (int)d_items.size(); ++i)
+		if(less(d_items[best], d_items[i]))
+			best = i;
+	d_best = best;
+}
+
+const PROTOTYPE_Activation& ActivationQueue::top()
+{
+	if(d_heap)
+		return d_items.front();
+	if(d_best < 0)
+		findBest();
+	return d_items[d_best];
+}
+
+/**
+ * The first pop removes the winner found by the scan, from then on the remaining candidates are
+ * kept as a heap.
+ */
+void ActivationQueue::pop()
+{
+	if(d_heap)
+	{
+		std::pop_heap(d_items.begin(), d_items.end(), ComparePrototype());
+		d_items.pop_back();
+		return;
+	}
+	if(d_best < 0)
+		findBest();
+	d_items[d_best] = d_items.back();
+	d_items.pop_back();
+	std::make_heap(d_items.begin(), d_items.end(), ComparePrototype());
+	d_best = -1;
+	d_heap = true;
+}
+
+void ActivationQueue::keepBelow(const PROTOTYPE_Activation &last)
+{
+	ComparePrototype less;
+	int kept = 0;
+	for (int i = 0; i < (int)d_items.size(); ++i)
+		if(less(d_items[i], last))
+			d_items[kept++] = d_items[i];
+	d_items.resize(kept);
+	d_best = -1;
+	d_heap = false;
+}
+
+/**
+ * "out" is a heap of the best candidates so far with the least active one in front, so a candidate
+ * only has to beat that one to get in.
+ */
+int ActivationQueue::selectTop(float vigilance, int k, PROTOTYPE_Activation* out) const
+{
+	MoreActive more;
+	int count = 0;
+	for (int i = 0; i < (int)d_items.size(); ++i)
+	{
+		if(d_items[i].resonance < vigilance)
+			continue;
+		if(count < k)
+		{
+			out[count++] = d_items[i];
+			std::push_heap(out, out + count, more);
+		}
+		else if(count > 0 && more(d_items[i], out[0]))
+		{
+			std::pop_heap(out, out + count, more);
+			out[count - 1] = d_items[i];
+			std::push_heap(out, out + count, more);
+		}
+	}
+	std::sort_heap(out, out + count, more);
+	return count;
+}
+
+/**
+ * The winner is the most active candidate that resonates. Everything more active than the winner
+ * would have been popped, the rest stays (unordered) for further match tracking.
+ */
+bool ActivationQueue::popUntilResonance(float vigilance)
+{
+	ComparePrototype less;
+	int best = -1;
+	for (int i = 0; i < (int)d_items.size(); ++i)
+		if(d_items[i].resonance >= vigilance && (best < 0 || less(d_items[best], d_items[i])))
+			best = i;
+
+	if(best < 0)
+	{
+		clear();
+		return false;
+	}
+
+	PROTOTYPE_Activation winner = d_items[best];
+	int kept = 0;
+	for (int i = 0; i < (int)d_items.size(); ++i)
+	{
+		if(less(winner, d_items[i]))
+			continue;
+		if(d_items[i].id == winner.id)
+			d_best = kept;
+		d_items[kept++] = d_items[i];
+	}
+	d_items.resize(kept);
+	d_heap = false;
+	return true;
+}
+
+}
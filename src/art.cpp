@@ -9,6 +9,12 @@
  */
 
 #include "art.h"
+#include "artKernels.h"
+#include "workerPool.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -22,13 +28,16 @@ namespace almendeSensorFusion
  * If complement coding is used, then the input values need to be pre-scaled to [0,1]
  * TODO: fix for without complement coding
  */
-Art::Art(bool matchTrack, bool useInputComplement, bool useWTA ): d_F1(0),
-		d_F2(0),
+Art::Art(bool matchTrack, bool useInputComplement, bool useWTA ): d_context(),
+		d_inputOffset(0),
+		d_inputScale(0),
+		d_F2(),
 		d_vigilanceHist(0)
 {
 	d_matchTrack 			= matchTrack;			// Match-tracking for the use in an ARTMAP
 	d_useInputComplement 	= useInputComplement;	// Complement input coding or single input vector
-	d_useWTA				= true;					// Distributed / Winner Take All output class
+	d_useWTA				= useWTA;				// Distributed / Winner Take All output class
+	d_nrOutputCategories	= DEFAULT_OUTPUT_CATEGORIES;
 	d_vigilance  			= 0.65;					// Baseline vigilance for the default ARTMAP = 0
 	d_ACT 					= DEFAULT_ARTMAP;		// Type of signal computation
 	d_alpha					= 0.01;					// Signal rule parameter
@@ -42,6 +51,19 @@ Art::Art(bool matchTrack, bool useInputComplement, bool useWTA ): d_F1(0),
 	d_vigilanceHistorySize	= 0;					// The vigilance can be based on experience in supervised learning
 	d_currVHist				= 0;					// value used for overwriting the correct history item
 	d_compressionCount		= 0;
+	d_nrScoringThreads		= 1;					// Score F2 on the calling thread only
+	d_minParallelCategories	= DEFAULT_MIN_PARALLEL_CATEGORIES;
+	d_useHyperboxIndex		= false;				// Score all prototypes for every input
+	d_useBoundedSearch		= false;				// Score all prototypes for every input
+	d_maxCategories			= 0;					// No memory budget
+	d_maxBytes				= 0;
+	d_pruneFraction			= 0.1;
+	d_usageHalfLife			= 0;					// The category budget
+	d_inputCount			= 0;
+	d_pruneListener			= NULL;
+	d_pruneContext			= NULL;
+	d_changeListener		= NULL;
+	d_changeContext			= NULL;
 }
 
 /**
@@ -53,34 +75,79 @@ Art::Art(bool matchTrack, bool useInputComplement, bool useWTA ): d_F1(0),
  */
 ART_DISTRIBUTED_CLASS* Art::classifyInput(ART_ASPECT &input)
 {
-	createF1(input);
-	d_inputSize = input.size();
-	signalToProtoType();
-	ART_DISTRIBUTED_CLASS* output = NULL;
-	output = matchTrack();
+	ArtResult result;
+	if(!classifyInput(input, result))
+		return NULL;
+	return result.release();
+}
+
+bool Art::classifyInput(ART_ASPECT &input, ArtResult &result)
+{
+	// Categories are only removed between inputs, when no index is in use
+	int budget = getCategoryBudget();
+	if(budget >= 0 && d_F2.size() > budget)
+		pruneCategories(min(budget, (int)(budget * (1 - d_pruneFraction))));
+	++d_inputCount;
+
+	createF1(input.empty() ? NULL : &input[0], input.size(), d_context);
+	signalToProtoType(d_context, getBaseVigilance());
+	bool found = matchTrack(result);
 	if(!d_matchTrack)
-		matchTrack(true);
-	return output;
+		updateWeights();
+	return found;
 }
 
 /**
  * Basically just copies the input vector to F1. However, in the case of complement
- * encoding, F1 is made twice as large in this way:
+ * encoding, F1 is twice as large in this way:
  *  input: 0.9 0.2 0.3 0.4
  *  F1: 0.9 0.2 0.3 0.4 0.1 0.2 0.7 0.6
  * This means that the individual input value will not influence the overall weight
  * and is a manner of normalizing the input. See ART papers for more details.
+ *
+ * Only the first half is stored in F1, the kernels take the complement of it on the fly (see
+ * scoreCategory()). If an input range is set the values are scaled to [0, 1] in the same pass.
  */
-void Art::createF1(std::vector<ART_TYPE> &input)
+void Art::createF1(const ART_TYPE* input, int size, ArtContext &context) const
+{
+	context.d_F1.resize(size);
+	if(size > 0)
+		createF1(input, size, &context.d_F1[0]);
+	context.d_inputSize = size;
+}
+
+void Art::createF1(const ART_TYPE* input, int size, ART_TYPE* F1) const
 {
-	d_F1.clear();
+	int nrScaled = min(size, (int)d_inputScale.size());
+	for (int x = 0; x < nrScaled; ++x)
+	{
+		ART_TYPE value = (input[x] - d_inputOffset[x]) * d_inputScale[x];
+		F1[x] = value < 0 ? 0 : (value > 1 ? 1 : value);
+	}
+	for (int x = nrScaled; x < size; ++x)
+		F1[x] = input[x];
+}
 
-	for (int x = 0; x < input.size(); ++x)
-		d_F1.push_back(input[x]);
+void Art::setInputRange(const ART_TYPE* minimum, const ART_TYPE* maximum, int nrFeatures)
+{
+	d_inputOffset.clear();
+	d_inputScale.clear();
+	if(minimum == NULL || maximum == NULL)
+		return;
+	for (int x = 0; x < nrFeatures; ++x)
+	{
+		ART_TYPE range = maximum[x] - minimum[x];
+		d_inputOffset.push_back(minimum[x]);
+		d_inputScale.push_back(range > 0 ? 1 / range : 0);
+	}
+}
 
-	if(d_useInputComplement)
-		for (int x = 0; x < input.size(); ++x)
-			d_F1.push_back(1-input[x]);
+//! acc + sum |1 - x_i|, for the parts of the complement that are not compared against weights
+static ART_TYPE complementSum(const ART_TYPE* x, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(1 - x[i]);
+	return acc;
 }
 
 /* The Signals to the prototype (or committed coding node)
@@ -101,99 +168,668 @@ void Art::createF1(std::vector<ART_TYPE> &input)
  * With F2 of size 2 the vigilance can be set higher then for larger F2
  * this has to be taken into consideration when calculating the resonance
  */
-void Art::signalToProtoType()
+void Art::signalToProtoType(ArtContext &context, float vigilance) const
 {
-	// Clear previous activations
-	while (!d_curPTAct.empty())
+	if(useHyperboxIndex(context, vigilance))
+	{
+		// Only the nodes that can resonate are scored, the rest is never a winner unless match
+		// tracking lowers the vigilance below this one (see matchTrack())
+		const ArtKernels &kernels = getArtKernels();
+		const ART_TYPE* F1 = &context.d_F1[0];
+		int nrFeatures = context.d_F1.size();
+
+		context.d_indexHits.clear();
+		d_index.query(d_F2, F1, context.d_inputSize * (1 - vigilance), context.d_indexHits);
+
+		context.d_curPTAct.resize(context.d_indexHits.size());
+		PROTOTYPE_Activation* candidates = context.d_curPTAct.data();
+		int count = 0;
+		for (int i = 0; i < (int)context.d_indexHits.size(); ++i)
+			if(scoreCategory(kernels, F1, nrFeatures, context.d_indexHits[i], context.d_inputSize, candidates[count]))
+				++count;
+		context.d_curPTAct.resize(count);
+		context.d_queueVigilance = vigilance;
+		context.d_queueBounded = false;
+		return;
+	}
+	if(useBoundedSearch(context))
 	{
-		delete d_curPTAct.top();
-		d_curPTAct.pop();
+		boundedSearch(context, vigilance, NULL);
+		return;
 	}
+	scoreAllCategories(context);
+}
 
-	// iterate over all high-level nodes in F2
-	for (int x = 0; x < d_F2.size(); ++x)
+bool Art::useBoundedSearch(const ArtContext &context) const
+{
+	// The bound holds if F1 and the prototypes line up, see boundedSearch()
+	return d_useBoundedSearch && d_useWTA && d_useInputComplement && d_F2.size() > 0 &&
+			d_F2.getMinRowSize() == getF1Size(context) && d_F2.getMaxRowSize() == getF1Size(context);
+}
+
+/**
+ * The fuzzy intersection can never be larger than the smallest of the two: |A n Wj| <= min(|A|, |Wj|).
+ * Filled in into the choice functions this gives an upper bound for Tj and for the resonance of
+ * every node, from the cached |Wj| only. Nodes of which the resonance bound stays below the
+ * vigilance are not scored at all. The nodes with the highest Tj bounds are scored first, in order,
+ * until the best resonating node is more active than the bound of the next one. Then the other
+ * nodes are scored in order of their index, skipping those with a bound below the best node so far
+ * (sorting all of them costs more than scoring them). A small margin covers the rounding, so that
+ * the winner is always the one of the full scan.
+ *
+ * Only the scored nodes end up in the queue. That is enough to find the winner, but not for match
+ * tracking: every raise of the vigilance searches again, for the best node below the last one.
+ */
+void Art::boundedSearch(ArtContext &context, float vigilance, const PROTOTYPE_Activation* below) const
+{
+	static const ART_TYPE BOUND_MARGIN = 1e-4;
+	static const int BOUND_ORDERED_NODES = 8;
+
+	const ArtKernels &kernels = getArtKernels();
+	const ART_TYPE* F1 = &context.d_F1[0];
+	int nrFeatures = context.d_F1.size();
+	int nrCategories = d_F2.size();
+	const ART_TYPE* norms = d_F2.getNorms();
+	ART_TYPE sumA = complementSum(F1, nrFeatures, kernels.absSum(F1, nrFeatures, 0));
+	ComparePrototype less;
+
+	// the nodes that can resonate with the bound of their Tj (as T), and the positions of the ones
+	// with the highest bounds (highest first). Appending is branch free, the nodes that cannot
+	// resonate are overwritten by the next one.
+	context.d_bounds.resize(nrCategories + 1);
+	PROTOTYPE_Activation* bounds = &context.d_bounds[0];
+	int nrBounds = 0;
+	int top[BOUND_ORDERED_NODES];
+	int nrTop = 0;
+	ART_TYPE minTop = -HUGE_VAL;
+	for (int x = 0; x < nrCategories; ++x)
 	{
-		// monkey out of the sleeve: a node d_F2[i] IS its weight vector
-		std::vector<ART_TYPE>* Wj = d_F2[x];
-		ART_TYPE Tj 	= 0;
-		ART_TYPE diff	= 0;
-		ART_TYPE sumWj 	= 0;
+		ART_TYPE overlap = min(sumA, norms[x]);
+		ART_TYPE bound;
+		if(d_ACT == FUZZY_ARTMAP)
+			bound = overlap / (d_alpha + norms[x]);
+		else
+			bound = overlap + (1 - d_alpha) * (context.d_inputSize - norms[x]);
+		// never resonates, or no candidate (see scoreCategory())
+		bool skip = overlap/context.d_inputSize < vigilance - BOUND_MARGIN ||
+				(d_ACT == DEFAULT_ARTMAP && bound + BOUND_MARGIN * (fabs(bound) + 1) <= d_alpha*context.d_inputSize);
+		bounds[nrBounds].id	= x;
+		bounds[nrBounds].T	= bound;
+		if(bound > minTop && !skip)
+		{
+			int t = nrTop < BOUND_ORDERED_NODES ? nrTop++ : nrTop - 1;
+			for (; t > 0 && bounds[top[t - 1]].T < bound; --t)
+				top[t] = top[t - 1];
+			top[t] = nrBounds;
+			if(nrTop == BOUND_ORDERED_NODES)
+				minTop = bounds[top[nrTop - 1]].T;
+		}
+		nrBounds += !skip;
+	}
 
-		// Align for different size with complement coding
-		if(d_useInputComplement)
+	// the scored nodes are written straight into the queue, like in scoreCategories()
+	context.d_curPTAct.resize(nrBounds);
+	PROTOTYPE_Activation* candidates = context.d_curPTAct.data();
+	int count = 0;
+	PROTOTYPE_Activation best;
+	best.id			= -1;
+	best.T			= 0;
+	best.resonance	= 0;
+	for (int i = 0; i < nrTop + nrBounds; ++i)
+	{
+		PROTOTYPE_Activation &next = bounds[i < nrTop ? top[i] : i - nrTop];
+		if(next.id < 0)
+			continue;
+		if(best.id >= 0 && best.T > next.T + BOUND_MARGIN * (fabs(next.T) + 1))
 		{
-			if(Wj->size() <= d_F1.size())
-			{
-				int sizeDiff = (d_F1.size() - Wj->size())/2;
-				for (int i = 0; i < d_F1.size()-sizeDiff; ++i)
-				{
-					int indexF1 = i;
-					if(i >= Wj->size()/2)
-						indexF1 = (d_F1.size()/2) + (i-(Wj->size()/2));
-
-					if(i < Wj->size())
-						diff 	+= fabs(min(d_F1[indexF1],(*Wj)[i]));
-					// Last half of complement is for the shortest always the highest
-					else
-						diff 	+= fabs(d_F1[indexF1]);
-				}
-			}
-			else
+			// in order of the bounds none of the rest can beat it either
+			if(i < nrTop)
+				break;
+			continue;
+		}
+		int x = next.id;
+		next.id = -1;
+
+		PROTOTYPE_Activation &pa = candidates[count];
+		float inputSize = context.d_inputSize;
+		if(!scoreCategory(kernels, F1, nrFeatures, x, inputSize, pa))
+			continue;
+		// passed over by match tracking already
+		if(below != NULL && !less(pa, *below))
+			continue;
+		if(pa.resonance >= vigilance && (best.id < 0 || less(best, pa)))
+			best = pa;
+		++count;
+	}
+	context.d_curPTAct.resize(count);
+	context.d_queueVigilance = -1;
+	context.d_queueBounded = true;
+}
+
+bool Art::useHyperboxIndex(const ArtContext &context, float vigilance) const
+{
+	return d_useHyperboxIndex && d_useInputComplement && vigilance > 0 && d_index.isValid() &&
+			d_index.size() == d_F2.size() && d_F2.size() > 0 && d_index.getNrFeatures() == (int)context.d_F1.size();
+}
+
+void Art::scoreAllCategories(ArtContext &context) const
+{
+	// All nodes are scored, so every vigilance can be tracked
+	context.d_queueVigilance = -1;
+	context.d_queueBounded = false;
+	int nrCategories = d_F2.size();
+
+	// Every node can become a candidate, they are written straight into the queue
+	context.d_curPTAct.resize(nrCategories);
+	PROTOTYPE_Activation* candidates = context.d_curPTAct.data();
+	alignBuckets(context.d_F1.size(), context.d_alignments);
+
+	// A prototype longer than F1 raises the input size for all nodes after it. Every task works that
+	// out from the buckets (see scoreBucket()), so those networks can be split as well. When the
+	// pool is busy with another context (concurrent predict()), this one does not wait for it but
+	// scores on its own thread.
+	bool parallel = d_nrScoringThreads > 1 && nrCategories >= d_minParallelCategories && nrCategories > 0;
+	ScoringJob job;
+	if(parallel)
+	{
+		job.art			= this;
+		job.context		= &context;
+		job.candidates	= candidates;
+		job.nrTasks		= d_nrScoringThreads;
+		job.counts.resize(job.nrTasks);
+		job.best.resize(job.nrTasks);
+		parallel = WorkerPool::getShared(d_nrScoringThreads - 1)->tryRun(&Art::scoreTask, &job, job.nrTasks);
+	}
+	if(parallel)
+	{
+		// Every task wrote its candidates at the start of its own range, move them together
+		// (in order of the nodes) and keep the best of the best
+		ComparePrototype less;
+		int count = 0;
+		int best = -1;
+		for (int t = 0; t < job.nrTasks; ++t)
+		{
+			int begin = (int)(((long long)nrCategories * t) / job.nrTasks);
+			if(job.best[t] >= 0 && (best < 0 || less(candidates[best], candidates[begin + job.best[t]])))
+				best = count + job.best[t];
+			if(begin != count)
+				memmove(candidates + count, candidates + begin, job.counts[t] * sizeof(PROTOTYPE_Activation));
+			count += job.counts[t];
+		}
+		context.d_curPTAct.resize(count);
+		context.d_curPTAct.setBest(best);
+		for (int b = 0; b < (int)context.d_alignments.size(); ++b)
+			if(context.d_inputSize < context.d_alignments[b].raise)
+				context.d_inputSize = context.d_alignments[b].raise;
+	}
+	else
+	{
+		int best = -1;
+		context.d_curPTAct.resize(scoreCategories(context, 0, nrCategories, context.d_inputSize, candidates, best));
+		context.d_curPTAct.setBest(best);
+	}
+}
+
+/**
+ * One task of a parallel scoring job: a contiguous range of the F2 nodes. The input size of every
+ * node follows from the input size of the context and the buckets, so every task can start from it.
+ */
+void Art::scoreTask(void* context, int task)
+{
+	ScoringJob* job = (ScoringJob*) context;
+	const Art* art = job->art;
+	int nrCategories = art->d_F2.size();
+	int begin = (int)(((long long)nrCategories * task) / job->nrTasks);
+	int end = (int)(((long long)nrCategories * (task + 1)) / job->nrTasks);
+
+	float inputSize = job->context->d_inputSize;
+	job->counts[task] = art->scoreCategories(*job->context, begin, end, inputSize, job->candidates + begin, job->best[task]);
+}
+
+int Art::scoreCategories(const ArtContext &context, int first, int last, float &inputSize, PROTOTYPE_Activation* out,
+		int &best) const
+{
+	const ArtKernels &kernels = getArtKernels();
+	const ART_TYPE* F1 = context.d_F1.empty() ? NULL : &context.d_F1[0];
+	ComparePrototype less;
+	int count = 0;
+	best = -1;
+
+	// iterate over the high-level nodes in F2, a bucket at a time
+	for (int b = 0; b < d_F2.getNrBuckets(); ++b)
+	{
+		const std::vector<int> &rows = d_F2.getBucket(b).rows;
+		int begin = lower_bound(rows.begin(), rows.end(), first) - rows.begin();
+		int end = lower_bound(rows.begin(), rows.end(), last) - rows.begin();
+		if(begin == end)
+			continue;
+		int bucketBest;
+		int n = scoreBucket(kernels, F1, context.d_alignments, b, &rows[begin], end - begin, inputSize, out + count, bucketBest);
+		if(bucketBest >= 0 && (best < 0 || less(out[best], out[count + bucketBest])))
+			best = count + bucketBest;
+		count += n;
+	}
+
+	// the input size after the last node
+	for (int b = 0; b < (int)context.d_alignments.size(); ++b)
+		if(context.d_alignments[b].first < last && inputSize < context.d_alignments[b].raise)
+			inputSize = context.d_alignments[b].raise;
+	return count;
+}
+
+/**
+ * Align for different size with complement coding. The F1 and Wj are split in the segments that
+ * line up, so every segment is one branch-free kernel call. The second half of F1 is the complement
+ * of the first, which only the kernels compute.
+ */
+CategoryAlignment Art::alignCategory(int size, int nrFeatures) const
+{
+	int F1Size = d_useInputComplement ? 2*nrFeatures : nrFeatures;
+	int halfF1 = nrFeatures;
+	int halfWj = size/2;
+
+	CategoryAlignment a;
+	a.coded				= false;
+	a.direct			= 0;
+	a.complementStart	= halfWj;
+	a.complement		= 0;
+	a.restF1			= 0;
+	a.restWj			= 0;
+	a.raise				= 0;
+	a.first				= 0;
+
+	if(d_useInputComplement)
+	{
+		if(size == F1Size)
+		{
+			a.coded		= true;
+			a.direct	= halfF1;
+		}
+		else if(size < F1Size)
+		{
+			int end = F1Size - (F1Size - size)/2;
+			// first half of Wj against first half of F1, second half against the complement
+			a.direct		= halfWj;
+			a.complement	= size - halfWj;
+			// Last half of complement is for the shortest always the highest
+			a.restF1		= end - size;
+		}
+		else
+		{
+			// The network can have different input sizes
+			int end = size - (size - F1Size)/2;
+			a.direct		= halfF1;
+			a.complement	= F1Size - halfF1;
+			a.restWj		= end - F1Size;
+			a.raise			= end;
+		}
+	}
+	// without complement coding
+	else
+	{
+		// if the network is too large for the inputs, weights will be neglected
+		// if the input is larger than the network, inputs will be disregarded (but counted: diff is smaller)
+		a.direct = min(size, F1Size);
+		// only set/increase d_inputSize, diff becomes smaller!
+		if(size > F1Size)
+			a.raise = size-1;
+	}
+	return a;
+}
+
+void Art::alignBuckets(int nrFeatures, std::vector<CategoryAlignment> &alignments) const
+{
+	alignments.resize(d_F2.getNrBuckets());
+	for (int b = 0; b < d_F2.getNrBuckets(); ++b)
+	{
+		const RowBucket &bucket = d_F2.getBucket(b);
+		alignments[b] = alignCategory(bucket.size, nrFeatures);
+		alignments[b].first = bucket.rows[0];
+	}
+}
+
+int Art::scoreBucket(const ArtKernels &kernels, const ART_TYPE* F1, const std::vector<CategoryAlignment> &alignments,
+		int bucket, const int* rows, int n, float inputSize, PROTOTYPE_Activation* out, int &best) const
+{
+	const CategoryAlignment &alignment = alignments[bucket];
+	int nrBuckets = alignments.size();
+	ComparePrototype less;
+	int count = 0;
+	best = -1;
+
+	// the buckets are in the order of their first node, "raised" is the next one that has not
+	// raised the input size yet
+	int raised = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		int x = rows[i];
+		for (; raised < nrBuckets && alignments[raised].first <= x; ++raised)
+			if(inputSize < alignments[raised].raise)
+				inputSize = alignments[raised].raise;
+
+		ART_TYPE diff = fuzzyIntersection(kernels, F1, d_F2.getRowData(x), alignment);
+		if(!d_useInputComplement)
+			diff = inputSize/(diff+1.0);
+		if(!activation(diff, x, inputSize, out[count]))
+			continue;
+		if(best < 0 || less(out[best], out[count]))
+			best = count;
+		++count;
+	}
+	return count;
+}
+
+ART_TYPE Art::fuzzyIntersection(const ArtKernels &kernels, const ART_TYPE* F1, const ART_TYPE* Wj,
+		const CategoryAlignment &alignment) const
+{
+	if(!d_useInputComplement)
+		return kernels.absDiff(F1, Wj, alignment.direct, 0);
+	if(alignment.coded)
+		return kernels.fuzzyMinCoded(F1, Wj, alignment.direct, 0);
+	// a segment that is not there adds 0
+	ART_TYPE diff = kernels.fuzzyMin(F1, Wj, alignment.direct, 0);
+	diff = kernels.fuzzyMinComplement(F1, Wj + alignment.complementStart, alignment.complement, diff);
+	diff = complementSum(F1 + alignment.complement, alignment.restF1, diff);
+	return kernels.absSum(Wj + alignment.complementStart + alignment.complement, alignment.restWj, diff);
+}
+
+bool Art::activation(ART_TYPE diff, int x, float inputSize, PROTOTYPE_Activation &pa) const
+{
+	// |Wj| only changes when the weights are updated, so it is cached in the prototype matrix
+	ART_TYPE sumWj 	= d_F2.getNorm(x);
+	ART_TYPE Tj 	= 0;
+
+	if(d_ACT == DEFAULT_ARTMAP)
+		Tj = diff + (1 - d_alpha) * (inputSize - sumWj);
+
+	if(d_ACT == FUZZY_ARTMAP)
+		Tj = diff / (d_alpha + sumWj);
+
+	if((d_ACT == DEFAULT_ARTMAP && Tj > d_alpha*inputSize) || d_ACT == FUZZY_ARTMAP || !d_useInputComplement)
+	{
+		pa.id			= x;
+		pa.T			= Tj;
+		pa.resonance	= diff/inputSize;
+		return true;
+	}
+	//else
+	//	cout << "Prototype activation Tj lower then " << d_alpha*d_inputSize << endl;
+	return false;
+}
+
+bool Art::scoreCategory(const ArtKernels &kernels, const ART_TYPE* F1, int nrFeatures, int x, float &inputSize,
+		PROTOTYPE_Activation &pa) const
+{
+	// monkey out of the sleeve: a node d_F2[i] IS its weight vector
+	CategoryAlignment alignment = alignCategory(d_F2.getRowSize(x), nrFeatures);
+	if(inputSize < alignment.raise)
+		inputSize = alignment.raise;
+
+	ART_TYPE diff = fuzzyIntersection(kernels, F1, d_F2.getRowData(x), alignment);
+	if(!d_useInputComplement)
+		diff = inputSize/(diff+1.0);
+	return activation(diff, x, inputSize, pa);
+}
+
+/**
+ * The inputs are classified in blocks of BATCH_INPUTS, and the prototypes are visited in blocks of
+ * about BATCH_BYTES (a bucket at a time): every block of prototypes is scored against all inputs of
+ * the block while it is still in the cache. The input size of every node is the one it has when
+ * the nodes are visited in order (see scoreBucket()), so the winner comes out the same as with
+ * classifyInput().
+ */
+void Art::classifyBatch(const ART_TYPE* inputs, int nrInputs, int nrFeatures, int* winners,
+		ART_TYPE* resonances) const
+{
+	static const int BATCH_INPUTS	= 32;
+	static const int BATCH_BYTES	= 128*1024;
+
+	const ArtKernels &kernels = getArtKernels();
+	int categoryBlock = BATCH_BYTES / (sizeof(ART_TYPE) * (d_F2.getStride() > 0 ? d_F2.getStride() : 1));
+	if(categoryBlock < 16)
+		categoryBlock = 16;
+
+	float vigilance = getBaseVigilance();
+	std::vector<CategoryAlignment> alignments;
+	alignBuckets(nrFeatures, alignments);
+
+	std::vector<ART_TYPE> F1((size_t)BATCH_INPUTS * nrFeatures);
+	std::vector<PROTOTYPE_Activation> best(BATCH_INPUTS);
+	std::vector<PROTOTYPE_Activation> scored(categoryBlock);
+	ComparePrototype less;
+
+	for (int i0 = 0; i0 < nrInputs; i0 += BATCH_INPUTS)
+	{
+		int n = min(BATCH_INPUTS, nrInputs - i0);
+
+		// the F1 of every input in the block, see createF1()
+		for (int i = 0; i < n; ++i)
+		{
+			if(nrFeatures > 0)
+				createF1(inputs + (size_t)(i0 + i) * nrFeatures, nrFeatures, &F1[(size_t)i * nrFeatures]);
+			best[i].id = -1;
+		}
+
+		for (int b = 0; b < d_F2.getNrBuckets(); ++b)
+		{
+			const std::vector<int> &rows = d_F2.getBucket(b).rows;
+			for (int c0 = 0; c0 < (int)rows.size(); c0 += categoryBlock)
 			{
-				int sizeDiff = (Wj->size() - d_F1.size())/2;
-				for (int i = 0; i < Wj->size()-sizeDiff; ++i)
+				int c1 = min((int)rows.size(), c0 + categoryBlock);
+				for (int i = 0; i < n; ++i)
 				{
-					// The network can have different input sizes
-					int indexF2 = i;
-					if(i >= d_F1.size()/2)
-						indexF2 = (Wj->size()/2) + (i-(d_F1.size()/2));
-
-					if(i < d_F1.size())
-						diff 	+= fabs(min(d_F1[i],(*Wj)[indexF2]));
-					else
-						diff 	+=  fabs((*Wj)[indexF2]);
-
-					if(d_inputSize <= i)
-						d_inputSize = i+1;
+					const ART_TYPE* f1 = F1.empty() ? NULL : &F1[(size_t)i * nrFeatures];
+					int bucketBest;
+					int nrScored = scoreBucket(kernels, f1, alignments, b, &rows[c0], c1 - c0, nrFeatures, &scored[0], bucketBest);
+					for (int c = 0; c < nrScored; ++c)
+						if(scored[c].resonance >= vigilance && (best[i].id < 0 || less(best[i], scored[c])))
+							best[i] = scored[c];
 				}
 			}
 		}
-		// without complement coding
-		else
+
+		for (int i = 0; i < n; ++i)
 		{
-			// if the network is too large for the inputs, weights will be neglected
-			// if the input is larger than the network, inputs will be disregarded (but counted: diff is smaller)
-			for (int i = 0; i < Wj->size(); ++i)
-			{
-				// The network can have different input sizes
-				if(i < d_F1.size())
-					diff 	+= fabs((d_F1[i]-(*Wj)[i]));
-				else if(i > d_inputSize)
-					d_inputSize = i; // only set/increase d_inputSize, diff becomes smaller!
-			}
-			diff = d_inputSize/(diff+1.0);
+			winners[i0 + i] = best[i].id;
+			if(resonances != NULL)
+				resonances[i0 + i] = best[i].id < 0 ? 0 : best[i].resonance;
 		}
+	}
+}
 
-		for (int i = 0; i < Wj->size(); ++i)
-			sumWj 	+= fabs((*Wj)[i]);
+void Art::syncFrom(const Art &source)
+{
+	if(this == &source)
+		return;
+	d_vigilance				= source.d_vigilance;
+	d_alpha					= source.d_alpha;
+	d_trackingValue			= source.d_trackingValue;
+	d_learningFraction		= source.d_learningFraction;
+	d_networkReliability	= source.d_networkReliability;
+	d_vigilanceHistorySize	= source.d_vigilanceHistorySize;
+	d_currVHist				= source.d_currVHist;
+	d_compressionCount		= source.d_compressionCount;
+	d_nrScoringThreads		= source.d_nrScoringThreads;
+	d_minParallelCategories	= source.d_minParallelCategories;
+	d_useBoundedSearch		= source.d_useBoundedSearch;
+	d_maxCategories			= source.d_maxCategories;
+	d_maxBytes				= source.d_maxBytes;
+	d_pruneFraction			= source.d_pruneFraction;
+	d_usageHalfLife			= source.d_usageHalfLife;
+	d_inputCount			= source.d_inputCount;
+	d_inputOffset			= source.d_inputOffset;
+	d_inputScale			= source.d_inputScale;
+	d_vigilanceHist			= source.d_vigilanceHist;
+	d_matchTrack			= source.d_matchTrack;
+	d_useInputComplement	= source.d_useInputComplement;
+	d_useWTA				= source.d_useWTA;
+	d_testMatch				= source.d_testMatch;
+	d_ACT					= source.d_ACT;
+	d_nrOutputCategories	= source.d_nrOutputCategories;
+	d_F2.syncFrom(source.d_F2);
 
-		if(d_ACT == DEFAULT_ARTMAP)
-			Tj = diff + (1 - d_alpha) * (d_inputSize - sumWj);
+	d_useHyperboxIndex		= false;
+	d_index.clear();
+	d_context.d_curPTAct.clear();
+}
 
-		if(d_ACT == FUZZY_ARTMAP)
-			Tj = diff / (d_alpha + sumWj);
+void Art::setHyperboxIndex(bool use)
+{
+	d_useHyperboxIndex = use;
+	d_index.clear();
+	if(use)
+		d_index.build(d_F2);
+}
 
-		if((d_ACT == DEFAULT_ARTMAP && Tj > d_alpha*d_inputSize) || d_ACT == FUZZY_ARTMAP || !d_useInputComplement)
-		{
-			PROTOTYPE_Activation *pr = new PROTOTYPE_Activation;
-			pr->id = x;
-			pr->T = Tj;
-			pr->resonance = diff/d_inputSize;
-			d_curPTAct.push(pr);
-		}
-		//else
-		//	cout << "Prototype activation Tj lower then " << d_alpha*d_inputSize << endl;
+void Art::setBoundedSearch(bool use)
+{
+	d_useBoundedSearch = use;
+}
+
+void Art::setParallelScoring(int nrThreads, int minCategories)
+{
+	d_nrScoringThreads		= nrThreads > 1 ? nrThreads : 1;
+	d_minParallelCategories	= minCategories;
+}
+
+void Art::setMemoryBudget(int maxCategories, size_t maxBytes, float pruneFraction)
+{
+	d_maxCategories	= maxCategories > 0 ? maxCategories : 0;
+	d_maxBytes		= maxBytes;
+	d_pruneFraction	= pruneFraction;
+	if(d_maxCategories > 0 && d_maxBytes == 0)
+		d_F2.reserve(d_maxCategories + 1);
+}
+
+int Art::getCategoryBudget() const
+{
+	if(d_maxCategories <= 0 && d_maxBytes == 0)
+		return -1;
+	int budget = d_maxCategories;
+	if(d_maxBytes > 0)
+	{
+		int fit = (int)(d_maxBytes / d_F2.getRowBytes());
+		if(budget <= 0 || fit < budget)
+			budget = fit;
+	}
+	return budget;
+}
+
+float Art::getUsage(int category) const
+{
+	float halfLife = d_usageHalfLife;
+	if(halfLife <= 0)
+	{
+		int budget = getCategoryBudget();
+		halfLife = budget > 0 ? budget : d_F2.size();
 	}
+	float age = d_inputCount - d_F2.getLastWin(category);
+	return d_F2.getWins(category) * pow(2.0f, -age / (halfLife > 0 ? halfLife : 1));
+}
+
+//! The order in which categories are removed, see pruneCategories()
+struct LessUsed {
+	LessUsed(const PrototypeMatrix &F2, const std::vector<float> &usage): F2(F2), usage(usage) {}
+	inline bool operator() (int a, int b) const
+	{
+		if(usage[a] != usage[b])
+			return usage[a] < usage[b];
+		if(F2.getLastWin(a) != F2.getLastWin(b))
+			return F2.getLastWin(a) < F2.getLastWin(b);
+		return a < b;
+	}
+	const PrototypeMatrix &F2;
+	const std::vector<float> &usage;
+};
+
+/**
+ * The categories are ordered by their usage, on equal usage the one that won longest ago and then
+ * the oldest category is removed first. Only the split between the ones to keep and the ones to
+ * remove matters, so a partial sort is enough.
+ */
+int Art::pruneCategories(int nrCategories)
+{
+	int nrRemove = d_F2.size() - (nrCategories > 0 ? nrCategories : 0);
+	if(nrRemove <= 0)
+		return 0;
+
+	std::vector<float> usage(d_F2.size());
+	std::vector<int> order(d_F2.size());
+	for (int x = 0; x < d_F2.size(); ++x)
+	{
+		usage[x] = getUsage(x);
+		order[x] = x;
+	}
+	std::nth_element(order.begin(), order.begin() + nrRemove - 1, order.end(), LessUsed(d_F2, usage));
+
+	std::vector<bool> remove(d_F2.size(), false);
+	for (int x = 0; x < nrRemove; ++x)
+		remove[order[x]] = true;
+	return removeCategories(remove);
+}
+
+int Art::removeCategories(const std::vector<bool> &remove)
+{
+	std::vector<int> remap;
+	int nrCategories = d_F2.size();
+	d_F2.removeRows(remove, remap);
+	if(d_F2.size() == nrCategories)
+		return 0;
+
+	d_context.d_curPTAct.clear();
+	if(d_useHyperboxIndex)
+	{
+		d_index.clear();
+		d_index.build(d_F2);
+	}
+	if(d_pruneListener != NULL)
+		d_pruneListener(d_pruneContext, this, remap);
+	return nrCategories - d_F2.size();
+}
+
+void Art::clearCategories()
+{
+	removeCategories(std::vector<bool>(d_F2.size(), true));
+}
+
+void Art::setChangeListener(ART_CHANGE_LISTENER listener, void* context)
+{
+	d_changeListener	= listener;
+	d_changeContext		= context;
+}
+
+bool Art::setPrototype(int category, const ART_TYPE* weights, int size, ART_TYPE norm)
+{
+	if(category == d_F2.size())
+	{
+		d_F2.recordWin(d_F2.appendRow(weights, size), d_inputCount);
+		if(norm >= 0)
+			d_F2.setNorm(category, norm);
+		if(d_useHyperboxIndex)
+			d_index.insert(d_F2, category);
+	}
+	else if(category >= 0 && category < d_F2.size() && size == d_F2.getRowSize(category))
+	{
+		ART_TYPE* row = d_F2.getRowData(category);
+		if(size > 0)
+			memcpy(row, weights, size * sizeof(ART_TYPE));
+		d_F2.setNorm(category, norm >= 0 ? norm : getArtKernels().absSum(row, size, 0));
+		if(d_useHyperboxIndex)
+			d_index.update(d_F2, category);
+	}
+	else
+		return false;
+	// the candidates of the last input might not be what they were anymore
+	d_context.d_curPTAct.clear();
+	if(d_changeListener != NULL)
+		d_changeListener(d_changeContext, this, category);
+	return true;
+}
+
+void Art::setPruneListener(ART_PRUNE_LISTENER listener, void* context)
+{
+	d_pruneListener	= listener;
+	d_pruneContext	= context;
 }
 
 void Art::setVigilanceHistorySize(int vigilanceHistorySize)
@@ -215,7 +851,7 @@ void Art::addToVigilanceHistory(ART_TYPE vig)
 		d_currVHist = 0;
 }
 
-ART_TYPE Art::getAVGVigilance()
+ART_TYPE Art::getAVGVigilance() const
 {
 	ART_TYPE avg = 0;
 	for (int x = 0; x < d_vigilanceHist.size(); ++x)
@@ -231,56 +867,66 @@ ART_TYPE Art::getAVGVigilance()
  * Does the actual updating.
  */
 void Art::updateWeights() {
-	if(d_curPTAct.empty()) return;
+	if(d_context.d_curPTAct.empty()) return;
 
 	// Last node is send as winning node, update
 	if(!d_testMatch)
 	{
-		PROTOTYPE_Activation *protA = d_curPTAct.top();
-		PROTOTYPE *prot 			= (d_F2[protA->id]);
+		const PROTOTYPE_Activation *protA = &d_context.d_curPTAct.top();
+		ART_TYPE *prot 				= d_F2.getRowData(protA->id);
+		int protSize				= d_F2.getRowSize(protA->id);
+
+		const ArtKernels &kernels = getArtKernels();
+		const ART_TYPE* F1 = d_context.d_F1.empty() ? NULL : &d_context.d_F1[0];
+		int F1Size = getF1Size(d_context);
+		int halfF1 = d_context.d_F1.size();
+		int halfProt = protSize/2;
 
 		// align prototype to input, do not change prototype size
+		// the norm of the prototype is summed in the same pass, in the order of the weights
+		ART_TYPE norm = 0;
 		if(d_useInputComplement)
-			if(prot->size() > d_F1.size())
+			if(protSize > F1Size)
 			{
-				for (int x = 0; x < prot->size(); ++x)
+				// the inputs the prototype has, weights for inputs that are missing decay
+				norm = kernels.learn(prot, F1, halfF1, d_learningFraction, norm);
+				for (int x = halfF1; x < halfProt; ++x)
+				{
+					prot[x] = d_learningFraction*( 0 )+(1 - d_learningFraction)*prot[x];
+					norm += fabs(prot[x]);
+				}
+				int complementEnd = halfProt + (F1Size - halfF1);
+				norm = kernels.learnComplement(prot + halfProt, F1, F1Size - halfF1, d_learningFraction, norm);
+				for (int x = complementEnd; x < protSize; ++x)
 				{
-					if(x < d_F1.size()/2)
-						(*prot)[x] = d_learningFraction*( min(d_F1[x],(*prot)[x]) )+(1 - d_learningFraction)*(*prot)[x];
-					else if(x >= d_F1.size()/2 &&  x < prot->size()/2)
-						(*prot)[x] = d_learningFraction*( 0 )+(1 - d_learningFraction)*(*prot)[x];
-					else if(x >= prot->size()/2 && ((d_F1.size()/2) + (x-(prot->size()/2))) < d_F1.size())
-					{
-						int indexF1 = (d_F1.size()/2) + (x-(prot->size()/2));
-						(*prot)[x] = d_learningFraction*( min(d_F1[indexF1],(*prot)[x]) )+(1 - d_learningFraction)*(*prot)[x];
-					}
-					else
-					{
-						(*prot)[x] = d_learningFraction*( (*prot)[x] )+(1 - d_learningFraction)*(*prot)[x];
-					}
+					prot[x] = d_learningFraction*( prot[x] )+(1 - d_learningFraction)*prot[x];
+					norm += fabs(prot[x]);
 				}
 			}
+			else if(protSize == F1Size)
+			{
+				norm = kernels.learnCoded(prot, F1, halfF1, d_learningFraction, norm);
+			}
 			else
 			{
-				for (int x = 0; x < prot->size(); ++x)
-				{
-					int indexF1 = x;
-					if(x >= prot->size()/2)
-						indexF1 = (d_F1.size()/2) + (x-(prot->size()/2));
-					(*prot)[x] = d_learningFraction*( min(d_F1[indexF1],(*prot)[x]) )+(1 - d_learningFraction)*(*prot)[x];
-				}
+				norm = kernels.learn(prot, F1, halfProt, d_learningFraction, norm);
+				norm = kernels.learnComplement(prot + halfProt, F1, protSize - halfProt, d_learningFraction, norm);
 			}
 		else
 		{
-			for (int x = 0; x < prot->size(); ++x)
+			norm = kernels.learn(prot, F1, min(protSize, F1Size), d_learningFraction, norm);
+			for (int x = F1Size; x < protSize; ++x)
 			{
-				if(x < d_F1.size())
-					(*prot)[x] = d_learningFraction*( min(d_F1[x],(*prot)[x]) )+(1 - d_learningFraction)*(*prot)[x];
-				else
-					(*prot)[x] = d_learningFraction*( 0 )+(1 - d_learningFraction)*(*prot)[x];
-
+				prot[x] = d_learningFraction*( 0 )+(1 - d_learningFraction)*prot[x];
+				norm += fabs(prot[x]);
 			}
 		}
+		d_F2.setNorm(protA->id, norm);
+		d_F2.recordWin(protA->id, d_inputCount);
+		if(d_useHyperboxIndex)
+			d_index.update(d_F2, protA->id);
+		if(d_changeListener != NULL)
+			d_changeListener(d_changeContext, this, protA->id);
 
 		if(d_vigilanceHistorySize > 0 && d_matchTrack)
 			addToVigilanceHistory(protA->resonance-(d_alpha*10));
@@ -297,11 +943,7 @@ void Art::updateWeights() {
 	// set resonance in history
 
 	// Clear previous activations
-	while (!d_curPTAct.empty())
-	{
-		delete d_curPTAct.top();
-		d_curPTAct.pop();
-	}
+	d_context.d_curPTAct.clear();
 }
 
 /**
@@ -313,80 +955,174 @@ void Art::updateWeights() {
  */
 std::vector<ART_TYPE>* Art::matchTrack(bool finished, bool raiseVigilance)
 {
-	std::vector<ART_TYPE> * output = new std::vector<ART_TYPE>(0);
-
 	// Update weights
 	if (finished) {
 		updateWeights();
 		return NULL;
 	}
 
+	ArtResult result;
+	if(!matchTrack(result, raiseVigilance))
+		return NULL;
+	return result.release();
+}
+
+float Art::getBaseVigilance(bool matchTrack) const
+{
 	float vigilance = d_vigilance;
 	if(d_vigilanceHistorySize > 0)
 		vigilance = getAVGVigilance();
 
-	//cout << "AVigilance: " << getAVGVigilance() << " vig: " <<  vigilance << " candidates: " << d_curPTAct.size() << endl;
+	//cout << "AVigilance: " << getAVGVigilance() << " vig: " <<  vigilance << " candidates: " << d_context.d_curPTAct.size() << endl;
 
-	if(d_matchTrack)
+	if(matchTrack)
 		vigilance = 0;
+	return vigilance;
+}
+
+bool Art::matchTrack(ArtResult &result, bool raiseVigilance)
+{
+	result.clear();
+
+	float vigilance = getBaseVigilance();
 
 	// Find the node that matches the criterion
 	// resonance >= vigilance
-	// Only WTA implemented
-	// TODO: Distributed output
-	if(d_useWTA)
+	// Last prototype was not correct
+	// find new prototype with new vigilance
+	if(raiseVigilance && !d_context.d_curPTAct.empty())
 	{
-		while (!d_curPTAct.empty())
+		vigilance = d_context.d_curPTAct.top().resonance+d_trackingValue;
+		PROTOTYPE_Activation last = d_context.d_curPTAct.top();
+		if(d_context.d_queueBounded)
+			boundedSearch(d_context, vigilance, &last);
+		else if(d_context.d_queueVigilance > 0 && vigilance < d_context.d_queueVigilance)
 		{
-			PROTOTYPE_Activation *prot = d_curPTAct.top();
+			// The index only gave the nodes above the old vigilance: score all of them and
+			// drop the ones that were already popped (the top one and everything above it)
+			scoreAllCategories(d_context);
+			d_context.d_curPTAct.keepBelow(last);
+		}
+		else
+			d_context.d_curPTAct.pop();
+	}
 
-			// Last prototype was not correct
-			// find new prototype with new vigilance
-			if(raiseVigilance)
-			{
-				vigilance = prot->resonance+d_trackingValue;
-				delete prot;
-				d_curPTAct.pop();
-				if (d_curPTAct.empty())
-					continue;
-				prot = d_curPTAct.top();
-				raiseVigilance = false;
-			}
-			// Return winning node
-			//cout << "prot: " << prot->id << " res: " << prot->resonance << endl;
-			if(prot->resonance >= vigilance)
-			{
-				//cout << "prot: " << prot->id << " res: " << prot->resonance << " Tj:" << prot->T << " inpsize: " << d_inputSize << endl ;
+	// Remove the nodes that do not resonate (with the possibly changed vigilance) and
+	// return the winning node
+	if(findWinner(d_context, vigilance, result))
+		return true;
 
-				output->push_back(prot->id);
-				return output;
-			}
-			// Remove node from list
-			// Check if the nodes can still be chosen
-			// when the vigilance changed
-			else
-			{
-				//cout << "No resonance id:" << prot->id << " resonance:" << prot->resonance << " vig:" << vigilance << endl;
-				delete prot;
-				d_curPTAct.pop();
-			}
-		}
+	// Return nothing if only testing for a match is used
+	if(d_testMatch)
+		return false;
+
+	// If empty create new prototype, a copy of F1 at the end of the prototype matrix
+	int id = d_useInputComplement ? d_F2.appendComplementRow(d_context.d_F1.empty() ? NULL : &d_context.d_F1[0], d_context.d_F1.size()) :
+			d_F2.appendRow(d_context.d_F1);
+	d_F2.recordWin(id, d_inputCount);
+	if(d_useHyperboxIndex)
+		d_index.insert(d_F2, id);
+	if(d_changeListener != NULL)
+		d_changeListener(d_changeContext, this, id);
+	result.push_back(id);
+	// nothing else resonated, the new node has all the activation
+	if(!d_useWTA)
+		result.push_back(1);
+	return true;
+}
+
+bool Art::findWinner(ArtContext &context, float vigilance, ArtResult &result) const
+{
+	if(!context.d_curPTAct.popUntilResonance(vigilance))
+		return false;
+	if(d_useWTA)
+		result.push_back(context.d_curPTAct.top().id);
+	else
+		distributedOutput(context, vigilance, result);
+	return true;
+}
+
+/**
+ * Nothing of the network itself is written, only the context: F1, the candidates and the buffers
+ * are all in there.
+ */
+bool Art::predict(const ART_TYPE* input, int nrFeatures, ArtResult &result, ArtContext &context, float vigilance) const
+{
+	result.clear();
+	createF1(input, nrFeatures, context);
+	signalToProtoType(context, vigilance);
+	return findWinner(context, vigilance, result);
+}
 
-		// Return nothing if only testing for a match is used
-		if(d_testMatch)
-			return NULL;
+/**
+ * A range scores like a task of scoreAllCategories(), the input size of every node follows from the
+ * buckets before it.
+ */
+int Art::predictRange(const ART_TYPE* input, int nrFeatures, int first, int last, float vigilance, int k,
+		PROTOTYPE_Activation* out, ArtContext &context) const
+{
+	createF1(input, nrFeatures, context);
+	if(first < 0)
+		first = 0;
+	if(last > d_F2.size())
+		last = d_F2.size();
+	if(first >= last || k <= 0)
+		return 0;
+	alignBuckets(context.d_F1.size(), context.d_alignments);
+	context.d_curPTAct.resize(last - first);
+	float inputSize = context.d_inputSize;
+	int best = -1;
+	context.d_curPTAct.resize(scoreCategories(context, first, last, inputSize, context.d_curPTAct.data(), best));
+	return context.d_curPTAct.selectTop(vigilance, k, out);
+}
 
-		// If empty create new prototype
-		PROTOTYPE *pr = new PROTOTYPE(0);
-		for (int x = 0; x < d_F1.size(); ++x)
-			(*pr).push_back(d_F1[x]);
+bool Art::predictFrom(const PROTOTYPE_Activation* candidates, int n, float vigilance, ArtResult &result,
+		ArtContext &context) const
+{
+	result.clear();
+	context.d_curPTAct.resize(n);
+	if(n > 0)
+		memcpy(context.d_curPTAct.data(), candidates, n * sizeof(PROTOTYPE_Activation));
+	return findWinner(context, vigilance, result);
+}
 
-		d_F2.push_back(pr);
-		output->push_back(d_F2.size()-1);
-		return output;
+/**
+ * The activations are the T values of the nodes divided by their sum. Without complement coding
+ * T can be negative, then the resonances are used instead. The winner comes first: it is the most
+ * active node that resonates, just like the top of the queue.
+ */
+void Art::distributedOutput(ArtContext &context, float vigilance, ArtResult &result) const
+{
+	context.d_topCategories.resize(d_nrOutputCategories);
+	int n = context.d_curPTAct.selectTop(vigilance, d_nrOutputCategories, &context.d_topCategories[0]);
+
+	bool positive = true;
+	ART_TYPE sumT = 0;
+	ART_TYPE sumResonance = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		if(context.d_topCategories[i].T <= 0)
+			positive = false;
+		sumT += context.d_topCategories[i].T;
+		sumResonance += context.d_topCategories[i].resonance;
 	}
-	else
-		return NULL;
+	for (int i = 0; i < n; ++i)
+	{
+		ART_TYPE activation = 1.0 / n;
+		if(positive)
+			activation = context.d_topCategories[i].T / sumT;
+		else if(sumResonance > 0)
+			activation = context.d_topCategories[i].resonance / sumResonance;
+		result.push_back(context.d_topCategories[i].id);
+		result.push_back(activation);
+	}
+}
+
+void Art::setDistributedOutput(int nrCategories)
+{
+	d_useWTA = nrCategories <= 1;
+	if(nrCategories > 1)
+		d_nrOutputCategories = nrCategories;
 }
 
 /**
@@ -401,7 +1137,7 @@ void Art::saveArtNetwork(std::string fileName)
 	{
 		outputFile.write((char *) &d_vigilance, sizeof(float));
 		outputFile.write((char *) &d_alpha, sizeof(float));
-		outputFile.write((char *) &d_inputSize, sizeof(float));
+		outputFile.write((char *) &d_context.d_inputSize, sizeof(float));
 		outputFile.write((char *) &d_trackingValue, sizeof(float));
 		outputFile.write((char *) &d_learningFraction, sizeof(float));
 		outputFile.write((char *) &d_networkReliability, sizeof(float));
@@ -413,20 +1149,28 @@ void Art::saveArtNetwork(std::string fileName)
 		outputFile.write((char *) &d_useWTA, sizeof(bool));
 		outputFile.write((char *) &d_testMatch, sizeof(bool));
 
-		int size = d_F1.size();
+		// the file has the whole F1, with the complement
+		int size = getF1Size(d_context);
 		outputFile.write((char *) &size, sizeof(int));
 
-		for (int x = 0; x < d_F1.size(); ++x)
-			outputFile.write((char *) &(d_F1[x]), sizeof(ART_TYPE));
+		for (int x = 0; x < (int)d_context.d_F1.size(); ++x)
+			outputFile.write((char *) &(d_context.d_F1[x]), sizeof(ART_TYPE));
+		if(d_useInputComplement)
+			for (int x = 0; x < (int)d_context.d_F1.size(); ++x)
+			{
+				ART_TYPE value = 1-d_context.d_F1[x];
+				outputFile.write((char *) &value, sizeof(ART_TYPE));
+			}
 
 		size = d_F2.size();
 		outputFile.write((char *) &size, sizeof(int));
 		for (int x = 0; x < d_F2.size(); ++x)
 		{
-			size = d_F2[x]->size();
+			size = d_F2.getRowSize(x);
+			const ART_TYPE* prot = d_F2.getRowData(x);
 			outputFile.write((char *) &size, sizeof(int));
-			for (int y = 0; y < d_F2[x]->size(); ++y)
-				outputFile.write((char *) &(*(d_F2[x]))[y], sizeof(ART_TYPE));
+			for (int y = 0; y < size; ++y)
+				outputFile.write((char *) &(prot[y]), sizeof(ART_TYPE));
 		}
 		size = d_vigilanceHist.size();
 		outputFile.write((char *) &size, sizeof(int));
@@ -437,6 +1181,205 @@ void Art::saveArtNetwork(std::string fileName)
 	}
 }
 
+/**
+ * The parameters of an image, in the order of saveArtNetwork() and then those it does not save.
+ * Flags are whole ints so that the struct has no padding.
+ */
+struct ArtImageParameters
+{
+	float	vigilance;
+	float	alpha;
+	float	inputSize;
+	float	trackingValue;
+	float	learningFraction;
+	float	networkReliability;
+	int		vigilanceHistorySize;
+	int		currVHist;
+	int		compressionCount;
+	int		matchTrack;
+	int		useInputComplement;
+	int		useWTA;
+	int		testMatch;
+	int		computationType;
+	int		nrOutputCategories;
+	unsigned int inputCount;
+};
+
+bool Art::saveArtNetworkImage(std::string fileName) const
+{
+	ArtImageParameters parameters;
+	parameters.vigilance			= d_vigilance;
+	parameters.alpha				= d_alpha;
+	parameters.inputSize			= d_context.d_inputSize;
+	parameters.trackingValue		= d_trackingValue;
+	parameters.learningFraction		= d_learningFraction;
+	parameters.networkReliability	= d_networkReliability;
+	parameters.vigilanceHistorySize	= d_vigilanceHistorySize;
+	parameters.currVHist			= d_currVHist;
+	parameters.compressionCount		= d_compressionCount;
+	parameters.matchTrack			= d_matchTrack;
+	parameters.useInputComplement	= d_useInputComplement;
+	parameters.useWTA				= d_useWTA;
+	parameters.testMatch			= d_testMatch;
+	parameters.computationType		= d_ACT;
+	parameters.nrOutputCategories	= d_nrOutputCategories;
+	parameters.inputCount			= d_inputCount;
+
+	ModelImageWriter image(MODEL_IMAGE_ART);
+	image.addSection(SECTION_ART_PARAMETERS, &parameters, sizeof(parameters));
+	// like saveArtNetwork() only the input of F1 is kept, not its complement
+	image.addArray(SECTION_ART_F1, d_context.d_F1);
+	image.addArray(SECTION_ART_VIGILANCE_HISTORY, d_vigilanceHist);
+	image.addArray(SECTION_ART_INPUT_OFFSET, d_inputOffset);
+	image.addArray(SECTION_ART_INPUT_SCALE, d_inputScale);
+	d_F2.addToImage(image);
+	return image.write(fileName);
+}
+
+bool Art::mapArtNetworkImage(std::string fileName)
+{
+	ModelImage image;
+	if(!image.open(fileName, MODEL_IMAGE_ART))
+		return false;
+	size_t bytes = 0;
+	const ArtImageParameters* parameters = (const ArtImageParameters*) image.getSection(SECTION_ART_PARAMETERS, bytes);
+	if(parameters == NULL || bytes < sizeof(ArtImageParameters))
+	{
+		printf("The model image %s has no network parameters.\n", fileName.c_str());
+		return false;
+	}
+	PrototypeMatrix F2;
+	if(!F2.mapImage(image))
+		return false;
+
+	d_vigilance				= parameters->vigilance;
+	d_alpha					= parameters->alpha;
+	d_context.d_inputSize	= parameters->inputSize;
+	d_trackingValue			= parameters->trackingValue;
+	d_learningFraction		= parameters->learningFraction;
+	d_networkReliability	= parameters->networkReliability;
+	d_vigilanceHistorySize	= parameters->vigilanceHistorySize;
+	d_currVHist				= parameters->currVHist;
+	d_compressionCount		= parameters->compressionCount;
+	d_matchTrack			= parameters->matchTrack != 0;
+	d_useInputComplement	= parameters->useInputComplement != 0;
+	d_useWTA				= parameters->useWTA != 0;
+	d_testMatch				= parameters->testMatch != 0;
+	d_ACT					= (ART_COMPUTATION_TYPE) parameters->computationType;
+	d_nrOutputCategories	= parameters->nrOutputCategories;
+	d_inputCount			= parameters->inputCount;
+	image.getArray(SECTION_ART_F1, d_context.d_F1);
+	image.getArray(SECTION_ART_VIGILANCE_HISTORY, d_vigilanceHist);
+	image.getArray(SECTION_ART_INPUT_OFFSET, d_inputOffset);
+	image.getArray(SECTION_ART_INPUT_SCALE, d_inputScale);
+	if(d_inputScale.size() != d_inputOffset.size())
+	{
+		d_inputOffset.clear();
+		d_inputScale.clear();
+	}
+
+	d_F2.swap(F2);
+	d_context.d_curPTAct.clear();
+	d_index.clear();
+	if(d_useHyperboxIndex)
+		d_index.build(d_F2);
+	return true;
+}
+
+bool Art::saveArtNetworkCompact(std::string fileName, const CompactModelOptions &options) const
+{
+	CompactWriter output;
+	if(!output.open(fileName, MODEL_IMAGE_ART, options))
+		return false;
+	output.putFloat(d_vigilance);
+	output.putFloat(d_alpha);
+	output.putFloat(d_context.d_inputSize);
+	output.putFloat(d_trackingValue);
+	output.putFloat(d_learningFraction);
+	output.putFloat(d_networkReliability);
+	output.putSigned(d_vigilanceHistorySize);
+	output.putSigned(d_currVHist);
+	output.putSigned(d_compressionCount);
+	output.putByte(d_matchTrack | (d_useInputComplement << 1) | (d_useWTA << 2) | (d_testMatch << 3));
+	output.putUnsigned(d_ACT);
+	output.putSigned(d_nrOutputCategories);
+	output.putUnsigned(d_inputCount);
+	output.putFloats(d_context.d_F1);
+	output.putFloats(d_vigilanceHist);
+	output.putFloats(d_inputOffset);
+	output.putFloats(d_inputScale);
+	d_F2.writeCompact(output, d_useInputComplement);
+	return output.close();
+}
+
+/**
+ * Everything is read before the network is changed. The prototypes go straight from the stream
+ * into the rows of a new matrix, which then replaces the one of the network.
+ */
+bool Art::loadArtNetworkCompact(std::string fileName)
+{
+	CompactReader input;
+	if(!input.open(fileName, MODEL_IMAGE_ART))
+		return false;
+	ART_TYPE vigilance			= input.getFloat();
+	ART_TYPE alpha				= input.getFloat();
+	ART_TYPE inputSize			= input.getFloat();
+	ART_TYPE trackingValue		= input.getFloat();
+	ART_TYPE learningFraction	= input.getFloat();
+	ART_TYPE networkReliability	= input.getFloat();
+	int vigilanceHistorySize	= input.getSigned();
+	int currVHist				= input.getSigned();
+	int compressionCount		= input.getSigned();
+	int flags					= input.getByte();
+	int computationType			= input.getUnsigned();
+	int nrOutputCategories		= input.getSigned();
+	unsigned int inputCount		= input.getUnsigned();
+	std::vector<ART_TYPE> F1, vigilanceHist, inputOffset, inputScale;
+	input.getFloats(F1);
+	input.getFloats(vigilanceHist);
+	input.getFloats(inputOffset);
+	input.getFloats(inputScale);
+	PrototypeMatrix F2;
+	if(input.failed() || !F2.readCompact(input, (flags & 2) != 0))
+	{
+		printf("The compact model %s is not a valid network.\n", fileName.c_str());
+		return false;
+	}
+
+	d_vigilance				= vigilance;
+	d_alpha					= alpha;
+	d_context.d_inputSize	= inputSize;
+	d_trackingValue			= trackingValue;
+	d_learningFraction		= learningFraction;
+	d_networkReliability	= networkReliability;
+	d_vigilanceHistorySize	= vigilanceHistorySize;
+	d_currVHist				= currVHist;
+	d_compressionCount		= compressionCount;
+	d_matchTrack			= (flags & 1) != 0;
+	d_useInputComplement	= (flags & 2) != 0;
+	d_useWTA				= (flags & 4) != 0;
+	d_testMatch				= (flags & 8) != 0;
+	d_ACT					= (ART_COMPUTATION_TYPE) computationType;
+	d_nrOutputCategories	= nrOutputCategories;
+	d_inputCount			= inputCount;
+	d_context.d_F1.swap(F1);
+	d_vigilanceHist.swap(vigilanceHist);
+	if(inputScale.size() != inputOffset.size())
+	{
+		inputOffset.clear();
+		inputScale.clear();
+	}
+	d_inputOffset.swap(inputOffset);
+	d_inputScale.swap(inputScale);
+
+	d_F2.swap(F2);
+	d_context.d_curPTAct.clear();
+	d_index.clear();
+	if(d_useHyperboxIndex)
+		d_index.build(d_F2);
+	return true;
+}
+
 /**
  * Loading the ART network from the given file.
  */
@@ -450,7 +1393,7 @@ void Art::loadArtNetWork(std::string fileName)
 		printf("Loading Art Network from file\n");
 		inputFile.read((char *) &d_vigilance, sizeof(float));
 		inputFile.read((char *) &d_alpha, sizeof(float));
-		inputFile.read((char *) &d_inputSize, sizeof(float));
+		inputFile.read((char *) &d_context.d_inputSize, sizeof(float));
 		inputFile.read((char *) &d_trackingValue, sizeof(float));
 		inputFile.read((char *) &d_learningFraction, sizeof(float));
 		inputFile.read((char *) &d_networkReliability, sizeof(float));
@@ -464,28 +1407,34 @@ void Art::loadArtNetWork(std::string fileName)
 		int size = 0;
 		inputFile.read((char *) &size, sizeof(int));
 
-		d_F1.clear();
+		d_context.d_F1.clear();
 		for (int x = 0; x < size; ++x)
 		{
 			ART_TYPE value = 0;
 			inputFile.read((char *) &value, sizeof(ART_TYPE));
-			d_F1.push_back(value);
+			d_context.d_F1.push_back(value);
 		}
+		// only the input is kept, the complement follows from it
+		if(d_useInputComplement)
+			d_context.d_F1.resize(size/2);
 
 		inputFile.read((char *) &size, sizeof(int));
+		d_F2.reserve(d_F2.size() + size);
+		PROTOTYPE prot(0);
 		for (int x = 0; x < size; ++x)
 		{
 			int size2 = 0;
 			inputFile.read((char *) &size2, sizeof(int));
 
-			d_F2.push_back(new vector<ART_TYPE>);
-
+			prot.clear();
 			for (int y = 0; y < size2; ++y)
 			{
 				ART_TYPE value = 0;
 				inputFile.read((char *) &value, sizeof(ART_TYPE));
-				(*(d_F2[x])).push_back(value);
+				prot.push_back(value);
 			}
+			// the usage is not saved, a loaded category counts as new
+			d_F2.recordWin(d_F2.appendRow(prot), d_inputCount);
 		}
 
 		inputFile.read((char *) &size, sizeof(int));
@@ -495,6 +1444,9 @@ void Art::loadArtNetWork(std::string fileName)
 			inputFile.read((char *) &value, sizeof(ART_TYPE));
 			d_vigilanceHist.push_back(value);
 		}
+
+		if(d_useHyperboxIndex)
+			d_index.build(d_F2);
 	}
 	else
 		printf("Failed loading Art input file\n");
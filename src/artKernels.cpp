@@ -0,0 +1,829 @@
+/*
+ * artKernels.cpp
+ *
+ * The vectorized versions are compiled with function-level target attributes, so the rest of the
+ * build does not need any -m flags and one binary runs on every x86 machine. On ARM the NEON
+ * version is used when the compiler targets NEON (always the case on AArch64).
+ */
+
+#include "artKernels.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ART_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ART_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace almendeSensorFusion
+{
+
+/**************************************************************************************************************
+ * Plain C++, this is exactly the arithmetic of the original loops in Art
+ *************************************************************************************************************/
+
+static ART_TYPE scalarFuzzyMin(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(min(a[i], w[i]));
+	return acc;
+}
+
+static ART_TYPE scalarAbsSum(const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(w[i]);
+	return acc;
+}
+
+static ART_TYPE scalarAbsDiff(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(a[i] - w[i]);
+	return acc;
+}
+
+static ART_TYPE scalarLearn(ART_TYPE* w, const ART_TYPE* a, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		w[i] = beta*( min(a[i], w[i]) )+(1 - beta)*w[i];
+		acc += fabs(w[i]);
+	}
+	return acc;
+}
+
+static ART_TYPE scalarFuzzyMinComplement(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(min(1 - x[i], w[i]));
+	return acc;
+}
+
+//! Value i of the complement coded F1 = (x, 1 - x) of 2n values
+static inline ART_TYPE codedF1(const ART_TYPE* x, int n, int i)
+{
+	return i < n ? x[i] : 1 - x[i - n];
+}
+
+static ART_TYPE scalarFuzzyMinCoded(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	return scalarFuzzyMinComplement(x, w + n, n, scalarFuzzyMin(x, w, n, acc));
+}
+
+static ART_TYPE scalarLearnComplement(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		w[i] = beta*( min(1 - x[i], w[i]) )+(1 - beta)*w[i];
+		acc += fabs(w[i]);
+	}
+	return acc;
+}
+
+static ART_TYPE scalarLearnCoded(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	return scalarLearnComplement(w + n, x, n, beta, scalarLearn(w, x, n, beta, acc));
+}
+
+static unsigned int scalarMinSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	unsigned int sum = 0;
+	for (int i = 0; i < n; ++i)
+		sum += min(a[i], w[i]);
+	return sum;
+}
+
+static unsigned int scalarAbsDiffSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	unsigned int sum = 0;
+	for (int i = 0; i < n; ++i)
+		sum += a[i] > w[i] ? a[i] - w[i] : w[i] - a[i];
+	return sum;
+}
+
+static ART_TYPE scalarFuzzyMinF16(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(min(a[i], halfToFloat(w[i])));
+	return acc;
+}
+
+static ART_TYPE scalarAbsDiffF16(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc)
+{
+	for (int i = 0; i < n; ++i)
+		acc += fabs(a[i] - halfToFloat(w[i]));
+	return acc;
+}
+
+static const ArtKernels scalarKernels = { scalarFuzzyMin, scalarAbsSum, scalarAbsDiff,
+		scalarLearn, scalarFuzzyMinCoded, scalarLearnCoded, scalarFuzzyMinComplement, scalarLearnComplement,
+		scalarMinSumU8, scalarAbsDiffSumU8, scalarFuzzyMinF16, scalarAbsDiffF16,
+		KERNEL_SCALAR, "scalar" };
+
+#ifdef ART_KERNELS_X86
+
+/**************************************************************************************************************
+ * AVX2: 8 floats per instruction, two accumulators to hide the latency of the additions
+ *************************************************************************************************************/
+
+#define ART_AVX2 __attribute__((target("avx2")))
+
+ART_AVX2 static inline __m256 avx2Abs(__m256 x)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+}
+
+ART_AVX2 static inline ART_TYPE avx2Sum(__m256 x)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+ART_AVX2 static ART_TYPE avx2FuzzyMin(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(w + i))));
+		s1 = _mm256_add_ps(s1, avx2Abs(_mm256_min_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(w + i + 8))));
+	}
+	for (; i + 8 <= n; i += 8)
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(w + i))));
+	ART_TYPE sum = avx2Sum(_mm256_add_ps(s0, s1));
+	for (; i < n; ++i)
+		sum += fabs(min(a[i], w[i]));
+	return acc + sum;
+}
+
+ART_AVX2 static ART_TYPE avx2AbsSum(const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m256 s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		s = _mm256_add_ps(s, avx2Abs(_mm256_loadu_ps(w + i)));
+	ART_TYPE sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += fabs(w[i]);
+	return acc + sum;
+}
+
+ART_AVX2 static ART_TYPE avx2AbsDiff(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m256 s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		s = _mm256_add_ps(s, avx2Abs(_mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(w + i))));
+	ART_TYPE sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += fabs(a[i] - w[i]);
+	return acc + sum;
+}
+
+//! The products and the sum are rounded separately (no FMA), so every weight is bit-identical to the
+//! plain C++ version
+ART_AVX2 static ART_TYPE avx2Learn(ART_TYPE* w, const ART_TYPE* a, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m256 b = _mm256_set1_ps(beta), nb = _mm256_set1_ps(1 - beta), s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 wv = _mm256_loadu_ps(w + i);
+		__m256 fast = _mm256_mul_ps(b, _mm256_min_ps(_mm256_loadu_ps(a + i), wv));
+		wv = _mm256_add_ps(fast, _mm256_mul_ps(nb, wv));
+		_mm256_storeu_ps(w + i, wv);
+		s = _mm256_add_ps(s, avx2Abs(wv));
+	}
+	return scalarLearn(w + i, a + i, n - i, beta, acc + avx2Sum(s));
+}
+
+ART_AVX2 static ART_TYPE avx2FuzzyMinComplement(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m256 one = _mm256_set1_ps(1), s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(_mm256_sub_ps(one, _mm256_loadu_ps(x + i)), _mm256_loadu_ps(w + i))));
+		s1 = _mm256_add_ps(s1, avx2Abs(_mm256_min_ps(_mm256_sub_ps(one, _mm256_loadu_ps(x + i + 8)), _mm256_loadu_ps(w + i + 8))));
+	}
+	for (; i + 8 <= n; i += 8)
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(_mm256_sub_ps(one, _mm256_loadu_ps(x + i)), _mm256_loadu_ps(w + i))));
+	ART_TYPE sum = avx2Sum(_mm256_add_ps(s0, s1));
+	for (; i < n; ++i)
+		sum += fabs(min(1 - x[i], w[i]));
+	return acc + sum;
+}
+
+//! Values i to i + 8 of the complement coded F1 = (x, 1 - x) of 2n values
+ART_AVX2 static inline __m256 avx2CodedF1(const ART_TYPE* x, int n, int i)
+{
+	if(i + 8 <= n)
+		return _mm256_loadu_ps(x + i);
+	if(i >= n)
+		return _mm256_sub_ps(_mm256_set1_ps(1), _mm256_loadu_ps(x + i - n));
+	// the 8 values where x ends and 1 - x starts, once per prototype
+	ART_TYPE a[8];
+	for (int l = 0; l < 8; ++l)
+		a[l] = codedF1(x, n, i + l);
+	return _mm256_loadu_ps(a);
+}
+
+//! avx2FuzzyMin() over the 2n values of the coded F1, in the same order
+ART_AVX2 static ART_TYPE avx2FuzzyMinCoded(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= 2 * n; i += 16)
+	{
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(avx2CodedF1(x, n, i), _mm256_loadu_ps(w + i))));
+		s1 = _mm256_add_ps(s1, avx2Abs(_mm256_min_ps(avx2CodedF1(x, n, i + 8), _mm256_loadu_ps(w + i + 8))));
+	}
+	for (; i + 8 <= 2 * n; i += 8)
+		s0 = _mm256_add_ps(s0, avx2Abs(_mm256_min_ps(avx2CodedF1(x, n, i), _mm256_loadu_ps(w + i))));
+	ART_TYPE sum = avx2Sum(_mm256_add_ps(s0, s1));
+	for (; i < 2 * n; ++i)
+		sum += fabs(min(codedF1(x, n, i), w[i]));
+	return acc + sum;
+}
+
+//! avx2Learn() over the 2n values of the coded F1, in the same order
+ART_AVX2 static ART_TYPE avx2LearnCoded(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m256 b = _mm256_set1_ps(beta), nb = _mm256_set1_ps(1 - beta), s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= 2 * n; i += 8)
+	{
+		__m256 wv = _mm256_loadu_ps(w + i);
+		__m256 fast = _mm256_mul_ps(b, _mm256_min_ps(avx2CodedF1(x, n, i), wv));
+		wv = _mm256_add_ps(fast, _mm256_mul_ps(nb, wv));
+		_mm256_storeu_ps(w + i, wv);
+		s = _mm256_add_ps(s, avx2Abs(wv));
+	}
+	ART_TYPE sum = acc + avx2Sum(s);
+	for (; i < 2 * n; ++i)
+	{
+		w[i] = beta*( min(codedF1(x, n, i), w[i]) )+(1 - beta)*w[i];
+		sum += fabs(w[i]);
+	}
+	return sum;
+}
+
+ART_AVX2 static ART_TYPE avx2LearnComplement(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m256 one = _mm256_set1_ps(1), b = _mm256_set1_ps(beta), nb = _mm256_set1_ps(1 - beta), s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 wv = _mm256_loadu_ps(w + i);
+		__m256 fast = _mm256_mul_ps(b, _mm256_min_ps(_mm256_sub_ps(one, _mm256_loadu_ps(x + i)), wv));
+		wv = _mm256_add_ps(fast, _mm256_mul_ps(nb, wv));
+		_mm256_storeu_ps(w + i, wv);
+		s = _mm256_add_ps(s, avx2Abs(wv));
+	}
+	ART_TYPE sum = acc + avx2Sum(s);
+	for (; i < n; ++i)
+	{
+		w[i] = beta*( min(1 - x[i], w[i]) )+(1 - beta)*w[i];
+		sum += fabs(w[i]);
+	}
+	return sum;
+}
+
+ART_AVX2 static inline unsigned int avx2Sum(__m256i x)
+{
+	__m128i s = _mm_add_epi64(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+	return (unsigned int)(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+//! _mm256_sad_epu8 against zero sums 8 bytes into each 64 bit lane
+ART_AVX2 static unsigned int avx2MinSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	__m256i s = _mm256_setzero_si256(), zero = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i m = _mm256_min_epu8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(w + i)));
+		s = _mm256_add_epi64(s, _mm256_sad_epu8(m, zero));
+	}
+	unsigned int sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += min(a[i], w[i]);
+	return sum;
+}
+
+ART_AVX2 static unsigned int avx2AbsDiffSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	__m256i s = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 32 <= n; i += 32)
+		s = _mm256_add_epi64(s, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(a + i)),
+				_mm256_loadu_si256((const __m256i*)(w + i))));
+	unsigned int sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += a[i] > w[i] ? a[i] - w[i] : w[i] - a[i];
+	return sum;
+}
+
+//! Every AVX2 CPU has F16C, the conversion of 8 halves to floats
+#define ART_AVX2_F16C __attribute__((target("avx2,f16c")))
+
+ART_AVX2_F16C static ART_TYPE avx2FuzzyMinF16(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc)
+{
+	__m256 s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 wv = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(w + i)));
+		s = _mm256_add_ps(s, avx2Abs(_mm256_min_ps(_mm256_loadu_ps(a + i), wv)));
+	}
+	ART_TYPE sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += fabs(min(a[i], halfToFloat(w[i])));
+	return acc + sum;
+}
+
+ART_AVX2_F16C static ART_TYPE avx2AbsDiffF16(const ART_TYPE* a, const ART_HALF* w, int n, ART_TYPE acc)
+{
+	__m256 s = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 wv = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(w + i)));
+		s = _mm256_add_ps(s, avx2Abs(_mm256_sub_ps(_mm256_loadu_ps(a + i), wv)));
+	}
+	ART_TYPE sum = avx2Sum(s);
+	for (; i < n; ++i)
+		sum += fabs(a[i] - halfToFloat(w[i]));
+	return acc + sum;
+}
+
+static const ArtKernels avx2Kernels = { avx2FuzzyMin, avx2AbsSum, avx2AbsDiff,
+		avx2Learn, avx2FuzzyMinCoded, avx2LearnCoded, avx2FuzzyMinComplement, avx2LearnComplement,
+		avx2MinSumU8, avx2AbsDiffSumU8, avx2FuzzyMinF16, avx2AbsDiffF16,
+		KERNEL_AVX2, "avx2" };
+
+/**************************************************************************************************************
+ * AVX-512: 16 floats per instruction, the tail is done with a masked load instead of scalar code
+ *************************************************************************************************************/
+
+#define ART_AVX512 __attribute__((target("avx512f")))
+
+// Some GCC versions warn about the "undefined" pass-through registers inside their own intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+ART_AVX512 static inline __m512 avx512Abs(__m512 x)
+{
+	return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x7fffffff)));
+}
+
+ART_AVX512 static inline __mmask16 avx512Tail(int n)
+{
+	return (__mmask16)((1u << n) - 1);
+}
+
+ART_AVX512 static ART_TYPE avx512FuzzyMin(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m512 s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(w + i))));
+	if(i < n)
+	{
+		__mmask16 k = avx512Tail(n - i);
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_maskz_loadu_ps(k, a + i), _mm512_maskz_loadu_ps(k, w + i))));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+ART_AVX512 static ART_TYPE avx512AbsSum(const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m512 s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_loadu_ps(w + i)));
+	if(i < n)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_maskz_loadu_ps(avx512Tail(n - i), w + i)));
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+ART_AVX512 static ART_TYPE avx512AbsDiff(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m512 s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(w + i))));
+	if(i < n)
+	{
+		__mmask16 k = avx512Tail(n - i);
+		s = _mm512_add_ps(s, avx512Abs(_mm512_sub_ps(_mm512_maskz_loadu_ps(k, a + i), _mm512_maskz_loadu_ps(k, w + i))));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+//! AVX-512 machines also have FMA, the compiler must not fuse the products and the sum here (see avx2Learn)
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static ART_TYPE avx512Learn(ART_TYPE* w, const ART_TYPE* a, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m512 b = _mm512_set1_ps(beta), nb = _mm512_set1_ps(1 - beta), s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512 wv = _mm512_loadu_ps(w + i);
+		__m512 fast = _mm512_mul_ps(b, _mm512_min_ps(_mm512_loadu_ps(a + i), wv));
+		wv = _mm512_add_ps(fast, _mm512_mul_ps(nb, wv));
+		_mm512_storeu_ps(w + i, wv);
+		s = _mm512_add_ps(s, avx512Abs(wv));
+	}
+	if(i < n)
+	{
+		__mmask16 k = avx512Tail(n - i);
+		__m512 wv = _mm512_maskz_loadu_ps(k, w + i);
+		__m512 fast = _mm512_mul_ps(b, _mm512_min_ps(_mm512_maskz_loadu_ps(k, a + i), wv));
+		wv = _mm512_add_ps(fast, _mm512_mul_ps(nb, wv));
+		_mm512_mask_storeu_ps(w + i, k, wv);
+		// masked out lanes are min(0, 0) * beta + 0 * (1 - beta) = 0
+		s = _mm512_add_ps(s, avx512Abs(wv));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+ART_AVX512 static ART_TYPE avx512FuzzyMinComplement(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	__m512 one = _mm512_set1_ps(1), s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_sub_ps(one, _mm512_loadu_ps(x + i)), _mm512_loadu_ps(w + i))));
+	if(i < n)
+	{
+		// masked out lanes are min(1 - 0, 0) = 0
+		__mmask16 k = avx512Tail(n - i);
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_sub_ps(one, _mm512_maskz_loadu_ps(k, x + i)), _mm512_maskz_loadu_ps(k, w + i))));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+/**
+ * The values of the complement coded F1 = (x, 1 - x) of 2n values from i on, in the lanes of k.
+ * The loops below use a plain load while i + 16 <= n and one subtraction from i >= n on, this is
+ * for the one place per prototype where x ends and 1 - x starts, and for the tail.
+ */
+ART_AVX512 static inline __attribute__((always_inline)) __m512 avx512CodedF1(const ART_TYPE* x, int n, int i, __mmask16 k)
+{
+	__m512 one = _mm512_set1_ps(1);
+	if(i >= n)
+		return _mm512_maskz_sub_ps(k, one, _mm512_maskz_loadu_ps(k, x + i - n));
+	__mmask16 low = k & avx512Tail(n - i);
+	__mmask16 high = k & (__mmask16)~low;
+	// lane l >= n - i takes 1 - x_l-(n-i), those are all within the first 16 values of x
+	__m512i lane = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m512i index = _mm512_sub_epi32(lane, _mm512_set1_epi32(n - i));
+	if(i == 0)
+	{
+		// less than 16 inputs: both from one load, lanes from 2n on take the zeros after x_n-1
+		index = _mm512_mask_mov_epi32(lane, high, index);
+		__m512 a = _mm512_permutexvar_ps(index, _mm512_maskz_loadu_ps(avx512Tail(n), x));
+		return _mm512_mask_sub_ps(a, high, one, a);
+	}
+	__m512 c = _mm512_permutexvar_ps(index, _mm512_maskz_loadu_ps(avx512Tail(min(n, 16)), x));
+	return _mm512_mask_sub_ps(_mm512_maskz_loadu_ps(low, x + i), high, one, c);
+}
+
+//! avx512FuzzyMin() over the 2n values of the coded F1, in the same order
+ART_AVX512 static ART_TYPE avx512FuzzyMinCoded(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	if(2 * n <= 16)
+	{
+		__mmask16 k = avx512Tail(2 * n);
+		return acc + _mm512_reduce_add_ps(avx512Abs(_mm512_min_ps(avx512CodedF1(x, n, 0, k), _mm512_maskz_loadu_ps(k, w))));
+	}
+	__m512 one = _mm512_set1_ps(1), s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(w + i))));
+	if(i < n && i + 16 <= 2 * n)
+	{
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(avx512CodedF1(x, n, i, 0xffff), _mm512_loadu_ps(w + i))));
+		i += 16;
+	}
+	for (; i + 16 <= 2 * n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(_mm512_sub_ps(one, _mm512_loadu_ps(x + i - n)), _mm512_loadu_ps(w + i))));
+	if(i < 2 * n)
+	{
+		__mmask16 k = avx512Tail(2 * n - i);
+		s = _mm512_add_ps(s, avx512Abs(_mm512_min_ps(avx512CodedF1(x, n, i, k), _mm512_maskz_loadu_ps(k, w + i))));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+//! One step of avx512Learn() on the lanes of k, returns the new weights
+__attribute__((target("avx512f"), optimize("fp-contract=off"), always_inline))
+static inline __m512 avx512LearnStep(ART_TYPE* w, __m512 a, __m512 b, __m512 nb, __mmask16 k)
+{
+	__m512 wv = _mm512_maskz_loadu_ps(k, w);
+	wv = _mm512_add_ps(_mm512_mul_ps(b, _mm512_min_ps(a, wv)), _mm512_mul_ps(nb, wv));
+	_mm512_mask_storeu_ps(w, k, wv);
+	return wv;
+}
+
+//! avx512Learn() over the 2n values of the coded F1, in the same order
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static ART_TYPE avx512LearnCoded(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m512 one = _mm512_set1_ps(1), b = _mm512_set1_ps(beta), nb = _mm512_set1_ps(1 - beta), s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(avx512LearnStep(w + i, _mm512_loadu_ps(x + i), b, nb, 0xffff)));
+	if(i < n && i + 16 <= 2 * n)
+	{
+		s = _mm512_add_ps(s, avx512Abs(avx512LearnStep(w + i, avx512CodedF1(x, n, i, 0xffff), b, nb, 0xffff)));
+		i += 16;
+	}
+	for (; i + 16 <= 2 * n; i += 16)
+		s = _mm512_add_ps(s, avx512Abs(avx512LearnStep(w + i, _mm512_sub_ps(one, _mm512_loadu_ps(x + i - n)), b, nb, 0xffff)));
+	if(i < 2 * n)
+	{
+		// masked out lanes are min(0, 0) * beta + 0 * (1 - beta) = 0
+		__mmask16 k = avx512Tail(2 * n - i);
+		s = _mm512_add_ps(s, avx512Abs(avx512LearnStep(w + i, avx512CodedF1(x, n, i, k), b, nb, k)));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static ART_TYPE avx512LearnComplement(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	__m512 one = _mm512_set1_ps(1), b = _mm512_set1_ps(beta), nb = _mm512_set1_ps(1 - beta), s = _mm512_setzero_ps();
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512 wv = _mm512_loadu_ps(w + i);
+		__m512 fast = _mm512_mul_ps(b, _mm512_min_ps(_mm512_sub_ps(one, _mm512_loadu_ps(x + i)), wv));
+		wv = _mm512_add_ps(fast, _mm512_mul_ps(nb, wv));
+		_mm512_storeu_ps(w + i, wv);
+		s = _mm512_add_ps(s, avx512Abs(wv));
+	}
+	if(i < n)
+	{
+		__mmask16 k = avx512Tail(n - i);
+		__m512 wv = _mm512_maskz_loadu_ps(k, w + i);
+		__m512 fast = _mm512_mul_ps(b, _mm512_min_ps(_mm512_sub_ps(one, _mm512_maskz_loadu_ps(k, x + i)), wv));
+		wv = _mm512_add_ps(fast, _mm512_mul_ps(nb, wv));
+		_mm512_mask_storeu_ps(w + i, k, wv);
+		// masked out lanes are min(1 - 0, 0) * beta + 0 * (1 - beta) = 0
+		s = _mm512_add_ps(s, avx512Abs(wv));
+	}
+	return acc + _mm512_reduce_add_ps(s);
+}
+
+#pragma GCC diagnostic pop
+
+//! The quantized sums are memory bound with AVX2 already, so they are shared (AVX-512 CPUs have AVX2)
+static const ArtKernels avx512Kernels = { avx512FuzzyMin, avx512AbsSum, avx512AbsDiff,
+		avx512Learn, avx512FuzzyMinCoded, avx512LearnCoded, avx512FuzzyMinComplement, avx512LearnComplement,
+		avx2MinSumU8, avx2AbsDiffSumU8, avx2FuzzyMinF16, avx2AbsDiffF16,
+		KERNEL_AVX512, "avx512" };
+
+#endif // ART_KERNELS_X86
+
+#ifdef ART_KERNELS_NEON
+
+/**************************************************************************************************************
+ * NEON: 4 floats per instruction, for the ARM boards on the robots
+ *************************************************************************************************************/
+
+static inline ART_TYPE neonSum(float32x4_t x)
+{
+	float32x2_t s = vadd_f32(vget_low_f32(x), vget_high_f32(x));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+static ART_TYPE neonFuzzyMin(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	float32x4_t s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		s = vaddq_f32(s, vabsq_f32(vminq_f32(vld1q_f32(a + i), vld1q_f32(w + i))));
+	ART_TYPE sum = neonSum(s);
+	for (; i < n; ++i)
+		sum += fabs(min(a[i], w[i]));
+	return acc + sum;
+}
+
+static ART_TYPE neonAbsSum(const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	float32x4_t s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		s = vaddq_f32(s, vabsq_f32(vld1q_f32(w + i)));
+	ART_TYPE sum = neonSum(s);
+	for (; i < n; ++i)
+		sum += fabs(w[i]);
+	return acc + sum;
+}
+
+static ART_TYPE neonAbsDiff(const ART_TYPE* a, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	float32x4_t s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		s = vaddq_f32(s, vabdq_f32(vld1q_f32(a + i), vld1q_f32(w + i)));
+	ART_TYPE sum = neonSum(s);
+	for (; i < n; ++i)
+		sum += fabs(a[i] - w[i]);
+	return acc + sum;
+}
+
+//! No fused multiply-add, so the weights are the same as in the plain C++ version
+__attribute__((optimize("fp-contract=off")))
+static ART_TYPE neonLearn(ART_TYPE* w, const ART_TYPE* a, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	float32x4_t b = vdupq_n_f32(beta), nb = vdupq_n_f32(1 - beta), s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		float32x4_t wv = vld1q_f32(w + i);
+		float32x4_t fast = vmulq_f32(b, vminq_f32(vld1q_f32(a + i), wv));
+		wv = vaddq_f32(fast, vmulq_f32(nb, wv));
+		vst1q_f32(w + i, wv);
+		s = vaddq_f32(s, vabsq_f32(wv));
+	}
+	return scalarLearn(w + i, a + i, n - i, beta, acc + neonSum(s));
+}
+
+static ART_TYPE neonFuzzyMinComplement(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	float32x4_t one = vdupq_n_f32(1), s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		s = vaddq_f32(s, vabsq_f32(vminq_f32(vsubq_f32(one, vld1q_f32(x + i)), vld1q_f32(w + i))));
+	ART_TYPE sum = neonSum(s);
+	for (; i < n; ++i)
+		sum += fabs(min(1 - x[i], w[i]));
+	return acc + sum;
+}
+
+//! Values i to i + 4 of the complement coded F1 = (x, 1 - x) of 2n values
+static inline float32x4_t neonCodedF1(const ART_TYPE* x, int n, int i)
+{
+	if(i + 4 <= n)
+		return vld1q_f32(x + i);
+	if(i >= n)
+		return vsubq_f32(vdupq_n_f32(1), vld1q_f32(x + i - n));
+	ART_TYPE a[4];
+	for (int l = 0; l < 4; ++l)
+		a[l] = codedF1(x, n, i + l);
+	return vld1q_f32(a);
+}
+
+//! neonFuzzyMin() over the 2n values of the coded F1, in the same order
+static ART_TYPE neonFuzzyMinCoded(const ART_TYPE* x, const ART_TYPE* w, int n, ART_TYPE acc)
+{
+	float32x4_t s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= 2 * n; i += 4)
+		s = vaddq_f32(s, vabsq_f32(vminq_f32(neonCodedF1(x, n, i), vld1q_f32(w + i))));
+	ART_TYPE sum = neonSum(s);
+	for (; i < 2 * n; ++i)
+		sum += fabs(min(codedF1(x, n, i), w[i]));
+	return acc + sum;
+}
+
+//! neonLearn() over the 2n values of the coded F1, in the same order
+__attribute__((optimize("fp-contract=off")))
+static ART_TYPE neonLearnCoded(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	float32x4_t b = vdupq_n_f32(beta), nb = vdupq_n_f32(1 - beta), s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= 2 * n; i += 4)
+	{
+		float32x4_t wv = vld1q_f32(w + i);
+		float32x4_t fast = vmulq_f32(b, vminq_f32(neonCodedF1(x, n, i), wv));
+		wv = vaddq_f32(fast, vmulq_f32(nb, wv));
+		vst1q_f32(w + i, wv);
+		s = vaddq_f32(s, vabsq_f32(wv));
+	}
+	ART_TYPE sum = acc + neonSum(s);
+	for (; i < 2 * n; ++i)
+	{
+		w[i] = beta*( min(codedF1(x, n, i), w[i]) )+(1 - beta)*w[i];
+		sum += fabs(w[i]);
+	}
+	return sum;
+}
+
+__attribute__((optimize("fp-contract=off")))
+static ART_TYPE neonLearnComplement(ART_TYPE* w, const ART_TYPE* x, int n, ART_TYPE beta, ART_TYPE acc)
+{
+	float32x4_t one = vdupq_n_f32(1), b = vdupq_n_f32(beta), nb = vdupq_n_f32(1 - beta), s = vdupq_n_f32(0);
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		float32x4_t wv = vld1q_f32(w + i);
+		float32x4_t fast = vmulq_f32(b, vminq_f32(vsubq_f32(one, vld1q_f32(x + i)), wv));
+		wv = vaddq_f32(fast, vmulq_f32(nb, wv));
+		vst1q_f32(w + i, wv);
+		s = vaddq_f32(s, vabsq_f32(wv));
+	}
+	return scalarLearnComplement(w + i, x + i, n - i, beta, acc + neonSum(s));
+}
+
+static inline unsigned int neonSum(uint32x4_t x)
+{
+	uint64x2_t s = vpaddlq_u32(x);
+	return (unsigned int)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+
+static unsigned int neonMinSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	uint32x4_t s = vdupq_n_u32(0);
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = vpadalq_u16(s, vpaddlq_u8(vminq_u8(vld1q_u8(a + i), vld1q_u8(w + i))));
+	return neonSum(s) + scalarMinSumU8(a + i, w + i, n - i);
+}
+
+static unsigned int neonAbsDiffSumU8(const ART_BYTE* a, const ART_BYTE* w, int n)
+{
+	uint32x4_t s = vdupq_n_u32(0);
+	int i = 0;
+	for (; i + 16 <= n; i += 16)
+		s = vpadalq_u16(s, vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(w + i))));
+	return neonSum(s) + scalarAbsDiffSumU8(a + i, w + i, n - i);
+}
+
+//! Not every ARM FPU converts halves, so those stay plain C++
+static const ArtKernels neonKernels = { neonFuzzyMin, neonAbsSum, neonAbsDiff,
+		neonLearn, neonFuzzyMinCoded, neonLearnCoded, neonFuzzyMinComplement, neonLearnComplement,
+		neonMinSumU8, neonAbsDiffSumU8, scalarFuzzyMinF16, scalarAbsDiffF16,
+		KERNEL_NEON, "neon" };
+
+#endif // ART_KERNELS_NEON
+
+/**************************************************************************************************************
+ * Dispatch
+ *************************************************************************************************************/
+
+static const ArtKernels* findKernels(ART_KERNEL_TYPE type)
+{
+	switch (type) {
+	case KERNEL_SCALAR:
+		return &scalarKernels;
+#ifdef ART_KERNELS_X86
+	case KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") ? &avx2Kernels : NULL;
+	case KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f") ? &avx512Kernels : NULL;
+#endif
+#ifdef ART_KERNELS_NEON
+	case KERNEL_NEON:
+		return &neonKernels;
+#endif
+	case KERNEL_AUTO:
+	{
+		const ArtKernels* best = NULL;
+		if((best = findKernels(KERNEL_AVX512)) != NULL) return best;
+		if((best = findKernels(KERNEL_AVX2)) != NULL) return best;
+		if((best = findKernels(KERNEL_NEON)) != NULL) return best;
+		return &scalarKernels;
+	}
+	default:
+		return NULL;
+	}
+}
+
+static const ArtKernels* s_kernels = NULL;
+
+//! Networks classify on several threads, each of them can be the first to ask (they find the same)
+const ArtKernels& getArtKernels()
+{
+	const ArtKernels* kernels = __atomic_load_n(&s_kernels, __ATOMIC_ACQUIRE);
+	if(kernels == NULL)
+	{
+		kernels = findKernels(KERNEL_AUTO);
+		__atomic_store_n(&s_kernels, kernels, __ATOMIC_RELEASE);
+	}
+	return *kernels;
+}
+
+bool selectArtKernels(ART_KERNEL_TYPE type)
+{
+	const ArtKernels* kernels = findKernels(type);
+	if(kernels == NULL)
+		return false;
+	__atomic_store_n(&s_kernels, kernels, __ATOMIC_RELEASE);
+	return true;
+}
+
+}
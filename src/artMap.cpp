@@ -6,24 +6,385 @@
  */
 
 #include "artMap.h"
+#include "modelImage.h"
+#include <algorithm>
+#include <climits>
 #define DEBUG_INFO 1
 using namespace std;
 
 namespace almendeSensorFusion
 {
 
+/*
+ * The files have both directions of the map field as outer elements with lists of connections: per
+ * network a list for each F2 node, and per map field node a list for each network. In memory both
+ * are kept per network (see ConnectionLists), "byMapNode" tells which of the two a side is.
+ */
+static int getNrOuter(const std::vector<ConnectionLists> &side, bool byMapNode)
+{
+	if(!byMapNode)
+		return side.size();
+	int nrOuter = 0;
+	for (int x = 0; x < (int)side.size(); ++x)
+		nrOuter = std::max(nrOuter, side[x].size());
+	return nrOuter;
+}
+
+static int getNrLists(const std::vector<ConnectionLists> &side, bool byMapNode, int outer)
+{
+	if(!byMapNode)
+		return side[outer].size();
+	int nrLists = 0;
+	for (int x = 0; x < (int)side.size(); ++x)
+		if(outer < side[x].size())
+			nrLists = x + 1;
+	return nrLists;
+}
+
+static const MAPFIELD_CONNECTION* getList(const std::vector<ConnectionLists> &side, bool byMapNode, int outer,
+		int list, int &size)
+{
+	const ConnectionLists &lists = side[byMapNode ? list : outer];
+	int y = byMapNode ? outer : list;
+	size = y < lists.size() ? lists.size(y) : 0;
+	return size > 0 ? lists.begin(y) : NULL;
+}
+
+//! Set a list, the networks and the lists before it are created empty
+static void setList(std::vector<ConnectionLists> &side, bool byMapNode, int outer, int list,
+		const MAPFIELD_CONNECTION* connections, int count)
+{
+	int x = byMapNode ? list : outer;
+	int y = byMapNode ? outer : list;
+	if((int)side.size() <= x)
+		side.resize(x + 1);
+	if(side[x].size() <= y)
+		side[x].resize(y + 1);
+	side[x].assign(y, connections, count);
+}
+
+/*
+ * The flat form of one direction of the map field in a model image: the lists of outer element x
+ * are lists[x] up to lists[x + 1], the connections of list y are edges[y] up to edges[y + 1].
+ */
+static void flattenConnections(const std::vector<ConnectionLists> &side, bool byMapNode, std::vector<int> &lists,
+		std::vector<int> &edges, std::vector<int> &ids, std::vector<ART_TYPE> &weights)
+{
+	lists.assign(1, 0);
+	edges.assign(1, 0);
+	int nrOuter = getNrOuter(side, byMapNode);
+	for (int x = 0; x < nrOuter; ++x)
+	{
+		int nrLists = getNrLists(side, byMapNode, x);
+		for (int y = 0; y < nrLists; ++y)
+		{
+			int size = 0;
+			const MAPFIELD_CONNECTION* list = getList(side, byMapNode, x, y, size);
+			for (int z = 0; z < size; ++z)
+			{
+				ids.push_back(list[z].first);
+				weights.push_back(list[z].second);
+			}
+			edges.push_back(ids.size());
+		}
+		lists.push_back(edges.size() - 1);
+	}
+}
+
+/*
+ * Returns false if the arrays do not fit together, or if a connection is to a negative index or to
+ * a map node of nrMapNodes or more (the lists of map nodes too).
+ */
+static bool unflattenConnections(const ModelImage &image, int listsId, int edgesId, int idsId, int weightsId,
+		std::vector<ConnectionLists> &side, bool byMapNode, int nrMapNodes)
+{
+	int nrLists = 0, nrEdges = 0, nrIds = 0, nrWeights = 0;
+	const int* lists = image.getArray<int>(listsId, nrLists);
+	const int* edges = image.getArray<int>(edgesId, nrEdges);
+	const int* ids = image.getArray<int>(idsId, nrIds);
+	const ART_TYPE* weights = image.getArray<ART_TYPE>(weightsId, nrWeights);
+	if(lists == NULL || edges == NULL || ids == NULL || weights == NULL || nrLists < 1 || nrEdges < 1 ||
+			nrIds != nrWeights || lists[nrLists - 1] != nrEdges - 1 || edges[nrEdges - 1] != nrIds)
+		return false;
+	for (int x = 0; x + 1 < nrLists; ++x)
+		if(lists[x] < 0 || lists[x] > lists[x + 1])
+			return false;
+	for (int y = 0; y + 1 < nrEdges; ++y)
+		if(edges[y] < 0 || edges[y] > edges[y + 1])
+			return false;
+	if(byMapNode && nrLists - 1 > nrMapNodes)
+		return false;
+	for (int z = 0; z < nrIds; ++z)
+		if(ids[z] < 0 || (!byMapNode && ids[z] >= nrMapNodes))
+			return false;
+
+	if(!byMapNode)
+		side.resize(nrLists - 1);
+	std::vector<MAPFIELD_CONNECTION> connections(0);
+	for (int x = 0; x + 1 < nrLists; ++x)
+	{
+		for (int y = lists[x]; y < lists[x + 1]; ++y)
+		{
+			connections.clear();
+			for (int z = edges[y]; z < edges[y + 1]; ++z)
+				connections.push_back(MAPFIELD_CONNECTION(ids[z], weights[z]));
+			setList(side, byMapNode, x, y - lists[x], connections.empty() ? NULL : &connections[0], connections.size());
+		}
+	}
+	return true;
+}
+
+/*
+ * The compact form of one direction of the map field, see ArtMap::saveArtMapCompact(). The weights
+ * are always kept exactly: a weight that is not a multiple of the learning fraction is written as
+ * it is, after an odd number.
+ */
+static void writeConnections(const std::vector<ConnectionLists> &side, bool byMapNode, float learningFraction,
+		CompactWriter &output)
+{
+	int nrOuter = getNrOuter(side, byMapNode);
+	output.putUnsigned(nrOuter);
+	for (int x = 0; x < nrOuter; ++x)
+	{
+		int nrLists = getNrLists(side, byMapNode, x);
+		output.putUnsigned(nrLists);
+		for (int y = 0; y < nrLists; ++y)
+		{
+			int size = 0;
+			const MAPFIELD_CONNECTION* list = getList(side, byMapNode, x, y, size);
+			output.putUnsigned(size);
+			int previous = 0;
+			for (int z = 0; z < size; ++z)
+			{
+				const MAPFIELD_CONNECTION &connection = list[z];
+				output.putSigned(connection.first - previous);
+				previous = connection.first;
+				ART_TYPE weight = connection.second;
+				ART_TYPE ratio = learningFraction > 0 ? weight / learningFraction : -1;
+				int multiple = ratio >= 0 && ratio < (1 << 30) ? (int)(ratio + 0.5f) : -1;
+				if(multiple >= 0 && (ART_TYPE)(multiple * learningFraction) == weight)
+					output.putUnsigned((uint64_t)multiple << 1);
+				else
+				{
+					output.putUnsigned(1);
+					output.putFloat(weight);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Returns false if the stream is not valid, also if a connection is to a negative index or to a
+ * map node of nrMapNodes or more (the lists of map nodes too).
+ */
+static bool readConnections(CompactReader &input, float learningFraction, std::vector<ConnectionLists> &side,
+		bool byMapNode, int nrMapNodes)
+{
+	int nrOuter = input.getCount(byMapNode ? nrMapNodes : 1 << 30);
+	if(!byMapNode && !input.failed())
+		side.resize(nrOuter);
+	std::vector<MAPFIELD_CONNECTION> connections(0);
+	for (int x = 0; x < nrOuter && !input.failed(); ++x)
+	{
+		int nrLists = input.getCount(1 << 30);
+		for (int y = 0; y < nrLists && !input.failed(); ++y)
+		{
+			// the list is read before it is allocated, a broken count ends at the end of the stream
+			connections.clear();
+			int size = input.getCount(1 << 30);
+			int64_t previous = 0;
+			for (int z = 0; z < size && !input.failed(); ++z)
+			{
+				previous += input.getSigned();
+				if(previous < 0 || previous >= (byMapNode ? (int64_t)INT_MAX : nrMapNodes))
+					return false;
+				uint64_t code = input.getUnsigned();
+				ART_TYPE weight = (code & 1) ? input.getFloat() : (ART_TYPE)((int)(code >> 1) * learningFraction);
+				connections.push_back(MAPFIELD_CONNECTION((int)previous, weight));
+			}
+			if(!input.failed())
+				setList(side, byMapNode, x, y, connections.empty() ? NULL : &connections[0], connections.size());
+		}
+	}
+	return !input.failed();
+}
+
+/*
+ * Both sides have a ConnectionLists for every network that has connections, and a loaded map field
+ * is packed as tight as it can be.
+ */
+static void finishConnections(std::vector<ConnectionLists> &artF2, std::vector<ConnectionLists> &mapNodes)
+{
+	int nrNetworks = std::max(artF2.size(), mapNodes.size());
+	artF2.resize(nrNetworks);
+	mapNodes.resize(nrNetworks);
+	for (int x = 0; x < nrNetworks; ++x)
+	{
+		artF2[x].compact();
+		mapNodes[x].compact();
+	}
+}
+
+/*
+ * The index in a list of connections of the given occurrence of a node, or the size of the list
+ * if it has fewer.
+ */
+static int findConnection(const ConnectionLists &lists, int list, int node, int occurrence)
+{
+	const MAPFIELD_CONNECTION* connections = lists.begin(list);
+	for (int i = 0; i < lists.size(list); ++i)
+		if(connections[i].first == node && occurrence-- == 0)
+			return i;
+	return lists.size(list);
+}
+
+//! The position of the first connection to a node in a list, -1 if there is none (or no such list)
+static int getPosition(const ConnectionLists &lists, int list, int node)
+{
+	if(list >= lists.size())
+		return -1;
+	int i = findConnection(lists, list, node, 0);
+	return i < lists.size(list) ? i : -1;
+}
+
+/*
+ * Older versions could connect a category to a map field node more than once (see
+ * ArtMap::addToMapNode()). The connections to a node that is in a list more than once are merged
+ * into the first one, which gets the largest of their weights: with WTA output only one of them
+ * counted anyway, and the weights only grow.
+ */
+static void mergeConnections(ConnectionLists &lists, int list, std::vector<std::pair<int, int> > &order)
+{
+	int size = lists.size(list);
+	if(size < 2)
+		return;
+	MAPFIELD_CONNECTION* connections = lists.begin(list);
+	// the positions sorted on the node, those of one node in the order of the list
+	order.clear();
+	for (int i = 0; i < size; ++i)
+		order.push_back(std::make_pair(connections[i].first, i));
+	std::sort(order.begin(), order.end());
+	std::vector<bool> merged(0);
+	for (int k = 1, first = 0; k < size; ++k)
+	{
+		if(order[k].first != order[first].first)
+		{
+			first = k;
+			continue;
+		}
+		ART_TYPE &weight = connections[order[first].second].second;
+		weight = std::max(weight, connections[order[k].second].second);
+		merged.resize(size, false);
+		merged[order[k].second] = true;
+	}
+	if(merged.empty())
+		return;
+	int next = 0;
+	for (int i = 0; i < size; ++i)
+		if(!merged[i])
+			connections[next++] = connections[i];
+	lists.truncate(list, next);
+}
+
+static bool lessMapNode(const MAPFIELD_CONNECTION &first, const MAPFIELD_CONNECTION &second)
+{
+	return first.first < second.first;
+}
+
+/*
+ * Sort the activity of the map field nodes on the node and merge the activity a node got more than
+ * once, in the order it got it: with WTA output the last one counts, otherwise they are added up.
+ * A list of connections is mostly sorted already, it is only sorted when it is not.
+ */
+static void mergeActivity(ART_MAPFIELD &activity, bool wta)
+{
+	int x = 1;
+	while(x < (int)activity.size() && activity[x - 1].first < activity[x].first)
+		++x;
+	if(x >= (int)activity.size())
+		return;
+	std::stable_sort(activity.begin(), activity.end(), lessMapNode);
+	int next = 0;
+	for (x = 0; x < (int)activity.size(); ++x)
+	{
+		if(next > 0 && activity[next - 1].first == activity[x].first)
+		{
+			if(wta)
+				activity[next - 1].second = activity[x].second;
+			else
+				activity[next - 1].second += activity[x].second;
+		}
+		else
+			activity[next++] = activity[x];
+	}
+	activity.resize(next);
+}
+
+//! Add the popularity of the map field nodes in a view to the total, both are sorted on the node
+static void addPopularity(ART_MAPFIELD_POPULARITY &total, const ART_MAPFIELD_POPULARITY &popularity)
+{
+	ART_MAPFIELD_POPULARITY merged(0);
+	merged.reserve(total.size() + popularity.size());
+	int next = 0;
+	for (int x = 0; x < (int)popularity.size(); ++x)
+	{
+		while(next < (int)total.size() && total[next].mapNode < popularity[x].mapNode)
+			merged.push_back(total[next++]);
+		if(next < (int)total.size() && total[next].mapNode == popularity[x].mapNode)
+		{
+			merged.push_back(total[next++]);
+			merged.back().votes += popularity[x].votes;
+			merged.back().activation += popularity[x].activation;
+		}
+		else
+			merged.push_back(popularity[x]);
+	}
+	merged.insert(merged.end(), total.begin() + next, total.end());
+	total.swap(merged);
+}
+
+//! The parameters of an image of the map field, flags as ints so the struct has no padding
+struct ArtMapImageParameters
+{
+	float	learningFraction;
+	float	vigilance;
+	int		nrMapNodes;
+	int		nrOfInputClasses;
+	int		useVigilance;
+};
+
 /**
  * An ARTMAP basically exists out of ART networks and an association field in between the
  * networks.
  */
 ArtMap::ArtMap(std::vector<Art*>* networks, float learnFraction): d_artF2(0),
-		d_mapNodes(0)
+		d_mapNodes(0),
+		d_changeListener(NULL),
+		d_changeContext(NULL),
+		d_pruneListener(NULL),
+		d_pruneContext(NULL)
 {
 	d_learningFraction 	= learnFraction;
 	d_artNetworks		= networks;
 	d_nrMapNodes		= 0;
 	d_nrOfInputClasses  = 0;
 	//d_useVigilance		= false;
+	for (int x = 0; x < (int)d_artNetworks->size(); ++x)
+		(*d_artNetworks)[x]->setPruneListener(&ArtMap::onArtPruned, this);
+}
+
+//! The networks are not owned by the ARTMAP, they only stop telling it about removed categories
+ArtMap::~ArtMap()
+{
+	for (int x = 0; x < (int)d_artNetworks->size(); ++x)
+		(*d_artNetworks)[x]->setPruneListener(NULL, NULL);
+}
+
+void ArtMap::addArtNetwork(Art* artNetwork)
+{
+	d_artNetworks->push_back(artNetwork);
+	artNetwork->setPruneListener(&ArtMap::onArtPruned, this);
 }
 
 /**
@@ -79,6 +440,91 @@ ART_DISTRIBUTED_CLASSES* ArtMap::classify(ART_VIEW& multipleInputVectors)
 	return artClasses;
 }
 
+/**
+ * The same steps as classify() and mapClasses(), without the learning: the ART networks predict
+ * instead of classify, and the winning map field node is only used to find the missing classes.
+ */
+bool ArtMap::predict(const ART_VIEW& multipleInputVectors, std::vector<ArtResult> &results, ArtMapContext &context) const
+{
+	int nrInputs = multipleInputVectors.size();
+	results.resize(nrInputs);
+	if((int)context.size() < nrInputs)
+		context.resize(nrInputs);
+
+	ART_NETWORK_INDICES* nrOfSuperv = getSupervisors(&multipleInputVectors);
+	int nrOfInputClasses = 0;
+	for (int x = 0; x < nrInputs; ++x)
+		if(multipleInputVectors[x] != NULL)
+			++nrOfInputClasses;
+
+	ART_DISTRIBUTED_CLASSES artClasses(nrInputs);
+	for (int artNr = 0; artNr < nrInputs; ++artNr)
+	{
+		results[artNr].clear();
+		if(multipleInputVectors[artNr] == NULL)
+		{
+			artClasses[artNr] = NULL;
+			continue;
+		}
+		// The vigilance of classify(), see there
+		const Art* art = (*d_artNetworks)[artNr];
+		bool mt = art->getMatchTrack();
+		if(nrOfSuperv->size() == 0 && (nrOfInputClasses > 1 || d_useVigilance))
+			mt = false;
+		art->predict(*(multipleInputVectors[artNr]), results[artNr], context[artNr], art->getBaseVigilance(mt));
+		// no class activates no map field node
+		artClasses[artNr] = &results[artNr].getValues();
+	}
+	delete nrOfSuperv;
+
+	ART_MAPFIELDS* mnActList = mapNodeActivation(&artClasses);
+	if(mnActList == NULL)
+		return false;
+	vector<ART_TYPE> artN_new_nodes(0);
+	ART_MAPFIELD_INDICES input_map_nodes(nrInputs);
+	ART_NETWORK_INDICES noSupervisors(0);
+	int maxNodeNr 			= -1;
+	ART_TYPE maxNodeCount 	= 0;
+	ART_MAPFIELD_POPULARITY* node_values = calcWinningNode(mnActList, &artN_new_nodes, &input_map_nodes,
+			&noSupervisors, &maxNodeNr, &maxNodeCount);
+	delete node_values;
+	delete mnActList;
+
+	for (int artNr = 0; artNr < nrInputs; ++artNr)
+	{
+		if(multipleInputVectors[artNr] != NULL)
+			continue;
+		int classId = getArtClassWTA(artNr, maxNodeNr);
+		if(classId != -1)
+			results[artNr].push_back(classId);
+	}
+	return true;
+}
+
+/**
+ * The map field is copied array by array, a snapshot that is synchronized again and again (see
+ * ArtMapPublisher) then only allocates when the map field outgrew its arrays.
+ */
+void ArtMap::syncFrom(const ArtMap &source)
+{
+	if(this == &source)
+		return;
+	d_learningFraction	= source.d_learningFraction;
+	d_vigilance			= source.d_vigilance;
+	d_nrMapNodes		= source.d_nrMapNodes;
+	d_nrOfInputClasses	= source.d_nrOfInputClasses;
+	d_useVigilance		= source.d_useVigilance;
+	d_artF2.resize(source.d_artF2.size());
+	d_mapNodes.resize(source.d_mapNodes.size());
+	d_edgeIndex.resize(source.d_edgeIndex.size());
+	for (size_t x = 0; x < d_artF2.size(); ++x)
+		d_artF2[x].syncFrom(source.d_artF2[x]);
+	for (size_t x = 0; x < d_mapNodes.size(); ++x)
+		d_mapNodes[x].syncFrom(source.d_mapNodes[x]);
+	for (size_t x = 0; x < d_edgeIndex.size(); ++x)
+		d_edgeIndex[x].syncFrom(source.d_edgeIndex[x]);
+}
+
 /**
  * This method classifies input and returns the distributed map node activation. The inputs are meant
  * for all the involved ART networks and can even be about multiple views (over time or distance e.g.).
@@ -87,7 +533,7 @@ ART_DISTRIBUTED_CLASSES* ArtMap::classify(ART_VIEW& multipleInputVectors)
 ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInputVectors,
 		int* foundCount, std::vector<int>* winnerCount, F2_TO_MAPFIELD* distOutput)
 {
-	vector<pair<int,ART_TYPE>*>* total_node_values = new vector<pair<int,ART_TYPE>*>(0);
+	ART_MAPFIELD_POPULARITY total_node_values(0);
 	*foundCount = 0;
 
 	// iterate over all views
@@ -124,7 +570,7 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 		// Temp values //
 
 		// calculate winning Node and activations
-		vector<pair<int,ART_TYPE>*>* node_values = calcWinningNode(result, &artN_new_nodes, &input_map_nodes,
+		ART_MAPFIELD_POPULARITY* node_values = calcWinningNode(result, &artN_new_nodes, &input_map_nodes,
 				nrSv, &maxNodeNr, &maxNodeCount);
 
 		// finalize the matchtrack process (means: update the weights)
@@ -142,18 +588,12 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 		//Sum the node values
 		if(node_values != NULL)
 		{
+			addPopularity(total_node_values, *node_values);
+			delete node_values;
 			bool nodeFound = false;
-			for (int nodeNr = 0; nodeNr < node_values->size(); ++nodeNr)
-			{
-				while(total_node_values->size() < node_values->size())
-					total_node_values->push_back(new pair<int, ART_TYPE>(0,0.0));
-				(*total_node_values)[nodeNr]->first += (*node_values)[nodeNr]->first;
-				(*total_node_values)[nodeNr]->second += (*node_values)[nodeNr]->second;
-				if((*total_node_values)[nodeNr]->first > 0)
+			for (int x = 0; x < (int)total_node_values.size(); ++x)
+				if(total_node_values[x].votes > 0)
 					nodeFound = true;
-				delete (*node_values)[nodeNr];
-			}
-			delete node_values;
 			if(nodeFound) ++(*foundCount);
 		}
 	}
@@ -161,15 +601,12 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 	// Debugging info
 #if DEBUG_INFO > 0
 //	cout << "MapField Activation:" << endl;
-	for (int nodeNr = 0; nodeNr < total_node_values->size(); ++nodeNr)
+	for (int x = 0; x < (int)total_node_values.size(); ++x)
 	{
-		cout << "	Mapfield ID:" << nodeNr << " Connections:" << (*total_node_values)[nodeNr]->first << " Total weight:" << (*total_node_values)[nodeNr]->second << endl;
+		cout << "	Mapfield ID:" << total_node_values[x].mapNode << " Connections:" << total_node_values[x].votes << " Total weight:" << total_node_values[x].activation << endl;
 	}
 #endif
 
-	// First search if there is a node
-	for (int nodeNr = 0; nodeNr < total_node_values->size(); ++nodeNr){ 	}
-
 	vector<ART_TYPE>* artClasses = NULL;
 
 	// For all ART networks that where empty find the associated classes
@@ -185,11 +622,12 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 			{
 				//std::cout << "find empty class art: " << artNr << std::endl;
 				vector<pair<int,ART_TYPE>*>* artClassValues = new vector<pair<int,ART_TYPE>*>(0);
-				for (int nodeNr = 0; nodeNr < total_node_values->size(); ++nodeNr)
+				for (int x = 0; x < (int)total_node_values.size(); ++x)
 				{
-					if((*total_node_values)[nodeNr]->first > 0)
+					const ART_MAPFIELD_NODE_POPULARITY &node = total_node_values[x];
+					if(node.votes > 0)
 					{
-						int artClass = getArtClassWTA(artNr, nodeNr);
+						int artClass = getArtClassWTA(artNr, node.mapNode);
 						if(artClass != -1)
 						{
 							while(artClassValues->size() <= artClass)
@@ -197,14 +635,14 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 
 							// Edited!!
 							// now using the mapnode active connection count instead of 1 time activation
-							(*artClassValues)[artClass]->first += (*total_node_values)[nodeNr]->first;
-							(*artClassValues)[artClass]->second += (*total_node_values)[nodeNr]->second;
+							(*artClassValues)[artClass]->first += node.votes;
+							(*artClassValues)[artClass]->second += node.activation;
 							// Edited!!
 							// the winning class is the one connected to the mapfield with the heights number of connection
 							// Only this way we can overcome the plasticity stability dilemma
-							if((*total_node_values)[nodeNr]->first > winnCount)
+							if(node.votes > winnCount)
 							{
-								winnCount = (*total_node_values)[nodeNr]->first;
+								winnCount = node.votes;
 								winningClass = artClass;
 								//cout << "winnclass " << winningClass << " winncount " << winnCount << endl;
 							}
@@ -218,12 +656,12 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 					// Check if there is another mapfield with the same number of connections
 					// if so than if the associated class has a higher amount of active connections, then it will be chosen
 					ART_TYPE winnValue = (*artClassValues)[winningClass]->first;
-					for (int nodeNr = 0; nodeNr < total_node_values->size(); ++nodeNr)
+					for (int x = 0; x < (int)total_node_values.size(); ++x)
 					{
-						int artClass = getArtClassWTA(artNr, nodeNr);
+						int artClass = getArtClassWTA(artNr, total_node_values[x].mapNode);
 						if(artClass != -1)
 						{
-							if((*total_node_values)[nodeNr]->first == winnCount && winnValue < (*artClassValues)[artClass]->second)
+							if(total_node_values[x].votes == winnCount && winnValue < (*artClassValues)[artClass]->second)
 							{
 								winnValue 		= (*artClassValues)[artClass]->second;
 								winningClass	 = artClass;
@@ -252,10 +690,6 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
 			}
 		}
 	}
-	// clean up stuff
-	for (int nodeNr = 0; nodeNr < total_node_values->size(); ++nodeNr)
-		delete (*total_node_values)[nodeNr];
-	delete total_node_values;
 	return artClasses;
 }
 
@@ -268,11 +702,14 @@ ART_DISTRIBUTED_CLASS* ArtMap::distMapNodeClassification(ART_VIEWS* multipleInpu
  * @param nrSv				in: indices to the ART networks that are supervising
  * @param maxNodeNr			out: the index to the map field node with maximum overall activity
  * @param maxNodeCount		out: the number of ART networks that do activate this map field node
- * @return					out: "popularity" of each map field node
+ * @return					out: "popularity" of each map field node that is activated, sorted on the node
+ *
+ * Only the activated map field nodes are visited, so the work does not grow with the size of the map
+ * field. They are visited in the order of their index, which decides the ties as it always did.
  */
 ART_MAPFIELD_POPULARITY* ArtMap::calcWinningNode(ART_MAPFIELDS* mnActList,
 		vector<ART_TYPE>* artN_new_nodes, ART_MAPFIELD_INDICES* input_map_nodes, ART_NETWORK_INDICES* nrSv,
-		int *maxNodeNr , ART_TYPE *maxNodeCount)
+		int *maxNodeNr , ART_TYPE *maxNodeCount) const
 {
 	/****************WARNING SUPERBAD CODE***************/
 	if(mnActList == NULL)
@@ -280,10 +717,11 @@ ART_MAPFIELD_POPULARITY* ArtMap::calcWinningNode(ART_MAPFIELDS* mnActList,
 
 	*maxNodeNr  = -1;
 
-	// the "int" in this pair defines the number of ART networks that activate this node positively
-	// the "ART_TYPE" value in this pair denotes the total activation of this node
-	// then in the end we store the popularity for each map field node
+	// the "votes" of a node are the number of ART networks that activate this node positively
+	// the "activation" denotes the total activation of this node
+	// then in the end we store the popularity for each map field node that is activated
 	ART_MAPFIELD_POPULARITY* node_valuePair = new ART_MAPFIELD_POPULARITY(0);
+	ART_MAPFIELD_POPULARITY merged(0);
 
 	for (int networkNr = 0; networkNr < mnActList->size(); ++networkNr)
 	{
@@ -295,42 +733,55 @@ ART_MAPFIELD_POPULARITY* ArtMap::calcWinningNode(ART_MAPFIELDS* mnActList,
 			ART_TYPE winningNodeValue = 0;
 			int 	winningNode = -2;
 
-			// iterate over all map field nodes for this ART network
-			for (int nodeNr = 0; nodeNr < nodes->size(); ++nodeNr)
+			// iterate over the map field nodes this ART network activates, merging them into the
+			// popularity of the networks before it (both are sorted on the node)
+			merged.clear();
+			int next = 0;
+			for (int x = 0; x < (int)nodes->size(); ++x)
 			{
-				// ugly code indeed, basically just adds a pair only at loop networkNr==0
-				while(node_valuePair->size() <= nodeNr)
-					(*node_valuePair).push_back(new ART_MAPFIELD_NODE_POPULARITY(0,0.0));
+				int nodeNr = (*nodes)[x].first;
+				ART_TYPE activity = (*nodes)[x].second;
+				while(next < (int)node_valuePair->size() && (*node_valuePair)[next].mapNode < nodeNr)
+					merged.push_back((*node_valuePair)[next++]);
+				if(next < (int)node_valuePair->size() && (*node_valuePair)[next].mapNode == nodeNr)
+					merged.push_back((*node_valuePair)[next++]);
+				else
+				{
+					ART_MAPFIELD_NODE_POPULARITY node = { nodeNr, 0, 0 };
+					merged.push_back(node);
+				}
 
-				// now retrieve the previously created pair
-				ART_MAPFIELD_NODE_POPULARITY* node_pair = (*node_valuePair)[nodeNr];
+				// now retrieve the pair of this node
+				ART_MAPFIELD_NODE_POPULARITY &node_pair = merged.back();
 
-				// the second field is increased with the activity value of the node
+				// the activation is increased with the activity value of the node
 				// it will contain total aggregated activity for all ART networks for this node in the end
-				node_pair->second += (*nodes)[nodeNr];
+				node_pair.activation += activity;
 
-				// the first field counts the number of strictly positive activity values
+				// the votes count the number of strictly positive activity values
 				// it will contain a number w.r.t. how many ART network positively contributed to this node
-				if((*nodes)[nodeNr] > 0) {
-					node_pair->first += 1;
+				if(activity > 0) {
+					node_pair.votes += 1;
 				}
 
 				// update maximum node "count" number if node_pair is larger
 				// stores node with the most ART networks referencing it
-				if(*maxNodeCount < node_pair->first)
+				if(*maxNodeCount < node_pair.votes)
 				{
 					*maxNodeNr 		= nodeNr;
-					*maxNodeCount 	= node_pair->first;
+					*maxNodeCount 	= node_pair.votes;
 				}
 
 				// update activity of (currently) winning node
 				// stores node with highest activity caused by 1 of the ART networks
-				if(winningNodeValue < (*nodes)[nodeNr])
+				if(winningNodeValue < activity)
 				{
-					winningNodeValue = (*nodes)[nodeNr];
+					winningNodeValue = activity;
 					winningNode = nodeNr;
 				}
 			}
+			merged.insert(merged.end(), node_valuePair->begin() + next, node_valuePair->end());
+			node_valuePair->swap(merged);
 
 			// If a new value has entered but old connections already exist
 			// then add this node to the existing node
@@ -360,14 +811,16 @@ ART_MAPFIELD_POPULARITY* ArtMap::calcWinningNode(ART_MAPFIELDS* mnActList,
 	{
 		// so this only is useful if there is another node with just as many ART networks voting for it
 		// only then the activity of the node is considered
-		pair<int, ART_TYPE>* maxNode_pair = (*node_valuePair)[*maxNodeNr];
-		ART_TYPE maxActivation = maxNode_pair->second;
-		for (int nodeNr = 0; nodeNr < node_valuePair->size(); ++nodeNr)
+		ART_TYPE maxActivation = 0;
+		for (int x = 0; x < (int)node_valuePair->size(); ++x)
+			if((*node_valuePair)[x].mapNode == *maxNodeNr)
+				maxActivation = (*node_valuePair)[x].activation;
+		for (int x = 0; x < (int)node_valuePair->size(); ++x)
 		{
-			pair<int, ART_TYPE>* node_pair = (*node_valuePair)[nodeNr];
-			if(*maxNodeCount == node_pair->first && maxActivation < node_pair->second)
+			const ART_MAPFIELD_NODE_POPULARITY &node_pair = (*node_valuePair)[x];
+			if(*maxNodeCount == node_pair.votes && maxActivation < node_pair.activation)
 			{
-				*maxNodeNr = nodeNr;
+				*maxNodeNr = node_pair.mapNode;
 				// Have to check this!!!
 				//std::cout << "a node was found with the same occurances" << std::endl;
 			}
@@ -435,7 +888,7 @@ ART_MAPFIELD_POPULARITY* ArtMap::calcWinningNode(ART_MAPFIELDS* mnActList,
 bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
 {
 	//cout << "Calc act" << endl;
-	vector<vector<ART_TYPE>*>* mnActList = calcMapNodeActivation(inputVectors);
+	ART_MAPFIELDS* mnActList = calcMapNodeActivation(inputVectors);
 	if(mnActList == NULL)
 		return false;
 	int nrOfMapsNodes = d_nrMapNodes;
@@ -447,9 +900,7 @@ bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
 	ART_TYPE maxNodeCount 	= 0;					// nr of times a winner
 
 	// calculate winning Node and activations
-	vector<pair<int,ART_TYPE>*>* node_values = calcWinningNode(mnActList, &artN_new_nodes, &input_map_nodes, nrSv,  &maxNodeNr, &maxNodeCount);
-	for (int x = 0; x < node_values->size(); ++x)
-		delete (*node_values)[x];
+	ART_MAPFIELD_POPULARITY* node_values = calcWinningNode(mnActList, &artN_new_nodes, &input_map_nodes, nrSv,  &maxNodeNr, &maxNodeCount);
 	delete node_values;
 	delete mnActList;
 
@@ -477,7 +928,7 @@ bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
 		// check if the winning map node has this ART network else connect it
 		bool newInfo = true;
 		for (int netNr = 0; netNr < artN_new_nodes.size(); ++netNr)
-			newInfo *= ((*(d_mapNodes[maxNodeNr])).size() <= artN_new_nodes[netNr]) || ((*(d_mapNodes[maxNodeNr]))[artN_new_nodes[netNr]]->size()==0);
+			newInfo = newInfo && getNrConnections(artN_new_nodes[netNr], maxNodeNr) == 0;
 
 		// No Art network available
 		// connect and update weights
@@ -546,6 +997,7 @@ bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
 				// 		update weights
 				vector<vector<ART_TYPE>*>* newInputVectors = new vector<vector<ART_TYPE>*>(0);
 				vector<ART_TYPE> addtoMapNodeList(0);
+				ArtResult artOut;
 
 				for (int nodeNR = 0; nodeNR < input_map_nodes.size(); ++nodeNR)
 				{
@@ -559,19 +1011,18 @@ bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
 						{
 							// Match track
 							//cout << "Match Track" << endl;
-							vector<ART_TYPE>* artOut = (*d_artNetworks)[nodeNR]->matchTrack(false, true);
+							if(!(*d_artNetworks)[nodeNR]->matchTrack(artOut, true))
+								break;
 							// New class found
-							classId = (*artOut)[0];
-							delete artOut;
+							classId = artOut.getWinner();
 							// Find WTA map node for this class
 							map_node = getMapNodeWTA(nodeNR, classId);
 							// If class is new, add to map node
 							if(map_node == -1)
 							{
-								F2_TO_MAPFIELD* F2 = d_artF2[nodeNR];
 								// If the class index is not known in the F2 network then create it
-								while(F2->size() <= classId)
-									F2->push_back(new F2_TO_MAPFIELD_NODE(0));
+								if(d_artF2[nodeNR].size() <= classId)
+									d_artF2[nodeNR].resize(classId + 1);
 								break;
 							}
 						}
@@ -661,61 +1112,35 @@ bool ArtMap::mapClasses(vector<vector<ART_TYPE>*>* inputVectors)
  * @param classId			in: the index of the F2 node
  * @return					out: the index of a map field node
  */
-int ArtMap::getMapNodeWTA(ART_INDEX artNetworkNr, ART_INDEX classId)
+int ArtMap::getMapNodeWTA(ART_INDEX artNetworkNr, ART_INDEX classId) const
 {
 	if(d_artF2.size() <= artNetworkNr)
 		return -1;
 
-	F2_TO_MAPFIELD* F2 = d_artF2[artNetworkNr];
-	if(F2->size() <= classId)
+	const ConnectionLists &F2 = d_artF2[artNetworkNr];
+	if(F2.size() <= classId)
 		return -1;
 
-	// the f2 nodes are also called "classes"
-	F2_TO_MAPFIELD_NODE* mnl = (*F2)[classId];
-	int maxNodeNr 			= -1;		// winning map node
-	ART_TYPE maxNodeValue 	= -1;		// max value
-
-	// iterate over all map field nodes and get the one with largest activity/weight
-	for (int i = 0; i < mnl->size(); ++i)
-	{
-		F2_NODE_TO_MAPFIELD_NODE* ml = (*mnl)[i];
-		if(maxNodeValue <  ml->second)
-		{
-			maxNodeValue 	= ml->second;
-			maxNodeNr		= ml->first;
-		}
-	}
-	return maxNodeNr;
+	// the f2 nodes are also called "classes", the lists know the map field node with largest weight
+	int best = F2.getBest(classId);
+	return best < 0 ? -1 : F2.begin(classId)[best].first;
 }
 
 /**
  * See getMapNodeWTA, but this time the F2 node will be chosen in the network
  * to which this map node is connected with the highest weight
  */
-int ArtMap::getArtClassWTA(int artNetworkNr, int mapNode)
+int ArtMap::getArtClassWTA(int artNetworkNr, int mapNode) const
 {
-	if(d_mapNodes.size() <= mapNode)
+	if(mapNode < 0 || artNetworkNr < 0 || (int)d_mapNodes.size() <= artNetworkNr)
 		return -1;
 
-	MAPFIELD_TO_F2* artN = d_mapNodes[mapNode];
-	if(artN->size() <= artNetworkNr)
+	const ConnectionLists &artN = d_mapNodes[artNetworkNr];
+	if(artN.size() <= mapNode)
 		return -1;
 
-	MAPFIELD_TO_F2_NODE* acl = (*artN)[artNetworkNr];
-	int maxClassNr			= -1;			// winning class
-	ART_TYPE maxClassValue 	= -1;			// nr of times a winner
-
-	// iterate over all classes
-	for (int i = 0; i < acl->size(); ++i)
-	{
-		MAPFIELD_NODE_TO_F2_NODE* ac = (*acl)[i];
-		if(maxClassValue <  ac->second)
-		{
-			maxClassValue 	= ac->second;
-			maxClassNr		= ac->first;
-		}
-	}
-	return maxClassNr;
+	int best = artN.getBest(mapNode);
+	return best < 0 ? -1 : artN.begin(mapNode)[best].first;
 }
 
 void ArtMap::updateConnections(int winningMapNode, vector<vector<ART_TYPE>*>* inputVectors)
@@ -729,26 +1154,23 @@ void ArtMap::updateConnections(int winningMapNode, vector<vector<ART_TYPE>*>* in
 			// For F2 to Map_Node
 			vector<ART_TYPE> *outputClasses = (*inputVectors)[x];
 			int	classIndex = (*outputClasses)[0];
-			F2_TO_MAPFIELD* F2 = d_artF2[x];
-			F2_TO_MAPFIELD_NODE* mnl = (*F2)[classIndex];
-			// Maybe better to have each map_node a position but
-			// maybe slower when there are a lot of map nodes and only 2 per class
-			for (int i = 0; i < mnl->size(); ++i)
-			{
-				F2_NODE_TO_MAPFIELD_NODE* ml = (*mnl)[i];
-				if(ml->first == winningMapNode)
-					ml->second += d_learningFraction;
-			}
-
-			// For Map_Node to F2
-			MAPFIELD_TO_F2* artNs 	= d_mapNodes[winningMapNode];
-			MAPFIELD_TO_F2_NODE* artCl 	= (*artNs)[x];
-			for (int i = 0; i < artCl->size(); ++i)
+			int categoryPosition = -1, mapNodePosition = -1;
+			if(locateConnection(x, classIndex, winningMapNode, categoryPosition, mapNodePosition))
 			{
-				MAPFIELD_NODE_TO_F2_NODE* artC 	= (*artCl)[i];
-				if(artC->first == classIndex)
-					artC->second += d_learningFraction;
+				ConnectionLists &F2 = d_artF2[x], &artN = d_mapNodes[x];
+				// For F2 to Map_Node, the lists keep track of their strongest connection
+				if(categoryPosition >= 0)
+					F2.setWeight(classIndex, categoryPosition, F2.begin(classIndex)[categoryPosition].second + d_learningFraction);
+				// For Map_Node to F2
+				if(mapNodePosition >= 0)
+					artN.setWeight(winningMapNode, mapNodePosition,
+							artN.begin(winningMapNode)[mapNodePosition].second + d_learningFraction);
 			}
+			// With distributed output the map node can have won through the other classes of the
+			// output, then the winning class is connected to it now
+			else
+				addConnection(x, classIndex, winningMapNode, d_learningFraction, d_learningFraction);
+			notifyChange(x, classIndex, winningMapNode);
 		}
 	}
 }
@@ -756,7 +1178,7 @@ void ArtMap::updateConnections(int winningMapNode, vector<vector<ART_TYPE>*>* in
 /**
  * Get all the supervising networks (recognizable by a network reliability of 1.0)
  */
-ART_NETWORK_INDICES* ArtMap::getSupervisors(ART_VIEW* inputVectors)
+ART_NETWORK_INDICES* ArtMap::getSupervisors(const ART_VIEW* inputVectors) const
 {
 	ART_NETWORK_INDICES* supers = new ART_NETWORK_INDICES(0);
 	for (ART_INDEX x = 0; x < d_artNetworks->size(); ++x)
@@ -786,30 +1208,21 @@ void ArtMap::createNewMapNode(ART_VIEW* inputVectors)
 		vector<ART_TYPE> *outputClasses = (*inputVectors)[x];
 		int	classIndex = (*outputClasses)[0];
 
-		// F2 to Map node
-		F2_NODE_TO_MAPFIELD_NODE* mn = new F2_NODE_TO_MAPFIELD_NODE(d_nrMapNodes, d_learningFraction);
-		F2_TO_MAPFIELD* F2 = d_artF2[x];
-		F2_TO_MAPFIELD_NODE* mnl = (*F2)[classIndex];
-		mnl->push_back(mn);
-
-		// Map node to F2
-		if(d_mapNodes.size() <= d_nrMapNodes)
-			d_mapNodes.push_back(new MAPFIELD_TO_F2(0));
-
-		MAPFIELD_TO_F2* artN = d_mapNodes[d_nrMapNodes];
-		while(artN->size() <= x)
-			artN->push_back(new MAPFIELD_TO_F2_NODE(0));
-
-		MAPFIELD_NODE_TO_F2_NODE* artC = new MAPFIELD_NODE_TO_F2_NODE(classIndex, d_learningFraction);
-		(*artN)[x]->push_back(artC);
+		// F2 to Map node and Map node to F2
+		addConnection(x, classIndex, d_nrMapNodes, d_learningFraction, d_learningFraction);
 	}
 	// increment the counter
 	++d_nrMapNodes;
+	notifyChange(-1, -1, d_nrMapNodes - 1);
+	for (int x = 0; x < (int)inputVectors->size(); ++x)
+		if((*inputVectors)[x] != NULL)
+			notifyChange(x, (*(*inputVectors)[x])[0], d_nrMapNodes - 1);
 }
 
 /**
  * This function adds new incoming/outgoing weights to an existing "map field node" or "class".
- * All connections will be created, so: only WTA.
+ * All connections will be created, so: only WTA. A class that is already connected to the map
+ * field node keeps its connection, updateConnections() strengthens it.
  * @param mapNodeNr		The map field node the weights need to be added at
  * @param inputVectors	A bundle of weights from all F2 to given map field node
  * @result				d_artF2 gets outgoing weights, d_mapNodes gets outgoing weights too
@@ -822,79 +1235,467 @@ void ArtMap::addToMapNode(int mapNodeNr, vector<ART_TYPE>* inputVectors)
 		if((*inputVectors)[x] != -1)
 		{
 			int	classIndex = (*inputVectors)[x];
+			int categoryPosition = -1, mapNodePosition = -1;
+			if(locateConnection(x, classIndex, mapNodeNr, categoryPosition, mapNodePosition))
+				continue;
 
-			// F2 to Map node
-			F2_NODE_TO_MAPFIELD_NODE* mn = new F2_NODE_TO_MAPFIELD_NODE(mapNodeNr, 0);
-			F2_TO_MAPFIELD* F2 = d_artF2[x];
-			F2_TO_MAPFIELD_NODE* mnl = (*F2)[classIndex];
-			mnl->push_back(mn);
-
-			// Map node to F2
-			MAPFIELD_TO_F2* artN = d_mapNodes[mapNodeNr];
-			while(artN->size() <= x)
-				artN->push_back(new MAPFIELD_TO_F2_NODE(0));
-
-			MAPFIELD_NODE_TO_F2_NODE* artC = new MAPFIELD_NODE_TO_F2_NODE(classIndex, 0);
-			(*artN)[x]->push_back(artC);
+			// F2 to Map node and Map node to F2
+			addConnection(x, classIndex, mapNodeNr, 0, 0);
+			notifyChange(x, classIndex, mapNodeNr);
 		}
 	}
 }
 
 /**
- * This function calculates the activation of the map nodes (WTA) for every ART Network
+ * This function calculates the activation of the map nodes for every ART Network, after it made
+ * room in the map field for classes it did not see before.
  */
 ART_MAPFIELDS* ArtMap::calcMapNodeActivation(ART_VIEW* inputVectors)
 {
-	vector<vector<ART_TYPE>*> *mapNodeActList = new vector<vector<ART_TYPE>*>(0);
-	int nrOfInputVectors = 0;
-
 	for (int x = 0; x < d_artNetworks->size(); ++x)
 	{
 		// For all the input vectors that have values
 		if((*inputVectors)[x] != NULL)
 		{
-			++nrOfInputVectors;
 			vector<ART_TYPE> *outputClasses = (*inputVectors)[x];
-			if ((*outputClasses).size() > 1)
-			{
-				cout << "Distributed ART network not supported yet." << endl;
-				return NULL;
-			}
-			int	classIndex = (*outputClasses)[0];
+			int nrClasses = getNrOutputCategories(*outputClasses);
 
 			// Create structure if this is the first time
-			while (d_artF2.size() <= x)
+			reserveNetworks(x + 1);
+
+			ConnectionLists &F2 = d_artF2[x];
+			for (int c = 0; c < nrClasses; ++c)
 			{
-				F2_TO_MAPFIELD* cl = new F2_TO_MAPFIELD(0);
-				d_artF2.push_back(cl);
-			}
+				int	classIndex = getOutputCategory(*outputClasses, c);
 
-			F2_TO_MAPFIELD* F2 = d_artF2[x];
-			// If the class index is not known in the F2 network then create it
-			while(F2->size() <= classIndex)
-				F2->push_back(new F2_TO_MAPFIELD_NODE(0));
+				// If the class index is not known in the F2 network then create it
+				if(F2.size() <= classIndex)
+					F2.resize(classIndex + 1);
+			}
+		}
+	}
+	return mapNodeActivation(inputVectors);
+}
 
-			F2_TO_MAPFIELD_NODE* mnl = (*F2)[classIndex];
+/**
+ * With WTA output a map node gets the weight of its connection to the winning class. With
+ * distributed output every class adds the weight of its connection times its activation, in one
+ * pass over the classes. Only the map nodes the classes are connected to get an activity.
+ */
+ART_MAPFIELDS* ArtMap::mapNodeActivation(const ART_VIEW* inputVectors) const
+{
+	ART_MAPFIELDS *mapNodeActList = new ART_MAPFIELDS(0);
+	int nrOfInputVectors = 0;
 
-			// Calculate how many times a Map node is activated for this ART network x
-			// map_node first has the number of the map_node, and second the weight value
-			// because of WTA 1.0 times the weight is used
-			mapNodeActList->push_back(new vector<ART_TYPE>(d_nrMapNodes));
-			for (int mnNr = 0; mnNr < mnl->size(); ++mnNr)
+	for (int x = 0; x < (int)d_artNetworks->size(); ++x)
+	{
+		// For all the input vectors that have values
+		if((*inputVectors)[x] != NULL)
+		{
+			++nrOfInputVectors;
+			const vector<ART_TYPE> *outputClasses = (*inputVectors)[x];
+			int nrClasses = getNrOutputCategories(*outputClasses);
+
+			mapNodeActList->push_back(new ART_MAPFIELD(0));
+			ART_MAPFIELD *mapNodeAct = (*mapNodeActList)[x];
+			if((int)d_artF2.size() <= x)
+				continue;
+			const ConnectionLists &F2 = d_artF2[x];
+			for (int c = 0; c < nrClasses; ++c)
 			{
-				F2_NODE_TO_MAPFIELD_NODE * mn = (*mnl)[mnNr];
-				(*(*mapNodeActList)[x])[mn->first] = 1.0*(mn->second);
+				int	classIndex = getOutputCategory(*outputClasses, c);
+				if(F2.size() <= classIndex)
+					continue;
+
+				const F2_NODE_TO_MAPFIELD_NODE* mnl = F2.begin(classIndex);
+				int nrConnections = F2.size(classIndex);
+
+				// Calculate how many times a Map node is activated for this ART network x
+				// map_node first has the number of the map_node, and second the weight value
+				// because of WTA 1.0 times the weight is used
+				if(nrClasses == 1)
+				{
+					for (int mnNr = 0; mnNr < nrConnections; ++mnNr)
+						mapNodeAct->push_back(MAPFIELD_CONNECTION(mnl[mnNr].first, 1.0*(mnl[mnNr].second)));
+					continue;
+				}
+				ART_TYPE activation = getOutputActivation(*outputClasses, c);
+				for (int mnNr = 0; mnNr < nrConnections; ++mnNr)
+					mapNodeAct->push_back(MAPFIELD_CONNECTION(mnl[mnNr].first, activation*(mnl[mnNr].second)));
 			}
+			mergeActivity(*mapNodeAct, nrClasses == 1);
 		}
 		else
 			mapNodeActList->push_back(NULL);
 	}
 
 	if(nrOfInputVectors == 0)
+	{
+		delete mapNodeActList;
 		return NULL;
+	}
 	return mapNodeActList;
 }
 
+void ArtMap::onArtPruned(void* context, const Art* art, const std::vector<int> &remap)
+{
+	ArtMap* artMap = (ArtMap*) context;
+	for (int x = 0; x < (int)artMap->d_artNetworks->size(); ++x)
+		if((*artMap->d_artNetworks)[x] == art)
+			artMap->remapArtNetwork(x, remap);
+	if(artMap->d_pruneListener != NULL)
+		artMap->d_pruneListener(artMap->d_pruneContext, art, remap);
+}
+
+void ArtMap::setChangeListener(ARTMAP_CHANGE_LISTENER listener, void* context)
+{
+	d_changeListener	= listener;
+	d_changeContext		= context;
+}
+
+void ArtMap::setPruneListener(ART_PRUNE_LISTENER listener, void* context)
+{
+	d_pruneListener		= listener;
+	d_pruneContext		= context;
+}
+
+int ArtMap::getNrMappedCategories(int networkNr) const
+{
+	if(networkNr < 0 || (int)d_artF2.size() <= networkNr)
+		return 0;
+	return d_artF2[networkNr].size();
+}
+
+void ArtMap::getMapNodes(int networkNr, int category, std::vector<int> &mapNodes) const
+{
+	mapNodes.clear();
+	if(category < 0 || getNrMappedCategories(networkNr) <= category)
+		return;
+	const ConnectionLists &F2 = d_artF2[networkNr];
+	for (const F2_NODE_TO_MAPFIELD_NODE* mn = F2.begin(category); mn != F2.end(category); ++mn)
+		mapNodes.push_back(mn->first);
+}
+
+void ArtMap::getCategories(int networkNr, int mapNode, std::vector<int> &categories) const
+{
+	categories.clear();
+	if(getNrConnections(networkNr, mapNode) == 0)
+		return;
+	const ConnectionLists &artN = d_mapNodes[networkNr];
+	for (const MAPFIELD_NODE_TO_F2_NODE* ac = artN.begin(mapNode); ac != artN.end(mapNode); ++ac)
+		categories.push_back(ac->first);
+}
+
+//! The connections that are not in "categories" end up after those that are
+void ArtMap::orderCategories(int networkNr, int mapNode, const int* categories, int count)
+{
+	int size = getNrConnections(networkNr, mapNode);
+	if(size == 0)
+		return;
+	MAPFIELD_NODE_TO_F2_NODE* acl = d_mapNodes[networkNr].begin(mapNode);
+	int next = 0;
+	for (int x = 0; x < count && next < size; ++x)
+	{
+		// the first one that is left, so a category that is there twice keeps its order
+		int i = next;
+		while(i < size && acl[i].first != categories[x])
+			++i;
+		if(i == size)
+			continue;
+		std::rotate(acl + next, acl + i, acl + i + 1);
+		++next;
+	}
+	d_mapNodes[networkNr].updateBest(mapNode);
+	// backwards, so a connection that is there twice has the position of the first one
+	EdgeIndex &index = d_edgeIndex[networkNr];
+	for (int i = size - 1; i >= 0 && index.size() > 0; --i)
+	{
+		MapFieldEdge* edge = index.find(acl[i].first, mapNode);
+		if(edge != NULL)
+			edge->mapNodePosition = i;
+	}
+}
+
+bool ArtMap::getConnection(int networkNr, int category, int mapNode, ART_TYPE &weight, ART_TYPE &backWeight,
+		int occurrence) const
+{
+	bool connected = false;
+	weight = backWeight = 0;
+	if(occurrence == 0)
+	{
+		int categoryPosition = -1, mapNodePosition = -1;
+		if(!locateConnection(networkNr, category, mapNode, categoryPosition, mapNodePosition))
+			return false;
+		if(categoryPosition >= 0)
+			weight = d_artF2[networkNr].begin(category)[categoryPosition].second;
+		if(mapNodePosition >= 0)
+			backWeight = d_mapNodes[networkNr].begin(mapNode)[mapNodePosition].second;
+		return true;
+	}
+	if(category >= 0 && getNrMappedCategories(networkNr) > category)
+	{
+		const ConnectionLists &F2 = d_artF2[networkNr];
+		int i = findConnection(F2, category, mapNode, occurrence);
+		if(i < F2.size(category))
+		{
+			weight = F2.begin(category)[i].second;
+			connected = true;
+		}
+	}
+	if(getNrConnections(networkNr, mapNode) > 0)
+	{
+		const ConnectionLists &artN = d_mapNodes[networkNr];
+		int i = findConnection(artN, mapNode, category, occurrence);
+		if(i < artN.size(mapNode))
+		{
+			backWeight = artN.begin(mapNode)[i].second;
+			connected = true;
+		}
+	}
+	return connected;
+}
+
+/**
+ * The structures are created on the way like calcMapNodeActivation() and createNewMapNode() do.
+ * A connection that is not there yet is added at the end of both lists. The lists are only
+ * searched for the connections of older versions that are there twice (occurrence > 0).
+ */
+void ArtMap::setConnection(int networkNr, int category, int mapNode, ART_TYPE weight, ART_TYPE backWeight,
+		int occurrence)
+{
+	if(networkNr < 0 || category < 0 || mapNode < 0)
+		return;
+	int i = -1, j = -1;
+	if(occurrence == 0)
+		locateConnection(networkNr, category, mapNode, i, j);
+	bool added = false;
+	reserveNetworks(networkNr + 1);
+	ConnectionLists &F2 = d_artF2[networkNr];
+	if(F2.size() <= category)
+		F2.resize(category + 1);
+	if(occurrence > 0)
+		i = findConnection(F2, category, mapNode, occurrence);
+	if(i >= 0 && i < F2.size(category))
+		F2.setWeight(category, i, weight);
+	else
+	{
+		i = F2.size(category);
+		F2.push_back(category, mapNode, weight);
+		added = true;
+	}
+
+	reserveMapNodes(mapNode + 1);
+	ConnectionLists &artN = d_mapNodes[networkNr];
+	if(artN.size() <= mapNode)
+		artN.resize(mapNode + 1);
+	if(occurrence > 0)
+		j = findConnection(artN, mapNode, category, occurrence);
+	if(j >= 0 && j < artN.size(mapNode))
+		artN.setWeight(mapNode, j, backWeight);
+	else
+	{
+		j = artN.size(mapNode);
+		artN.push_back(mapNode, category, backWeight);
+		added = true;
+	}
+
+	if(added)
+	{
+		// the index has the first occurrence
+		if(occurrence > 0)
+		{
+			i = getPosition(F2, category, mapNode);
+			j = getPosition(artN, mapNode, category);
+		}
+		connectionAdded(networkNr, category, mapNode, i, j);
+	}
+	notifyChange(networkNr, category, mapNode);
+}
+
+//! The map nodes get their lists when they are connected
+void ArtMap::reserveMapNodes(int nrMapNodes)
+{
+	while(d_nrMapNodes < nrMapNodes)
+	{
+		++d_nrMapNodes;
+		notifyChange(-1, -1, d_nrMapNodes - 1);
+	}
+}
+
+void ArtMap::clearMapField()
+{
+	d_artF2.clear();
+	d_mapNodes.clear();
+	d_edgeIndex.clear();
+	d_nrMapNodes = 0;
+	notifyChange(-1, -1, -1);
+}
+
+void ArtMap::reserveNetworks(int nrNetworks)
+{
+	if((int)d_artF2.size() < nrNetworks)
+	{
+		d_artF2.resize(nrNetworks);
+		d_mapNodes.resize(nrNetworks);
+		d_edgeIndex.resize(nrNetworks);
+	}
+}
+
+void ArtMap::addConnection(int networkNr, int category, int mapNode, ART_TYPE weight, ART_TYPE backWeight)
+{
+	reserveNetworks(networkNr + 1);
+	ConnectionLists &F2 = d_artF2[networkNr];
+	if(F2.size() <= category)
+		F2.resize(category + 1);
+
+	ConnectionLists &artN = d_mapNodes[networkNr];
+	if(artN.size() <= mapNode)
+		artN.resize(mapNode + 1);
+	int categoryPosition = F2.size(category), mapNodePosition = artN.size(mapNode);
+	F2.push_back(category, mapNode, weight);
+	artN.push_back(mapNode, category, backWeight);
+	connectionAdded(networkNr, category, mapNode, categoryPosition, mapNodePosition);
+}
+
+/**
+ * Short lists are searched, that is about as fast as a lookup in the index and the index would
+ * take more memory than the connections. A connection that is in a long list in either direction
+ * is always in the index.
+ */
+bool ArtMap::locateConnection(int networkNr, int category, int mapNode, int &categoryPosition,
+		int &mapNodePosition) const
+{
+	categoryPosition = mapNodePosition = -1;
+	if(networkNr < 0 || category < 0 || mapNode < 0 || networkNr >= (int)d_artF2.size())
+		return false;
+	const ConnectionLists &F2 = d_artF2[networkNr], &artN = d_mapNodes[networkNr];
+	int nrCategory = category < F2.size() ? F2.size(category) : 0;
+	if(nrCategory >= INDEXED_LIST_SIZE || getNrConnections(networkNr, mapNode) >= INDEXED_LIST_SIZE)
+	{
+		const MapFieldEdge* edge = d_edgeIndex[networkNr].find(category, mapNode);
+		if(edge == NULL)
+			return false;
+		categoryPosition	= edge->categoryPosition;
+		mapNodePosition		= edge->mapNodePosition;
+		return true;
+	}
+	categoryPosition	= getPosition(F2, category, mapNode);
+	mapNodePosition		= getPosition(artN, mapNode, category);
+	return categoryPosition >= 0 || mapNodePosition >= 0;
+}
+
+void ArtMap::connectionAdded(int networkNr, int category, int mapNode, int categoryPosition, int mapNodePosition)
+{
+	int nrCategory = d_artF2[networkNr].size(category);
+	int nrMapNode = getNrConnections(networkNr, mapNode);
+	if(nrCategory < INDEXED_LIST_SIZE && nrMapNode < INDEXED_LIST_SIZE)
+		return;
+	// a list that just became long has none of its connections in the index yet
+	if(nrCategory == INDEXED_LIST_SIZE)
+		indexList(networkNr, category, false);
+	if(nrMapNode == INDEXED_LIST_SIZE)
+		indexList(networkNr, mapNode, true);
+	EdgeIndex &index = d_edgeIndex[networkNr];
+	MapFieldEdge* edge = index.find(category, mapNode);
+	if(edge == NULL)
+		edge = index.insert(category, mapNode, -1, -1);
+	edge->categoryPosition	= categoryPosition;
+	edge->mapNodePosition	= mapNodePosition;
+}
+
+/**
+ * The position in the other direction is searched if that list is short. If it is long, and the
+ * connection is in it, the connection is in the index already or gets its position when that list
+ * is indexed (see indexConnections()).
+ */
+void ArtMap::indexList(int networkNr, int list, bool byMapNode)
+{
+	const ConnectionLists &F2 = d_artF2[networkNr], &artN = d_mapNodes[networkNr];
+	EdgeIndex &index = d_edgeIndex[networkNr];
+	const ConnectionLists &lists = byMapNode ? artN : F2;
+	const MAPFIELD_CONNECTION* connections = lists.begin(list);
+	for (int i = 0; i < lists.size(list); ++i)
+	{
+		int category = byMapNode ? connections[i].first : list;
+		int mapNode = byMapNode ? list : connections[i].first;
+		MapFieldEdge* edge = index.find(category, mapNode);
+		if(edge == NULL)
+		{
+			int other = -1;
+			if(byMapNode && (category >= F2.size() || F2.size(category) < INDEXED_LIST_SIZE))
+				other = getPosition(F2, category, mapNode);
+			else if(!byMapNode && getNrConnections(networkNr, mapNode) < INDEXED_LIST_SIZE)
+				other = getPosition(artN, mapNode, category);
+			edge = index.insert(category, mapNode, byMapNode ? other : -1, byMapNode ? -1 : other);
+		}
+		// a later occurrence keeps the position of the first one
+		int &position = byMapNode ? edge->mapNodePosition : edge->categoryPosition;
+		if(position < 0)
+			position = i;
+	}
+}
+
+void ArtMap::indexConnections()
+{
+	d_edgeIndex.assign(d_artF2.size(), EdgeIndex());
+	std::vector<std::pair<int, int> > order(0);
+	for (int x = 0; x < (int)d_artF2.size(); ++x)
+	{
+		ConnectionLists &F2 = d_artF2[x], &artN = d_mapNodes[x];
+		for (int c = 0; c < F2.size(); ++c)
+			mergeConnections(F2, c, order);
+		for (int m = 0; m < artN.size(); ++m)
+			mergeConnections(artN, m, order);
+
+		for (int c = 0; c < F2.size(); ++c)
+			if(F2.size(c) >= INDEXED_LIST_SIZE)
+				indexList(x, c, false);
+		for (int m = 0; m < artN.size(); ++m)
+			if(artN.size(m) >= INDEXED_LIST_SIZE)
+				indexList(x, m, true);
+	}
+}
+
+/**
+ * The connections of removed categories are deleted on both sides, the other categories get their
+ * new index. The map field nodes keep their index, also when they lost all their connections to
+ * this network. Pruning is done to save memory, so the lists of the network are packed after.
+ */
+void ArtMap::remapArtNetwork(int artNr, const std::vector<int> &remap)
+{
+	if((int)d_artF2.size() <= artNr)
+		return;
+	int nrRemoved = 0;
+	for (int x = 0; x < (int)remap.size(); ++x)
+		if(remap[x] < 0)
+			++nrRemoved;
+
+	d_artF2[artNr].removeLists(remap);
+	d_artF2[artNr].compact();
+
+	ConnectionLists &artN = d_mapNodes[artNr];
+	for (int m = 0; m < artN.size(); ++m)
+	{
+		MAPFIELD_NODE_TO_F2_NODE* acl = artN.begin(m);
+		int next = 0;
+		for (int i = 0; i < artN.size(m); ++i)
+		{
+			int classId = acl[i].first;
+			if(classId < (int)remap.size())
+				classId = remap[classId];
+			else
+				classId -= nrRemoved;
+			if(classId < 0)
+				continue;
+			acl[next] = acl[i];
+			acl[next++].first = classId;
+		}
+		artN.truncate(m, next);
+	}
+	artN.compact();
+	indexConnections();
+}
+
 void ArtMap::saveArtMap(std::string fileName)
 {
 	ofstream outputFile(fileName.c_str(), ios::out | ios::binary);
@@ -908,49 +1709,27 @@ void ArtMap::saveArtMap(std::string fileName)
 		outputFile.write((char *) &d_nrOfInputClasses, sizeof(int));
 		outputFile.write((char *) &d_useVigilance, sizeof(bool));
 
-		// Write d_artF2
-		int f2Size = d_artF2.size();
-		outputFile.write((char *) &f2Size, sizeof(int));
-		for (int x = 0; x < d_artF2.size(); ++x)
+		// Write d_artF2, then d_mapNodes by map node
+		for (int side = 0; side < 2; ++side)
 		{
-			F2_TO_MAPFIELD *classes = d_artF2[x];
-			int classesSize = classes->size();
-			outputFile.write((char *) &classesSize, sizeof(int));
-			for (int y = 0; y < classes->size(); ++y)
+			const std::vector<ConnectionLists> &connections = side == 0 ? d_artF2 : d_mapNodes;
+			int outerSize = getNrOuter(connections, side == 1);
+			outputFile.write((char *) &outerSize, sizeof(int));
+			for (int x = 0; x < outerSize; ++x)
 			{
-				MAPFIELD_TO_F2_NODE * artClassList = (*classes)[y];
-				int artClassListSize = artClassList->size();
-
-				outputFile.write((char *) &artClassListSize, sizeof(int));
-				for (int z = 0; z < artClassList->size(); ++z)
+				int listsSize = getNrLists(connections, side == 1, x);
+				outputFile.write((char *) &listsSize, sizeof(int));
+				for (int y = 0; y < listsSize; ++y)
 				{
-					MAPFIELD_NODE_TO_F2_NODE * artClass = (*artClassList)[z];
-					outputFile.write((char *) &artClass->first, sizeof(int));
-					outputFile.write((char *) &artClass->second, sizeof(ART_TYPE));
-				}
-			}
-		}
-
-		// Write d_mapNodes
-		int size = d_mapNodes.size();
-		outputFile.write((char *) &size, sizeof(int));
-		for (int x = 0; x < d_mapNodes.size(); ++x)
-		{
-			MAPFIELD_TO_F2 * artNetworks = d_mapNodes[x];
-			size = artNetworks->size();
-			outputFile.write((char *) &size, sizeof(int));
-			for (int y = 0; y < artNetworks->size(); ++y)
-			{
-				MAPFIELD_TO_F2_NODE * artClassList = (*artNetworks)[y];
-				size =  artClassList->size();
-				outputFile.write((char *) &size, sizeof(int));
-				for (int z = 0; z < artClassList->size(); ++z)
-				{
-					MAPFIELD_NODE_TO_F2_NODE * artClass = (*artClassList)[z];
-					outputFile.write((char *) &artClass->first, sizeof(int));
-					outputFile.write((char *) &artClass->second, sizeof(ART_TYPE));
+					int size = 0;
+					const MAPFIELD_CONNECTION* list = getList(connections, side == 1, x, y, size);
+					outputFile.write((char *) &size, sizeof(int));
+					for (int z = 0; z < size; ++z)
+					{
+						outputFile.write((char *) &list[z].first, sizeof(int));
+						outputFile.write((char *) &list[z].second, sizeof(ART_TYPE));
+					}
 				}
-
 			}
 		}
 		outputFile.close();
@@ -971,92 +1750,184 @@ void ArtMap::loadArtMap(std::string fileName)
 		inputFile.read((char *) &d_nrOfInputClasses, sizeof(int));
 		inputFile.read((char *) &d_useVigilance, sizeof(bool));
 
-		// load d_artF2
-		int f2Size = d_artF2.size();
-		inputFile.read((char *) &f2Size, sizeof(int));
-		for (int x = 0; x < f2Size; ++x)
-		{
-			F2_TO_MAPFIELD *classes = new F2_TO_MAPFIELD(0);
-			d_artF2.push_back(classes);
-			int classesSize = classes->size();
-			inputFile.read((char *) &classesSize, sizeof(int));
-			for (int y = 0; y < classesSize; ++y)
-			{
-				MAPFIELD_TO_F2_NODE * artClassList =  new MAPFIELD_TO_F2_NODE(0);
-				classes->push_back(artClassList);
-				int artClassListSize = artClassList->size();
-				inputFile.read((char *) &artClassListSize, sizeof(int));
-				for (int z = 0; z < artClassListSize; ++z)
-				{
-					int first = 0;
-					ART_TYPE second = 0;
-					inputFile.read((char *) &first, sizeof(int));
-					inputFile.read((char *) &second, sizeof(ART_TYPE));
-					MAPFIELD_NODE_TO_F2_NODE * artClass = new MAPFIELD_NODE_TO_F2_NODE(first, second);
-					artClassList->push_back(artClass);
-				}
-			}
-		}
-
-		// load d_mapNodes
-		int mapNodeSize = d_mapNodes.size();
-		inputFile.read((char *) &mapNodeSize, sizeof(int));
-		for (int x = 0; x < mapNodeSize; ++x)
+		// load d_artF2, then d_mapNodes by map node
+		d_artF2.clear();
+		d_mapNodes.clear();
+		std::vector<MAPFIELD_CONNECTION> connections(0);
+		for (int side = 0; side < 2; ++side)
 		{
-			MAPFIELD_TO_F2 * artNetworks =  new MAPFIELD_TO_F2(0);
-			int artNetworkSize = artNetworks->size();
-			d_mapNodes.push_back(artNetworks);
-			inputFile.read((char *) &artNetworkSize, sizeof(int));
-			for (int y = 0; y < artNetworkSize; ++y)
+			std::vector<ConnectionLists> &lists = side == 0 ? d_artF2 : d_mapNodes;
+			int outerSize = 0;
+			inputFile.read((char *) &outerSize, sizeof(int));
+			if(side == 0)
+				lists.resize(outerSize);
+			for (int x = 0; x < outerSize; ++x)
 			{
-				MAPFIELD_TO_F2_NODE * artClassList = new MAPFIELD_TO_F2_NODE(0);
-				int artClassListSize =  artClassList->size();
-				artNetworks->push_back(artClassList);
-				inputFile.read((char *) &artClassListSize, sizeof(int));
-				for (int z = 0; z < artClassListSize; ++z)
+				int listsSize = 0;
+				inputFile.read((char *) &listsSize, sizeof(int));
+				for (int y = 0; y < listsSize; ++y)
 				{
-					int first = 0;
-					ART_TYPE second = 0;
-					inputFile.read((char *) &first, sizeof(int));
-					inputFile.read((char *) &second, sizeof(ART_TYPE));
-					MAPFIELD_NODE_TO_F2_NODE * artClass = new MAPFIELD_NODE_TO_F2_NODE(first, second);
-					artClassList->push_back(artClass);
+					int listSize = 0;
+					inputFile.read((char *) &listSize, sizeof(int));
+					connections.clear();
+					for (int z = 0; z < listSize; ++z)
+					{
+						int first = 0;
+						ART_TYPE second = 0;
+						inputFile.read((char *) &first, sizeof(int));
+						inputFile.read((char *) &second, sizeof(ART_TYPE));
+						connections.push_back(MAPFIELD_CONNECTION(first, second));
+					}
+					setList(lists, side == 1, x, y, connections.empty() ? NULL : &connections[0], connections.size());
 				}
 			}
 		}
+		finishConnections(d_artF2, d_mapNodes);
+		indexConnections();
 		inputFile.close();
 	}
 }
 
+bool ArtMap::saveArtMapImage(std::string fileName) const
+{
+	ArtMapImageParameters parameters;
+	parameters.learningFraction	= d_learningFraction;
+	parameters.vigilance		= d_vigilance;
+	parameters.nrMapNodes		= d_nrMapNodes;
+	parameters.nrOfInputClasses	= d_nrOfInputClasses;
+	parameters.useVigilance		= d_useVigilance;
+
+	std::vector<int> F2Lists, F2Edges, F2Ids, nodeLists, nodeEdges, nodeIds;
+	std::vector<ART_TYPE> F2Weights, nodeWeights;
+	flattenConnections(d_artF2, false, F2Lists, F2Edges, F2Ids, F2Weights);
+	flattenConnections(d_mapNodes, true, nodeLists, nodeEdges, nodeIds, nodeWeights);
+
+	ModelImageWriter image(MODEL_IMAGE_ARTMAP);
+	image.addSection(SECTION_ARTMAP_PARAMETERS, &parameters, sizeof(parameters));
+	image.addArray(SECTION_ARTMAP_F2_LISTS, F2Lists);
+	image.addArray(SECTION_ARTMAP_F2_EDGES, F2Edges);
+	image.addArray(SECTION_ARTMAP_F2_IDS, F2Ids);
+	image.addArray(SECTION_ARTMAP_F2_WEIGHTS, F2Weights);
+	image.addArray(SECTION_ARTMAP_NODE_LISTS, nodeLists);
+	image.addArray(SECTION_ARTMAP_NODE_EDGES, nodeEdges);
+	image.addArray(SECTION_ARTMAP_NODE_IDS, nodeIds);
+	image.addArray(SECTION_ARTMAP_NODE_WEIGHTS, nodeWeights);
+	return image.write(fileName);
+}
+
+/**
+ * Every list is set at its final size at once, the connections are read from the mapped arrays and
+ * not from the file.
+ */
+bool ArtMap::loadArtMapImage(std::string fileName)
+{
+	ModelImage image;
+	if(!image.open(fileName, MODEL_IMAGE_ARTMAP))
+		return false;
+	size_t bytes = 0;
+	const ArtMapImageParameters* parameters = (const ArtMapImageParameters*) image.getSection(SECTION_ARTMAP_PARAMETERS, bytes);
+	std::vector<ConnectionLists> artF2(0);
+	std::vector<ConnectionLists> mapNodes(0);
+	bool valid = parameters != NULL && bytes >= sizeof(ArtMapImageParameters) && parameters->nrMapNodes >= 0 &&
+			unflattenConnections(image, SECTION_ARTMAP_F2_LISTS, SECTION_ARTMAP_F2_EDGES, SECTION_ARTMAP_F2_IDS,
+					SECTION_ARTMAP_F2_WEIGHTS, artF2, false, parameters->nrMapNodes) &&
+			unflattenConnections(image, SECTION_ARTMAP_NODE_LISTS, SECTION_ARTMAP_NODE_EDGES, SECTION_ARTMAP_NODE_IDS,
+					SECTION_ARTMAP_NODE_WEIGHTS, mapNodes, true, parameters->nrMapNodes);
+	if(!valid)
+	{
+		printf("The model image %s has no valid map field.\n", fileName.c_str());
+		return false;
+	}
+
+	d_learningFraction	= parameters->learningFraction;
+	d_vigilance			= parameters->vigilance;
+	d_nrMapNodes		= parameters->nrMapNodes;
+	d_nrOfInputClasses	= parameters->nrOfInputClasses;
+	d_useVigilance		= parameters->useVigilance != 0;
+	finishConnections(artF2, mapNodes);
+	d_artF2.swap(artF2);
+	d_mapNodes.swap(mapNodes);
+	indexConnections();
+	return true;
+}
+
+bool ArtMap::saveArtMapCompact(std::string fileName, const CompactModelOptions &options) const
+{
+	CompactWriter output;
+	if(!output.open(fileName, MODEL_IMAGE_ARTMAP, options))
+		return false;
+	output.putFloat(d_learningFraction);
+	output.putFloat(d_vigilance);
+	output.putUnsigned(d_nrMapNodes);
+	output.putSigned(d_nrOfInputClasses);
+	output.putByte(d_useVigilance);
+	writeConnections(d_artF2, false, d_learningFraction, output);
+	writeConnections(d_mapNodes, true, d_learningFraction, output);
+	return output.close();
+}
+
+bool ArtMap::loadArtMapCompact(std::string fileName)
+{
+	CompactReader input;
+	if(!input.open(fileName, MODEL_IMAGE_ARTMAP))
+		return false;
+	float learningFraction	= input.getFloat();
+	float vigilance			= input.getFloat();
+	int nrMapNodes			= input.getCount(1 << 30);
+	int nrOfInputClasses	= input.getSigned();
+	bool useVigilance		= input.getByte() != 0;
+	std::vector<ConnectionLists> artF2(0);
+	std::vector<ConnectionLists> mapNodes(0);
+	bool valid = !input.failed() && readConnections(input, learningFraction, artF2, false, nrMapNodes) &&
+			readConnections(input, learningFraction, mapNodes, true, nrMapNodes);
+	if(!valid)
+	{
+		printf("The compact model %s has no valid map field.\n", fileName.c_str());
+		return false;
+	}
+
+	d_learningFraction	= learningFraction;
+	d_vigilance			= vigilance;
+	d_nrMapNodes		= nrMapNodes;
+	d_nrOfInputClasses	= nrOfInputClasses;
+	d_useVigilance		= useVigilance;
+	finishConnections(artF2, mapNodes);
+	d_artF2.swap(artF2);
+	d_mapNodes.swap(mapNodes);
+	indexConnections();
+	return true;
+}
+
 void ArtMap::printArtMap()
 {
 	// Loop through all the mapfield nodes and print the associate class
-	int mapNodeSize = d_mapNodes.size();
+	int mapNodeSize = getNrOuter(d_mapNodes, true);
 	cout << "ARTMAP" << endl;
 	int maxPatternSize = 20;
 	for (int x = 0; x < mapNodeSize; ++x)
 	{
 		cout << "Mapfield: " << x << endl; 														// Mapfield nodeID
-		vector<MAPFIELD_TO_F2_NODE*>* artNetworks = d_mapNodes[x];
-		for (int ARTnetworkId = 0; ARTnetworkId < artNetworks->size(); ++ARTnetworkId)
+		int nrArtNetworks = getNrLists(d_mapNodes, true, x);
+		for (int ARTnetworkId = 0; ARTnetworkId < nrArtNetworks; ++ARTnetworkId)
 		{
-			vector<MAPFIELD_NODE_TO_F2_NODE*>* artClassList = (*artNetworks)[ARTnetworkId];
+			int artClassListSize = 0;
+			const MAPFIELD_NODE_TO_F2_NODE* artClassList = getList(d_mapNodes, true, x, ARTnetworkId, artClassListSize);
 			cout << "	ART: " << ARTnetworkId << endl; 											// ART networkID
-			for (int classID = 0; classID < artClassList->size(); ++classID)
+			for (int classID = 0; classID < artClassListSize; ++classID)
 			{
-				int classId = ((MAPFIELD_NODE_TO_F2_NODE)*(*artClassList)[classID]).first; 			// ART classID
-				ART_TYPE strength = ((MAPFIELD_NODE_TO_F2_NODE)*(*artClassList)[classID]).second;		// Connection strength
+				int classId = artClassList[classID].first; 												// ART classID
+				ART_TYPE strength = artClassList[classID].second;										// Connection strength
 				stringstream value;
 
-				vector<ART_TYPE>* pattern = ((Art*)(*d_artNetworks)[ARTnetworkId])->getF2()->at(classId);
-				for (int patternPos = 0; patternPos < pattern->size()/2; ++patternPos)
+				PrototypeView pattern = ((Art*)(*d_artNetworks)[ARTnetworkId])->getPrototype(classId);
+				for (int patternPos = 0; patternPos < pattern.size()/2; ++patternPos)
 				{
 					if(patternPos != 0)
 						value << ", ";
-					value <<  setprecision(2) << (*pattern)[patternPos];
+					value <<  setprecision(2) << pattern[patternPos];
 				}
-				if(pattern->size() == 1)
-					value << (*pattern)[0];
+				if(pattern.size() == 1)
+					value << pattern[0];
 
 				//if(value.str().length() > maxPatternSize)
 				//	maxPatternSize = value.str().length();
@@ -0,0 +1,155 @@
+/*
+ * artMapPublisher.cpp
+ *
+ * Lock-free publication of ARTMAP snapshots
+ */
+
+#include "artMapPublisher.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+namespace almendeSensorFusion
+{
+
+ArtMapSnapshot::ArtMapSnapshot(const ArtMap &source): d_artNetworks(0),
+		d_artMap(NULL),
+		d_version(0),
+		d_retired(0)
+{
+	d_artMap = new ArtMap(&d_artNetworks);
+	syncFrom(source);
+}
+
+ArtMapSnapshot::~ArtMapSnapshot()
+{
+	delete d_artMap;
+	for (int x = 0; x < (int)d_artNetworks.size(); ++x)
+		delete d_artNetworks[x];
+}
+
+void ArtMapSnapshot::syncFrom(const ArtMap &source)
+{
+	while((int)d_artNetworks.size() < source.getNrArtNetworks())
+		d_artMap->addArtNetwork(new Art(false));
+	for (int x = 0; x < source.getNrArtNetworks(); ++x)
+		d_artNetworks[x]->syncFrom(*source.getArtNetwork(x));
+	d_artMap->syncFrom(source);
+}
+
+ArtMapPublisher::ArtMapPublisher(const ArtMap* artMap, int maxReaders): d_artMap(artMap),
+		d_readers(NULL),
+		d_maxReaders(maxReaders > 0 ? maxReaders : 1),
+		d_latest(NULL),
+		d_epoch(1),
+		d_version(0),
+		d_retired(0),
+		d_spare(0)
+{
+	void* block = NULL;
+	if(posix_memalign(&block, sizeof(ReaderSlot), d_maxReaders * sizeof(ReaderSlot)) != 0)
+		throw std::bad_alloc();
+	memset(block, 0, d_maxReaders * sizeof(ReaderSlot));
+	d_readers = (ReaderSlot*) block;
+	publish();
+}
+
+ArtMapPublisher::~ArtMapPublisher()
+{
+	delete d_latest;
+	for (int x = 0; x < (int)d_retired.size(); ++x)
+		delete d_retired[x];
+	for (int x = 0; x < (int)d_spare.size(); ++x)
+		delete d_spare[x];
+	free(d_readers);
+}
+
+/**
+ * The new snapshot is stored before the epoch moves on: a reader that announces the new epoch sees
+ * the new snapshot (or a later one), so the old one is retired with the new epoch.
+ */
+unsigned int ArtMapPublisher::publish()
+{
+	reclaim();
+	ArtMapSnapshot* snapshot = NULL;
+	if(d_spare.empty())
+		snapshot = new ArtMapSnapshot(*d_artMap);
+	else
+	{
+		snapshot = d_spare.back();
+		d_spare.pop_back();
+		snapshot->syncFrom(*d_artMap);
+	}
+	snapshot->d_version = d_version + 1;
+
+	ArtMapSnapshot* old = d_latest;
+	__atomic_store_n(&d_latest, snapshot, __ATOMIC_SEQ_CST);
+	unsigned long epoch = __atomic_add_fetch(&d_epoch, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&d_version, snapshot->d_version, __ATOMIC_RELEASE);
+	if(old != NULL)
+	{
+		old->d_retired = epoch;
+		d_retired.push_back(old);
+	}
+	return snapshot->d_version;
+}
+
+/**
+ * A reader that announced an epoch before the one a snapshot was retired with might still use it.
+ * A reader that is between reading the epoch and announcing it is no problem: it reads the latest
+ * snapshot after its announcement, and that is not a retired one.
+ */
+void ArtMapPublisher::reclaim()
+{
+	if(d_retired.empty())
+		return;
+	unsigned long oldest = 0;
+	for (int reader = 0; reader < d_maxReaders; ++reader)
+	{
+		unsigned long epoch = __atomic_load_n(&d_readers[reader].epoch, __ATOMIC_SEQ_CST);
+		if(epoch != 0 && (oldest == 0 || epoch < oldest))
+			oldest = epoch;
+	}
+
+	int nrFree = 0;
+	while(nrFree < (int)d_retired.size() && (oldest == 0 || d_retired[nrFree]->d_retired <= oldest))
+		++nrFree;
+	d_spare.insert(d_spare.end(), d_retired.begin(), d_retired.begin() + nrFree);
+	d_retired.erase(d_retired.begin(), d_retired.begin() + nrFree);
+
+	// the oldest ones have the most to catch up with
+	int nrDelete = (int)d_spare.size() - SPARE_SNAPSHOTS;
+	if(nrDelete <= 0)
+		return;
+	for (int x = 0; x < nrDelete; ++x)
+		delete d_spare[x];
+	d_spare.erase(d_spare.begin(), d_spare.begin() + nrDelete);
+}
+
+int ArtMapPublisher::addReader()
+{
+	for (int reader = 0; reader < d_maxReaders; ++reader)
+		if(__sync_bool_compare_and_swap(&d_readers[reader].used, 0, 1))
+			return reader;
+	return -1;
+}
+
+void ArtMapPublisher::removeReader(int reader)
+{
+	release(reader);
+	__atomic_store_n(&d_readers[reader].used, 0, __ATOMIC_SEQ_CST);
+}
+
+const ArtMapSnapshot* ArtMapPublisher::acquire(int reader)
+{
+	__atomic_store_n(&d_readers[reader].epoch, __atomic_load_n(&d_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&d_latest, __ATOMIC_SEQ_CST);
+}
+
+void ArtMapPublisher::release(int reader)
+{
+	__atomic_store_n(&d_readers[reader].epoch, 0, __ATOMIC_SEQ_CST);
+}
+
+}
@@ -0,0 +1,365 @@
+/*
+ * compactModel.cpp
+ *
+ * Writing and reading the byte stream of compact models
+ */
+
+#include "compactModel.h"
+
+#include <string.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace almendeSensorFusion
+{
+
+static const char COMPACT_MAGIC[8] = { 'A', 'R', 'T', 'P', 'A', 'C', 'K', 0 };
+
+CompactWriter::CompactWriter(): d_file(NULL),
+		d_weightBits(0),
+		d_compression(COMPACT_NONE),
+		d_buffer(0),
+		d_compressed(0),
+		d_used(0),
+		d_stream(NULL),
+		d_failed(false)
+{
+}
+
+CompactWriter::~CompactWriter()
+{
+	if(d_file != NULL)
+		close();
+}
+
+bool CompactWriter::open(const std::string &fileName, MODEL_IMAGE_KIND kind, const CompactModelOptions &options)
+{
+	if(d_file != NULL)
+		close();
+	d_file = fopen(fileName.c_str(), "wb");
+	if(d_file == NULL)
+	{
+		printf("Cannot open compact model output file %s.\n", fileName.c_str());
+		return false;
+	}
+	d_fileName		= fileName;
+	d_weightBits	= options.weightBits < 2 ? 0 : (options.weightBits > 16 ? 16 : options.weightBits);
+	d_compression	= COMPACT_NONE;
+	d_buffer.resize(BUFFER_SIZE);
+	d_used			= 0;
+	d_failed		= false;
+#ifdef USE_ZLIB
+	if(options.compress)
+	{
+		z_stream* stream = new z_stream;
+		memset(stream, 0, sizeof(z_stream));
+		if(deflateInit(stream, Z_BEST_COMPRESSION) == Z_OK)
+		{
+			d_stream		= stream;
+			d_compression	= COMPACT_ZLIB;
+			d_compressed.resize(BUFFER_SIZE);
+		}
+		else
+			delete stream;
+	}
+#endif
+
+	CompactModelHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COMPACT_MAGIC, sizeof(header.magic));
+	header.version		= VERSION;
+	header.kind			= kind;
+	header.weightBits	= d_weightBits;
+	header.compression	= d_compression;
+	if(fwrite(&header, sizeof(header), 1, d_file) != 1)
+		d_failed = true;
+	return true;
+}
+
+/**
+ * Without a compressor the buffer goes to the file as it is, with one it is compressed into a
+ * second buffer that is written whenever it is full.
+ */
+void CompactWriter::flush(bool finish)
+{
+	if(d_compression == COMPACT_NONE)
+	{
+		if(d_used > 0 && fwrite(&d_buffer[0], 1, d_used, d_file) != d_used)
+			d_failed = true;
+		d_used = 0;
+		return;
+	}
+#ifdef USE_ZLIB
+	z_stream* stream = (z_stream*) d_stream;
+	stream->next_in		= &d_buffer[0];
+	stream->avail_in	= d_used;
+	int status = Z_OK;
+	do
+	{
+		stream->next_out	= &d_compressed[0];
+		stream->avail_out	= d_compressed.size();
+		status = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+		size_t bytes = d_compressed.size() - stream->avail_out;
+		if(status == Z_STREAM_ERROR || (bytes > 0 && fwrite(&d_compressed[0], 1, bytes, d_file) != bytes))
+		{
+			d_failed = true;
+			break;
+		}
+	} while(stream->avail_out == 0 || (finish && status != Z_STREAM_END));
+	d_used = 0;
+#endif
+}
+
+bool CompactWriter::close()
+{
+	if(d_file == NULL)
+		return false;
+	flush(true);
+#ifdef USE_ZLIB
+	if(d_stream != NULL)
+	{
+		deflateEnd((z_stream*) d_stream);
+		delete (z_stream*) d_stream;
+	}
+#endif
+	d_stream = NULL;
+	if(fclose(d_file) != 0)
+		d_failed = true;
+	d_file = NULL;
+	if(d_failed)
+		printf("Cannot write compact model %s.\n", d_fileName.c_str());
+	return !d_failed;
+}
+
+void CompactWriter::putBytes(const void* data, size_t bytes)
+{
+	const uint8_t* next = (const uint8_t*) data;
+	while(bytes > 0)
+	{
+		if(d_used == BUFFER_SIZE)
+			flush(false);
+		size_t part = BUFFER_SIZE - d_used;
+		if(part > bytes)
+			part = bytes;
+		memcpy(&d_buffer[d_used], next, part);
+		d_used += part;
+		next += part;
+		bytes -= part;
+	}
+}
+
+void CompactWriter::putUnsigned(uint64_t value)
+{
+	while(value >= 0x80)
+	{
+		putByte((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	putByte((uint8_t)value);
+}
+
+void CompactWriter::putFloat(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int x = 0; x < 4; ++x)
+		putByte((uint8_t)(bits >> (8 * x)));
+}
+
+void CompactWriter::putFloats(const std::vector<float> &values)
+{
+	putUnsigned(values.size());
+	for (int x = 0; x < (int)values.size(); ++x)
+		putFloat(values[x]);
+}
+
+CompactReader::CompactReader(): d_file(NULL),
+		d_weightBits(0),
+		d_compression(COMPACT_NONE),
+		d_buffer(0),
+		d_compressed(0),
+		d_next(0),
+		d_used(0),
+		d_stream(NULL),
+		d_failed(false)
+{
+}
+
+CompactReader::~CompactReader()
+{
+	close();
+}
+
+void CompactReader::close()
+{
+#ifdef USE_ZLIB
+	if(d_stream != NULL)
+	{
+		inflateEnd((z_stream*) d_stream);
+		delete (z_stream*) d_stream;
+	}
+#endif
+	d_stream = NULL;
+	if(d_file != NULL)
+		fclose(d_file);
+	d_file = NULL;
+}
+
+bool CompactReader::open(const std::string &fileName, MODEL_IMAGE_KIND kind)
+{
+	close();
+	d_file = fopen(fileName.c_str(), "rb");
+	if(d_file == NULL)
+	{
+		printf("Cannot open compact model %s.\n", fileName.c_str());
+		return false;
+	}
+	CompactModelHeader header;
+	const char* problem = NULL;
+	if(fread(&header, sizeof(header), 1, d_file) != 1 || memcmp(header.magic, COMPACT_MAGIC, sizeof(COMPACT_MAGIC)) != 0)
+		problem = "is not a compact model";
+	else if(header.version > CompactWriter::VERSION)
+		problem = "has a newer version";
+	else if(header.kind != kind)
+		problem = "holds another kind of network";
+	else if(header.weightBits == 1 || header.weightBits > 16)
+		problem = "has weights this version cannot read";
+	else if(header.compression != COMPACT_NONE && header.compression != COMPACT_ZLIB)
+		problem = "is compressed in a way this version does not know";
+#ifndef USE_ZLIB
+	else if(header.compression == COMPACT_ZLIB)
+		problem = "is compressed, and this is built without USE_ZLIB";
+#endif
+	if(problem != NULL)
+	{
+		printf("Compact model %s %s.\n", fileName.c_str(), problem);
+		close();
+		return false;
+	}
+	d_weightBits	= header.weightBits;
+	d_compression	= (COMPACT_COMPRESSION) header.compression;
+	d_buffer.resize(CompactWriter::BUFFER_SIZE);
+	d_next			= 0;
+	d_used			= 0;
+	d_failed		= false;
+#ifdef USE_ZLIB
+	if(d_compression == COMPACT_ZLIB)
+	{
+		z_stream* stream = new z_stream;
+		memset(stream, 0, sizeof(z_stream));
+		if(inflateInit(stream) != Z_OK)
+		{
+			delete stream;
+			printf("Cannot decompress compact model %s.\n", fileName.c_str());
+			close();
+			return false;
+		}
+		d_stream = stream;
+		d_compressed.resize(CompactWriter::BUFFER_SIZE);
+	}
+#endif
+	return true;
+}
+
+bool CompactReader::fill()
+{
+	d_next = d_used = 0;
+	if(d_file == NULL || d_failed)
+	{
+		d_failed = true;
+		return false;
+	}
+	if(d_compression == COMPACT_NONE)
+		d_used = fread(&d_buffer[0], 1, d_buffer.size(), d_file);
+#ifdef USE_ZLIB
+	else
+	{
+		z_stream* stream = (z_stream*) d_stream;
+		stream->next_out	= &d_buffer[0];
+		stream->avail_out	= d_buffer.size();
+		while(stream->avail_out == d_buffer.size())
+		{
+			if(stream->avail_in == 0)
+			{
+				stream->next_in		= &d_compressed[0];
+				stream->avail_in	= fread(&d_compressed[0], 1, d_compressed.size(), d_file);
+				if(stream->avail_in == 0)
+					break;
+			}
+			int status = inflate(stream, Z_NO_FLUSH);
+			if(status == Z_STREAM_END)
+				break;
+			if(status != Z_OK)
+				break;
+		}
+		d_used = d_buffer.size() - stream->avail_out;
+	}
+#endif
+	if(d_used == 0)
+		d_failed = true;
+	return d_used > 0;
+}
+
+bool CompactReader::getBytes(void* data, size_t bytes)
+{
+	uint8_t* next = (uint8_t*) data;
+	while(bytes > 0)
+	{
+		if(d_next == d_used && !fill())
+			return false;
+		size_t part = d_used - d_next;
+		if(part > bytes)
+			part = bytes;
+		memcpy(next, &d_buffer[d_next], part);
+		d_next += part;
+		next += part;
+		bytes -= part;
+	}
+	return true;
+}
+
+uint64_t CompactReader::getUnsigned()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t byte = getByte();
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if((byte & 0x80) == 0)
+			return value;
+	}
+	d_failed = true;
+	return 0;
+}
+
+float CompactReader::getFloat()
+{
+	uint32_t bits = 0;
+	for (int x = 0; x < 4; ++x)
+		bits |= (uint32_t)getByte() << (8 * x);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint64_t CompactReader::getCount(uint64_t limit)
+{
+	uint64_t count = getUnsigned();
+	if(count > limit)
+	{
+		d_failed = true;
+		return 0;
+	}
+	return count;
+}
+
+bool CompactReader::getFloats(std::vector<float> &values)
+{
+	values.resize(getCount(1 << 28));
+	for (int x = 0; x < (int)values.size(); ++x)
+		values[x] = getFloat();
+	return !d_failed;
+}
+
+}
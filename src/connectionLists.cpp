@@ -0,0 +1,213 @@
+/*
+ * connectionLists.cpp
+ *
+ * The lists of connections of one direction of the map field
+ */
+
+#include "connectionLists.h"
+
+#include <algorithm>
+
+namespace almendeSensorFusion
+{
+
+//! Lists are created on several threads (e.g. by the snapshots of ArtMapPublisher)
+static unsigned int newLayout()
+{
+	static unsigned int layouts = 0;
+	return __sync_add_and_fetch(&layouts, 1);
+}
+
+ConnectionLists::ConnectionLists(): d_lists(0),
+		d_connections(0),
+		d_version(0),
+		d_layout(newLayout()),
+		d_syncLayout(0),
+		d_syncVersion(0)
+{
+}
+
+ConnectionLists::ConnectionLists(const ConnectionLists &other): d_lists(other.d_lists),
+		d_connections(other.d_connections),
+		d_version(other.d_version),
+		d_layout(newLayout()),
+		d_syncLayout(other.d_layout),
+		d_syncVersion(other.d_version)
+{
+}
+
+//! A copy has a layout of its own, it is a copy of the layout of other
+ConnectionLists& ConnectionLists::operator=(const ConnectionLists &other)
+{
+	if(this == &other)
+		return *this;
+	d_lists			= other.d_lists;
+	d_connections	= other.d_connections;
+	d_version		= other.d_version;
+	d_layout		= newLayout();
+	d_syncLayout	= other.d_layout;
+	d_syncVersion	= other.d_version;
+	return *this;
+}
+
+//! A list without connections has no place in the array (offset 0, capacity 0)
+void ConnectionLists::resize(int nrLists)
+{
+	List empty;
+	empty.offset	= 0;
+	empty.size		= 0;
+	empty.capacity	= 0;
+	empty.best		= -1;
+	empty.version	= ++d_version;
+	d_lists.resize(nrLists, empty);
+}
+
+void ConnectionLists::clear()
+{
+	d_lists.clear();
+	std::vector<MAPFIELD_CONNECTION>(0).swap(d_connections);
+	d_layout = newLayout();
+}
+
+void ConnectionLists::assign(int list, const MAPFIELD_CONNECTION* connections, int count)
+{
+	if(count > d_lists[list].capacity)
+		makeRoom(list, count);
+	std::copy(connections, connections + count, d_connections.begin() + d_lists[list].offset);
+	d_lists[list].size = count;
+	updateBest(list);
+}
+
+void ConnectionLists::truncate(int list, int size)
+{
+	if(size < d_lists[list].size)
+		d_lists[list].size = size;
+	updateBest(list);
+}
+
+void ConnectionLists::updateBest(int list)
+{
+	List &entry = d_lists[list];
+	entry.best = -1;
+	for (int x = 0; x < entry.size; ++x)
+		raiseBest(entry, x, d_connections[entry.offset + x].second);
+	entry.version = ++d_version;
+}
+
+void ConnectionLists::removeLists(const std::vector<int> &remap)
+{
+	int next = 0;
+	for (int x = 0; x < (int)d_lists.size(); ++x)
+		if(x >= (int)remap.size() || remap[x] >= 0)
+			d_lists[next++] = d_lists[x];
+	d_lists.resize(next);
+	d_layout = newLayout();
+}
+
+size_t ConnectionLists::getNrConnections() const
+{
+	size_t count = 0;
+	for (int x = 0; x < (int)d_lists.size(); ++x)
+		count += d_lists[x].size;
+	return count;
+}
+
+size_t ConnectionLists::getBytes() const
+{
+	return d_lists.capacity() * sizeof(List) + d_connections.capacity() * sizeof(MAPFIELD_CONNECTION);
+}
+
+void ConnectionLists::compact()
+{
+	rebuild(-1, 0, false);
+}
+
+/**
+ * A list is copied into the array of this one like assign() does, so the lists of both keep their
+ * order but not their offsets: moving lists around in source is not a write.
+ */
+void ConnectionLists::syncFrom(const ConnectionLists &source)
+{
+	if(this == &source)
+		return;
+	if(d_syncLayout != source.d_layout || d_lists.size() > source.d_lists.size())
+	{
+		*this = source;
+		return;
+	}
+
+	resize(source.d_lists.size());
+	for (size_t x = 0; x < d_lists.size(); ++x)
+	{
+		const List &entry = source.d_lists[x];
+		if(entry.version <= d_syncVersion)
+			continue;
+		assign(x, source.begin(x), entry.size);
+		d_lists[x].version = entry.version;
+	}
+	d_version		= source.d_version;
+	d_syncVersion	= source.d_version;
+}
+
+/**
+ * The last list grows in place, another one is moved to the end of the array. When the array does
+ * not have the room, all lists are copied into a new one instead (see rebuild()).
+ */
+void ConnectionLists::makeRoom(int list, int capacity)
+{
+	List &entry = d_lists[list];
+	size_t end = d_connections.size();
+	bool last = (size_t)(entry.offset + entry.capacity) == end;
+	size_t grow = last ? capacity - entry.capacity : capacity;
+	if(end + grow > d_connections.capacity())
+	{
+		rebuild(list, capacity, true);
+		return;
+	}
+	d_connections.resize(end + grow);
+	if(!last)
+	{
+		std::copy(d_connections.begin() + entry.offset, d_connections.begin() + entry.offset + entry.size,
+				d_connections.begin() + end);
+		entry.offset = end;
+	}
+	entry.capacity = capacity;
+}
+
+/**
+ * With slack the lists keep their capacity and the new array has a quarter more room than that,
+ * so it is allocated again only after that many connections were added (or lists moved), the copy
+ * then costs a few moves per connection in total. A list that grows a lot (a category connected
+ * to many map field nodes) keeps doubling like a vector, it is not made full again by a rebuild.
+ */
+void ConnectionLists::rebuild(int list, int capacity, bool slack)
+{
+	size_t total = 0;
+	for (int x = 0; x < (int)d_lists.size(); ++x)
+		total += getCapacity(x, list, capacity, slack);
+
+	std::vector<MAPFIELD_CONNECTION> connections(0);
+	connections.reserve(slack ? total + total / 4 + 4 : total);
+	connections.resize(total);
+	size_t next = 0;
+	for (int x = 0; x < (int)d_lists.size(); ++x)
+	{
+		List &entry = d_lists[x];
+		int newCapacity = getCapacity(x, list, capacity, slack);
+		std::copy(d_connections.begin() + entry.offset, d_connections.begin() + entry.offset + entry.size,
+				connections.begin() + next);
+		entry.offset	= newCapacity > 0 ? next : 0;
+		entry.capacity	= newCapacity;
+		next += newCapacity;
+	}
+	d_connections.swap(connections);
+}
+
+int ConnectionLists::getCapacity(int x, int list, int capacity, bool slack) const
+{
+	if(x == list)
+		return std::max(capacity, d_lists[x].size);
+	return slack ? d_lists[x].capacity : d_lists[x].size;
+}
+
+}
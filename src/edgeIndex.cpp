@@ -0,0 +1,143 @@
+/*
+ * edgeIndex.cpp
+ *
+ * The hash table of the connections of a map field
+ */
+
+#include "edgeIndex.h"
+
+#include <algorithm>
+
+namespace almendeSensorFusion
+{
+
+//! Indices are created on several threads (e.g. by the snapshots of ArtMapPublisher)
+static unsigned int newLayout()
+{
+	static unsigned int layouts = 0;
+	return __sync_add_and_fetch(&layouts, 1);
+}
+
+EdgeIndex::EdgeIndex(): d_slots(0),
+		d_size(0),
+		d_version(0),
+		d_blockVersions(0),
+		d_layout(newLayout()),
+		d_syncLayout(0),
+		d_syncVersion(0)
+{
+}
+
+EdgeIndex::EdgeIndex(const EdgeIndex &other): d_slots(other.d_slots),
+		d_size(other.d_size),
+		d_version(other.d_version),
+		d_blockVersions(other.d_blockVersions),
+		d_layout(newLayout()),
+		d_syncLayout(other.d_layout),
+		d_syncVersion(other.d_version)
+{
+}
+
+EdgeIndex& EdgeIndex::operator=(const EdgeIndex &other)
+{
+	if(this == &other)
+		return *this;
+	d_slots			= other.d_slots;
+	d_size			= other.d_size;
+	d_version		= other.d_version;
+	d_blockVersions	= other.d_blockVersions;
+	d_layout		= newLayout();
+	d_syncLayout	= other.d_layout;
+	d_syncVersion	= other.d_version;
+	return *this;
+}
+
+MapFieldEdge* EdgeIndex::find(int category, int mapNode)
+{
+	const MapFieldEdge* edge = static_cast<const EdgeIndex*>(this)->find(category, mapNode);
+	if(edge == NULL)
+		return NULL;
+	written(edge - &d_slots[0]);
+	return const_cast<MapFieldEdge*>(edge);
+}
+
+const MapFieldEdge* EdgeIndex::find(int category, int mapNode) const
+{
+	if(d_size == 0)
+		return NULL;
+	uint64_t key = getKey(category, mapNode);
+	size_t mask = d_slots.size() - 1;
+	for (size_t slot = hash(key) & mask; d_slots[slot].key != FREE_KEY; slot = (slot + 1) & mask)
+		if(d_slots[slot].key == key)
+			return &d_slots[slot];
+	return NULL;
+}
+
+MapFieldEdge* EdgeIndex::insert(int category, int mapNode, int categoryPosition, int mapNodePosition)
+{
+	if(4 * (d_size + 1) > 3 * d_slots.size())
+		grow();
+	uint64_t key = getKey(category, mapNode);
+	size_t mask = d_slots.size() - 1;
+	size_t slot = hash(key) & mask;
+	while(d_slots[slot].key != FREE_KEY)
+		slot = (slot + 1) & mask;
+	MapFieldEdge &edge = d_slots[slot];
+	edge.key				= key;
+	edge.categoryPosition	= categoryPosition;
+	edge.mapNodePosition	= mapNodePosition;
+	++d_size;
+	written(slot);
+	return &edge;
+}
+
+void EdgeIndex::clear()
+{
+	MapFieldEdge free = { FREE_KEY, -1, -1 };
+	d_slots.assign(d_slots.size(), free);
+	d_size = 0;
+	d_layout = newLayout();
+}
+
+void EdgeIndex::syncFrom(const EdgeIndex &source)
+{
+	if(this == &source)
+		return;
+	if(d_syncLayout != source.d_layout || d_slots.size() != source.d_slots.size())
+	{
+		*this = source;
+		return;
+	}
+	for (size_t block = 0; block < d_blockVersions.size(); ++block)
+	{
+		if(source.d_blockVersions[block] <= d_syncVersion)
+			continue;
+		size_t first = block * BLOCK_SIZE, last = std::min(first + BLOCK_SIZE, d_slots.size());
+		std::copy(source.d_slots.begin() + first, source.d_slots.begin() + last, d_slots.begin() + first);
+		d_blockVersions[block] = source.d_blockVersions[block];
+	}
+	d_size			= source.d_size;
+	d_version		= source.d_version;
+	d_syncVersion	= source.d_version;
+}
+
+void EdgeIndex::grow()
+{
+	MapFieldEdge free = { FREE_KEY, -1, -1 };
+	std::vector<MapFieldEdge> slots(d_slots.empty() ? 16 : 2 * d_slots.size(), free);
+	slots.swap(d_slots);
+	size_t mask = d_slots.size() - 1;
+	for (size_t x = 0; x < slots.size(); ++x)
+	{
+		if(slots[x].key == FREE_KEY)
+			continue;
+		size_t slot = hash(slots[x].key) & mask;
+		while(d_slots[slot].key != FREE_KEY)
+			slot = (slot + 1) & mask;
+		d_slots[slot] = slots[x];
+	}
+	d_blockVersions.assign((d_slots.size() + BLOCK_SIZE - 1) / BLOCK_SIZE, ++d_version);
+	d_layout = newLayout();
+}
+
+}
@@ -0,0 +1,325 @@
+/*
+ * hyperboxIndex.cpp
+ *
+ * R-tree over the boxes of complement coded prototypes
+ */
+
+#include "hyperboxIndex.h"
+
+namespace almendeSensorFusion
+{
+
+//! Per feature, how much the box sizes may be off because of rounding in the choice function
+static const ART_TYPE QUERY_MARGIN = 1e-4;
+
+//! Enough for any tree: every node below the root has at least CAPACITY/2 entries
+static const int MAX_STACK = HyperboxIndex::CAPACITY * 64;
+
+HyperboxIndex::HyperboxIndex(): d_nodes(0),
+		d_bounds(0),
+		d_leafOf(0),
+		d_root(-1),
+		d_nrFeatures(0),
+		d_valid(true)
+{
+}
+
+void HyperboxIndex::clear()
+{
+	d_nodes.clear();
+	d_bounds.clear();
+	d_leafOf.clear();
+	d_root			= -1;
+	d_nrFeatures	= 0;
+	d_valid			= true;
+}
+
+void HyperboxIndex::build(const PrototypeMatrix &F2)
+{
+	clear();
+	for (int id = 0; id < F2.size() && d_valid; ++id)
+		insert(F2, id);
+}
+
+int HyperboxIndex::newNode(bool leaf, int parent)
+{
+	Node node;
+	node.parent		= parent;
+	node.count		= 0;
+	node.leaf		= leaf;
+	node.minSize	= 0;
+	d_nodes.push_back(node);
+	d_bounds.resize(d_bounds.size() + 2 * d_nrFeatures);
+	return d_nodes.size() - 1;
+}
+
+ART_TYPE HyperboxIndex::boxSize(const ART_TYPE* w, int M)
+{
+	ART_TYPE size = 0;
+	for (int i = 0; i < M; ++i)
+		size += (1 - w[M + i]) - w[i];
+	return size;
+}
+
+void HyperboxIndex::recompute(const PrototypeMatrix &F2, int node)
+{
+	const int M = d_nrFeatures;
+	Node &n = d_nodes[node];
+	ART_TYPE* lo = lower(node);
+	ART_TYPE* hi = upper(node);
+
+	n.minSize = 0;
+	for (int e = 0; e < n.count; ++e)
+	{
+		ART_TYPE size;
+		if(n.leaf)
+		{
+			const ART_TYPE* w = F2.getRowData(n.entries[e]);
+			for (int i = 0; i < M; ++i)
+			{
+				ART_TYPE u = w[i], v = 1 - w[M + i];
+				if(e == 0 || u < lo[i])
+					lo[i] = u;
+				if(e == 0 || v > hi[i])
+					hi[i] = v;
+			}
+			size = boxSize(w, M);
+		}
+		else
+		{
+			const ART_TYPE* u = lower(n.entries[e]);
+			const ART_TYPE* v = upper(n.entries[e]);
+			for (int i = 0; i < M; ++i)
+			{
+				if(e == 0 || u[i] < lo[i])
+					lo[i] = u[i];
+				if(e == 0 || v[i] > hi[i])
+					hi[i] = v[i];
+			}
+			size = d_nodes[n.entries[e]].minSize;
+		}
+		if(e == 0 || size < n.minSize)
+			n.minSize = size;
+	}
+}
+
+int HyperboxIndex::chooseChild(const PrototypeMatrix &F2, int node, int id) const
+{
+	const int M = d_nrFeatures;
+	const Node &n = d_nodes[node];
+	const ART_TYPE* w = F2.getRowData(id);
+
+	int best = -1;
+	ART_TYPE bestGrowth = 0, bestSize = 0;
+	for (int e = 0; e < n.count; ++e)
+	{
+		int child = n.entries[e];
+		const ART_TYPE* lo = lower(child);
+		const ART_TYPE* hi = upper(child);
+		ART_TYPE growth = 0, size = 0;
+		for (int i = 0; i < M; ++i)
+		{
+			ART_TYPE u = w[i], v = 1 - w[M + i];
+			size += hi[i] - lo[i];
+			if(u < lo[i])
+				growth += lo[i] - u;
+			if(v > hi[i])
+				growth += v - hi[i];
+		}
+		if(best < 0 || growth < bestGrowth || (growth == bestGrowth && size < bestSize))
+		{
+			best		= child;
+			bestGrowth	= growth;
+			bestSize	= size;
+		}
+	}
+	return best;
+}
+
+ART_TYPE HyperboxIndex::centre(const PrototypeMatrix &F2, int node, int entry, int axis) const
+{
+	const Node &n = d_nodes[node];
+	if(n.leaf)
+	{
+		const ART_TYPE* w = F2.getRowData(n.entries[entry]);
+		return w[axis] + (1 - w[d_nrFeatures + axis]);
+	}
+	return lower(n.entries[entry])[axis] + upper(n.entries[entry])[axis];
+}
+
+/**
+ * The entries are sorted on their centre along the axis on which the centres are spread most, the
+ * first half stays and the second half goes to a new node next to it. If that makes the parent
+ * too full, the parent is split as well.
+ */
+void HyperboxIndex::split(const PrototypeMatrix &F2, int node)
+{
+	const int count = d_nodes[node].count;
+
+	int axis = 0;
+	ART_TYPE maxSpread = -1;
+	for (int i = 0; i < d_nrFeatures; ++i)
+	{
+		ART_TYPE lo = centre(F2, node, 0, i), hi = lo;
+		for (int e = 1; e < count; ++e)
+		{
+			ART_TYPE c = centre(F2, node, e, i);
+			if(c < lo) lo = c;
+			if(c > hi) hi = c;
+		}
+		if(hi - lo > maxSpread)
+		{
+			maxSpread = hi - lo;
+			axis = i;
+		}
+	}
+
+	// insertion sort, there are only CAPACITY+1 entries
+	ART_TYPE keys[CAPACITY + 1];
+	for (int e = 0; e < count; ++e)
+		keys[e] = centre(F2, node, e, axis);
+	for (int e = 1; e < count; ++e)
+	{
+		ART_TYPE key = keys[e];
+		int entry = d_nodes[node].entries[e];
+		int f = e - 1;
+		for (; f >= 0 && keys[f] > key; --f)
+		{
+			keys[f + 1] = keys[f];
+			d_nodes[node].entries[f + 1] = d_nodes[node].entries[f];
+		}
+		keys[f + 1] = key;
+		d_nodes[node].entries[f + 1] = entry;
+	}
+
+	// newNode() can move d_nodes, so no references into it before this
+	int sibling = newNode(d_nodes[node].leaf, d_nodes[node].parent);
+	Node &n = d_nodes[node];
+	Node &s = d_nodes[sibling];
+	int keep = count / 2;
+	for (int e = keep; e < count; ++e)
+	{
+		int entry = n.entries[e];
+		s.entries[s.count++] = entry;
+		if(n.leaf)
+			d_leafOf[entry] = sibling;
+		else
+			d_nodes[entry].parent = sibling;
+	}
+	n.count = keep;
+	recompute(F2, node);
+	recompute(F2, sibling);
+
+	int parent = d_nodes[node].parent;
+	if(parent < 0)
+	{
+		d_root = newNode(false, -1);
+		Node &root = d_nodes[d_root];
+		root.entries[root.count++] = node;
+		root.entries[root.count++] = sibling;
+		d_nodes[node].parent = d_root;
+		d_nodes[sibling].parent = d_root;
+		recompute(F2, d_root);
+		return;
+	}
+
+	Node &p = d_nodes[parent];
+	p.entries[p.count++] = sibling;
+	if(p.count > CAPACITY)
+		split(F2, parent);
+	else
+		recompute(F2, parent);
+}
+
+void HyperboxIndex::insert(const PrototypeMatrix &F2, int id)
+{
+	if(!d_valid)
+		return;
+
+	int size = F2.getRowSize(id);
+	if(d_leafOf.empty() && d_nrFeatures == 0 && size > 0 && size % 2 == 0)
+		d_nrFeatures = size / 2;
+	if(size != 2 * d_nrFeatures || id != (int)d_leafOf.size())
+	{
+		// the index only works for prototypes with the same number of features
+		d_valid = false;
+		return;
+	}
+
+	if(d_root < 0)
+		d_root = newNode(true, -1);
+
+	int node = d_root;
+	while(!d_nodes[node].leaf)
+		node = chooseChild(F2, node, id);
+
+	Node &n = d_nodes[node];
+	n.entries[n.count++] = id;
+	d_leafOf.push_back(node);
+	if(n.count > CAPACITY)
+		split(F2, node);
+
+	update(F2, id);
+}
+
+void HyperboxIndex::update(const PrototypeMatrix &F2, int id)
+{
+	if(!d_valid || id >= (int)d_leafOf.size())
+		return;
+	for (int node = d_leafOf[id]; node >= 0; node = d_nodes[node].parent)
+		recompute(F2, node);
+}
+
+void HyperboxIndex::query(const PrototypeMatrix &F2, const ART_TYPE* x, ART_TYPE maxSize, std::vector<int> &ids) const
+{
+	if(!d_valid || d_root < 0)
+		return;
+
+	const int M = d_nrFeatures;
+	const ART_TYPE limit = maxSize + QUERY_MARGIN * (M + 1);
+	int stack[MAX_STACK];
+	int top = 0;
+	stack[top++] = d_root;
+
+	while(top > 0)
+	{
+		const Node &n = d_nodes[stack[--top]];
+		if(n.leaf)
+		{
+			// the exact size of every box grown to include x, each term is positive
+			for (int e = 0; e < n.count; ++e)
+			{
+				const ART_TYPE* w = F2.getRowData(n.entries[e]);
+				ART_TYPE size = 0;
+				for (int i = 0; i < M && size <= limit; ++i)
+				{
+					ART_TYPE u = w[i], v = 1 - w[M + i];
+					size += (x[i] > v ? x[i] : v) - (x[i] < u ? x[i] : u);
+				}
+				if(size <= limit)
+					ids.push_back(n.entries[e]);
+			}
+			continue;
+		}
+
+		for (int e = 0; e < n.count; ++e)
+		{
+			int child = n.entries[e];
+			const ART_TYPE* lo = lower(child);
+			const ART_TYPE* hi = upper(child);
+			// no box below is smaller than minSize, nor closer to x than the bounding box
+			ART_TYPE bound = d_nodes[child].minSize;
+			for (int i = 0; i < M && bound <= limit; ++i)
+			{
+				if(x[i] < lo[i])
+					bound += lo[i] - x[i];
+				else if(x[i] > hi[i])
+					bound += x[i] - hi[i];
+			}
+			if(bound <= limit)
+				stack[top++] = child;
+		}
+	}
+}
+
+}
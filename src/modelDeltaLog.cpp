@@ -0,0 +1,392 @@
+/*
+ * modelDeltaLog.cpp
+ *
+ * Logging the changes of a model and applying them to a copy
+ */
+
+#include "modelDeltaLog.h"
+
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace almendeSensorFusion
+{
+
+static const char DELTA_MAGIC[8] = { 'A', 'R', 'T', 'D', 'E', 'L', 'T', 'A' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+//! More values than any record can have, a count above it means the stream is broken
+static const uint32_t MAX_DELTA_VALUES = 1 << 28;
+
+ModelDeltaLog::ModelDeltaLog(): d_artMap(NULL),
+		d_networks(0),
+		d_version(0),
+		d_baseVersion(0),
+		d_records(0),
+		d_offsets(0)
+{
+}
+
+ModelDeltaLog::~ModelDeltaLog()
+{
+	detach();
+}
+
+void ModelDeltaLog::attach(ArtMap* artMap)
+{
+	detach();
+	d_artMap = artMap;
+	for (int x = 0; x < artMap->getNrArtNetworks(); ++x)
+	{
+		d_networks.push_back(artMap->getArtNetwork(x));
+		d_networks.back()->setChangeListener(&ModelDeltaLog::onArtChanged, this);
+	}
+	// the networks tell the ARTMAP about removed categories, which tells the log after it followed
+	artMap->setChangeListener(&ModelDeltaLog::onArtMapChanged, this);
+	artMap->setPruneListener(&ModelDeltaLog::onArtPruned, this);
+	compact();
+}
+
+void ModelDeltaLog::attach(Art* art)
+{
+	detach();
+	d_networks.push_back(art);
+	art->setChangeListener(&ModelDeltaLog::onArtChanged, this);
+	art->setPruneListener(&ModelDeltaLog::onArtPruned, this);
+	compact();
+}
+
+void ModelDeltaLog::detach()
+{
+	for (int x = 0; x < (int)d_networks.size(); ++x)
+	{
+		d_networks[x]->setChangeListener(NULL, NULL);
+		if(d_artMap == NULL)
+			d_networks[x]->setPruneListener(NULL, NULL);
+	}
+	if(d_artMap != NULL)
+	{
+		d_artMap->setChangeListener(NULL, NULL);
+		d_artMap->setPruneListener(NULL, NULL);
+	}
+	d_artMap = NULL;
+	d_networks.clear();
+}
+
+/**
+ * The checkpoint empties every network and the map field and then sets every category and every
+ * connection, so whatever a peer had, it ends up with the model as it is now.
+ */
+bool ModelDeltaLog::compact()
+{
+	if(d_networks.empty())
+		return false;
+	d_records.clear();
+	d_offsets.clear();
+	d_baseVersion = d_version;
+
+	for (int n = 0; n < (int)d_networks.size(); ++n)
+	{
+		append(DELTA_RESET, n, -1, -1, 0, 0);
+		for (int c = 0; c < d_networks[n]->getF2()->size(); ++c)
+			appendCategory(n, c);
+	}
+	if(d_artMap == NULL)
+		return true;
+
+	appendMapField();
+	return true;
+}
+
+/**
+ * The connections are set category by category, which gives the lists of the categories their
+ * order. The lists of the map nodes get the order they had with an order record.
+ */
+void ModelDeltaLog::appendMapField()
+{
+	append(DELTA_RESET, -1, -1, -1, 0, 0);
+	if(d_artMap->getNrMapNodes() > 0)
+		append(DELTA_MAP_NODES, -1, -1, d_artMap->getNrMapNodes() - 1, 0, 0);
+	std::vector<int> nodes;
+	for (int n = 0; n < (int)d_networks.size(); ++n)
+		for (int c = 0; c < d_artMap->getNrMappedCategories(n); ++c)
+		{
+			d_artMap->getMapNodes(n, c, nodes);
+			for (int i = 0; i < (int)nodes.size(); ++i)
+			{
+				// a map node that is in the list twice has two connections
+				int occurrence = std::count(nodes.begin(), nodes.begin() + i, nodes[i]);
+				ART_TYPE weight = 0, backWeight = 0;
+				d_artMap->getConnection(n, c, nodes[i], weight, backWeight, occurrence);
+				append(DELTA_CONNECTION, n, c, nodes[i], weight, backWeight, NULL, 0, 0, occurrence);
+			}
+		}
+	for (int m = 0; m < d_artMap->getNrMapNodes(); ++m)
+		for (int n = 0; n < (int)d_networks.size(); ++n)
+		{
+			d_artMap->getCategories(n, m, nodes);
+			if(nodes.size() > 1)
+				append(DELTA_ORDER, n, -1, m, 0, 0, &nodes[0], nodes.size(), sizeof(int));
+		}
+}
+
+void ModelDeltaLog::append(MODEL_DELTA_TYPE type, int network, int category, int mapNode, float weight,
+		float backWeight, const void* values, int count, size_t valueSize, int occurrence)
+{
+	ModelDelta delta;
+	memset(&delta, 0, sizeof(delta));
+	delta.version		= ++d_version;
+	delta.type			= type;
+	delta.network		= network;
+	delta.category		= category;
+	delta.mapNode		= mapNode;
+	delta.weight		= weight;
+	delta.backWeight	= backWeight;
+	delta.count			= count;
+	delta.occurrence	= occurrence;
+
+	size_t offset = d_records.size();
+	d_offsets.push_back(offset);
+	d_records.resize(offset + sizeof(delta) + count * valueSize);
+	memcpy(&d_records[offset], &delta, sizeof(delta));
+	if(count > 0)
+		memcpy(&d_records[offset + sizeof(delta)], values, count * valueSize);
+}
+
+void ModelDeltaLog::appendCategory(int network, int category)
+{
+	const PrototypeMatrix* F2 = d_networks[network]->getF2();
+	append(DELTA_CATEGORY, network, category, -1, F2->getNorm(category), 0, F2->getRowData(category),
+			F2->getRowSize(category), sizeof(ART_TYPE));
+}
+
+void ModelDeltaLog::appendConnections(int network, int category, int mapNode)
+{
+	ART_TYPE weight = 0, backWeight = 0;
+	for (int k = 0; d_artMap->getConnection(network, category, mapNode, weight, backWeight, k); ++k)
+		append(DELTA_CONNECTION, network, category, mapNode, weight, backWeight, NULL, 0, 0, k);
+}
+
+int ModelDeltaLog::getNetworkNr(const Art* art) const
+{
+	for (int x = 0; x < (int)d_networks.size(); ++x)
+		if(d_networks[x] == art)
+			return x;
+	return -1;
+}
+
+void ModelDeltaLog::onArtChanged(void* context, const Art* art, int category)
+{
+	ModelDeltaLog* log = (ModelDeltaLog*) context;
+	int network = log->getNetworkNr(art);
+	if(network >= 0)
+		log->appendCategory(network, category);
+}
+
+void ModelDeltaLog::onArtPruned(void* context, const Art* art, const std::vector<int> &remap)
+{
+	ModelDeltaLog* log = (ModelDeltaLog*) context;
+	int network = log->getNetworkNr(art);
+	if(network >= 0)
+		log->append(DELTA_REMOVE, network, -1, -1, 0, 0, remap.empty() ? NULL : &remap[0], remap.size(), sizeof(int));
+}
+
+void ModelDeltaLog::onArtMapChanged(void* context, const ArtMap* artMap, int network, int category, int mapNode)
+{
+	ModelDeltaLog* log = (ModelDeltaLog*) context;
+	if(network >= 0)
+		log->appendConnections(network, category, mapNode);
+	else if(mapNode >= 0)
+		log->append(DELTA_MAP_NODES, -1, -1, mapNode, 0, 0);
+	else
+		log->append(DELTA_RESET, -1, -1, -1, 0, 0);
+}
+
+/**
+ * Every record has the version after that of the record before it, so the first record after a
+ * version is found without a search.
+ */
+bool ModelDeltaLog::writeSince(uint64_t version, std::ostream &output) const
+{
+	size_t first = 0;
+	ModelDeltaHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DELTA_MAGIC, sizeof(header.magic));
+	header.byteOrder	= BYTE_ORDER_MARK;
+	header.typeSize		= sizeof(ART_TYPE);
+	header.fromVersion	= 0;
+	if(version >= d_baseVersion)
+	{
+		if(version > d_version)
+			version = d_version;
+		first = version - d_baseVersion;
+		header.fromVersion = version;
+	}
+	header.toVersion	= d_version;
+	header.nrRecords	= d_offsets.size() - first;
+
+	output.write((const char*) &header, sizeof(header));
+	if(first < d_offsets.size())
+		output.write(&d_records[d_offsets[first]], d_records.size() - d_offsets[first]);
+	return output.good();
+}
+
+bool ModelDeltaLog::save(std::string fileName) const
+{
+	std::ofstream outputFile(fileName.c_str(), std::ios::out | std::ios::binary);
+	if(!outputFile)
+	{
+		printf("Cannot open delta log output file %s.\n", fileName.c_str());
+		return false;
+	}
+	bool written = writeSince(0, outputFile);
+	outputFile.close();
+	if(!written || outputFile.fail())
+	{
+		printf("Cannot write delta log %s.\n", fileName.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ModelDeltaLog::apply(std::istream &input, ArtMap &artMap, uint64_t &version)
+{
+	std::vector<Art*> networks(artMap.getNrArtNetworks());
+	for (int x = 0; x < (int)networks.size(); ++x)
+		networks[x] = artMap.getArtNetwork(x);
+	return apply(input, networks, &artMap, version);
+}
+
+bool ModelDeltaLog::apply(std::istream &input, Art &art, uint64_t &version)
+{
+	std::vector<Art*> networks(1, &art);
+	return apply(input, networks, NULL, version);
+}
+
+bool ModelDeltaLog::replay(std::string fileName, ArtMap &artMap, uint64_t &version)
+{
+	std::ifstream inputFile(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(!inputFile)
+	{
+		printf("Cannot open delta log %s.\n", fileName.c_str());
+		return false;
+	}
+	return apply(inputFile, artMap, version);
+}
+
+bool ModelDeltaLog::replay(std::string fileName, Art &art, uint64_t &version)
+{
+	std::ifstream inputFile(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(!inputFile)
+	{
+		printf("Cannot open delta log %s.\n", fileName.c_str());
+		return false;
+	}
+	return apply(inputFile, art, version);
+}
+
+/**
+ * The records up to the version of the model are read but skipped. Those before a record that
+ * does not fit stay applied, and the version tells up to where.
+ */
+bool ModelDeltaLog::apply(std::istream &input, std::vector<Art*> &networks, ArtMap* artMap, uint64_t &version)
+{
+	ModelDeltaHeader header;
+	if(!input.read((char*) &header, sizeof(header)) || memcmp(header.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0)
+	{
+		printf("The input is not a delta log.\n");
+		return false;
+	}
+	if(header.byteOrder != BYTE_ORDER_MARK || header.typeSize != sizeof(ART_TYPE))
+	{
+		printf("The delta log was written by a host with another byte order or weight type.\n");
+		return false;
+	}
+	if(header.fromVersion > version)
+	{
+		printf("The delta log starts after version %llu, the model has version %llu.\n",
+				(unsigned long long) header.fromVersion, (unsigned long long) version);
+		return false;
+	}
+
+	ModelDelta delta;
+	std::vector<char> values;
+	for (uint64_t r = 0; r < header.nrRecords; ++r)
+	{
+		if(!input.read((char*) &delta, sizeof(delta)) || delta.count > MAX_DELTA_VALUES)
+		{
+			printf("The delta log is truncated after version %llu.\n", (unsigned long long) version);
+			return false;
+		}
+		size_t valueSize = delta.type == DELTA_CATEGORY ? sizeof(ART_TYPE) : sizeof(int);
+		values.resize(delta.count * valueSize);
+		if(delta.count > 0 && !input.read(&values[0], values.size()))
+		{
+			printf("The delta log is truncated after version %llu.\n", (unsigned long long) version);
+			return false;
+		}
+		if(delta.version <= version)
+			continue;
+		if(!applyRecord(delta, values, networks, artMap))
+		{
+			printf("The change of version %llu does not fit the model.\n", (unsigned long long) delta.version);
+			return false;
+		}
+		version = delta.version;
+	}
+	return true;
+}
+
+bool ModelDeltaLog::applyRecord(const ModelDelta &delta, const std::vector<char> &values, std::vector<Art*> &networks,
+		ArtMap* artMap)
+{
+	Art* art = delta.network >= 0 && delta.network < (int)networks.size() ? networks[delta.network] : NULL;
+	switch(delta.type)
+	{
+	case DELTA_CATEGORY:
+		return art != NULL && art->setPrototype(delta.category, values.empty() ? NULL : (const ART_TYPE*) &values[0],
+				delta.count, delta.weight);
+	case DELTA_REMOVE:
+	{
+		if(art == NULL || (int)delta.count != art->getF2()->size())
+			return false;
+		const int* remap = values.empty() ? NULL : (const int*) &values[0];
+		std::vector<bool> remove(delta.count, false);
+		for (uint32_t x = 0; x < delta.count; ++x)
+			remove[x] = remap[x] < 0;
+		art->removeCategories(remove);
+		return true;
+	}
+	case DELTA_CONNECTION:
+		if(artMap == NULL || art == NULL || delta.category < 0 || delta.mapNode < 0)
+			return false;
+		artMap->setConnection(delta.network, delta.category, delta.mapNode, delta.weight, delta.backWeight,
+				delta.occurrence);
+		return true;
+	case DELTA_RESET:
+		if(art != NULL)
+			art->clearCategories();
+		else if(delta.network < 0 && artMap != NULL)
+			artMap->clearMapField();
+		else
+			return false;
+		return true;
+	case DELTA_MAP_NODES:
+		if(artMap == NULL || delta.mapNode < 0)
+			return false;
+		artMap->reserveMapNodes(delta.mapNode + 1);
+		return true;
+	case DELTA_ORDER:
+		if(artMap == NULL || art == NULL)
+			return false;
+		artMap->orderCategories(delta.network, delta.mapNode, values.empty() ? NULL : (const int*) &values[0],
+				delta.count);
+		return true;
+	default:
+		// a kind of change this version does not know
+		return false;
+	}
+}
+
+}
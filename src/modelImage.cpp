@@ -0,0 +1,222 @@
+/*
+ * modelImage.cpp
+ *
+ * Writing and mapping of model images
+ */
+
+#include "modelImage.h"
+#include "artTypes.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace almendeSensorFusion
+{
+
+static const char IMAGE_MAGIC[8] = { 'A', 'R', 'T', 'I', 'M', 'A', 'G', 'E' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+static size_t alignUp(size_t offset, size_t alignment)
+{
+	return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+MappedFile::MappedFile(char* data, size_t size): d_data(data),
+		d_size(size),
+		d_references(1)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	munmap(d_data, d_size);
+}
+
+/**
+ * Mapped private and writable: the network can learn on top of a mapped file without changing it.
+ * The descriptor is not needed anymore once the file is mapped.
+ */
+MappedFile* MappedFile::open(const std::string &fileName)
+{
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		printf("Cannot open model image %s.\n", fileName.c_str());
+		return NULL;
+	}
+	struct stat status;
+	if(fstat(fd, &status) != 0 || status.st_size <= 0)
+	{
+		printf("Cannot map model image %s.\n", fileName.c_str());
+		::close(fd);
+		return NULL;
+	}
+	void* data = mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED)
+	{
+		printf("Cannot map model image %s.\n", fileName.c_str());
+		return NULL;
+	}
+	return new MappedFile((char*) data, status.st_size);
+}
+
+void MappedFile::retain()
+{
+	__sync_add_and_fetch(&d_references, 1);
+}
+
+void MappedFile::release()
+{
+	if(__sync_sub_and_fetch(&d_references, 1) == 0)
+		delete this;
+}
+
+ModelImageWriter::ModelImageWriter(MODEL_IMAGE_KIND kind): d_kind(kind),
+		d_sections(0)
+{
+}
+
+void ModelImageWriter::addSection(int id, const void* data, size_t bytes, size_t alignment)
+{
+	Pending section;
+	section.id			= id;
+	section.data		= data;
+	section.bytes		= data == NULL ? 0 : bytes;
+	section.alignment	= alignment < SECTION_ALIGNMENT ? SECTION_ALIGNMENT : alignment;
+	d_sections.push_back(section);
+}
+
+/**
+ * The offsets are worked out first, so the header and the table are written at once and the file
+ * is written front to back. The gaps are zero.
+ */
+bool ModelImageWriter::write(const std::string &fileName) const
+{
+	ModelImageHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+	header.version		= VERSION;
+	header.kind			= d_kind;
+	header.byteOrder	= BYTE_ORDER_MARK;
+	header.typeSize		= sizeof(ART_TYPE);
+	header.nrSections	= d_sections.size();
+
+	std::vector<ModelImageSection> table(d_sections.size());
+	size_t offset = sizeof(header) + table.size() * sizeof(ModelImageSection);
+	for (int s = 0; s < (int)d_sections.size(); ++s)
+	{
+		memset(&table[s], 0, sizeof(ModelImageSection));
+		offset = alignUp(offset, d_sections[s].alignment);
+		table[s].id		= d_sections[s].id;
+		table[s].offset	= offset;
+		table[s].bytes	= d_sections[s].bytes;
+		offset += d_sections[s].bytes;
+	}
+	header.fileBytes = offset;
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if(file == NULL)
+	{
+		printf("Cannot open model image output file %s.\n", fileName.c_str());
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	if(!table.empty())
+		written = written && fwrite(&table[0], sizeof(ModelImageSection), table.size(), file) == table.size();
+	size_t position = sizeof(header) + table.size() * sizeof(ModelImageSection);
+	static const char zeros[ModelImageWriter::PAGE_ALIGNMENT] = { 0 };
+	for (int s = 0; s < (int)d_sections.size() && written; ++s)
+	{
+		while(position < table[s].offset && written)
+		{
+			size_t gap = table[s].offset - position;
+			if(gap > sizeof(zeros))
+				gap = sizeof(zeros);
+			written = fwrite(zeros, 1, gap, file) == gap;
+			position += gap;
+		}
+		if(table[s].bytes > 0)
+			written = written && fwrite(d_sections[s].data, 1, table[s].bytes, file) == table[s].bytes;
+		position += table[s].bytes;
+	}
+	if(fclose(file) != 0)
+		written = false;
+	if(!written)
+		printf("Cannot write model image %s.\n", fileName.c_str());
+	return written;
+}
+
+ModelImage::ModelImage(): d_file(NULL)
+{
+}
+
+ModelImage::~ModelImage()
+{
+	close();
+}
+
+void ModelImage::close()
+{
+	if(d_file != NULL)
+		d_file->release();
+	d_file = NULL;
+}
+
+bool ModelImage::open(const std::string &fileName, MODEL_IMAGE_KIND kind)
+{
+	close();
+	d_file = MappedFile::open(fileName);
+	if(d_file == NULL)
+		return false;
+
+	const ModelImageHeader* header = (const ModelImageHeader*) d_file->data();
+	const char* problem = NULL;
+	if(d_file->size() < sizeof(ModelImageHeader) || memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+		problem = "is not a model image";
+	else if(header->byteOrder != BYTE_ORDER_MARK || header->typeSize != sizeof(ART_TYPE))
+		problem = "was written by a host with another byte order or weight type";
+	else if(header->version > ModelImageWriter::VERSION)
+		problem = "has a newer version";
+	else if(header->kind != kind)
+		problem = "holds another kind of network";
+	else if(header->fileBytes > d_file->size() ||
+			sizeof(ModelImageHeader) + (size_t)header->nrSections * sizeof(ModelImageSection) > d_file->size())
+		problem = "is truncated";
+	else
+	{
+		const ModelImageSection* table = (const ModelImageSection*) (header + 1);
+		for (uint32_t s = 0; s < header->nrSections && problem == NULL; ++s)
+			if(table[s].offset > d_file->size() || table[s].bytes > d_file->size() - table[s].offset)
+				problem = "is truncated";
+	}
+	if(problem != NULL)
+	{
+		printf("Model image %s %s.\n", fileName.c_str(), problem);
+		close();
+		return false;
+	}
+	return true;
+}
+
+const void* ModelImage::getSection(int id, size_t &bytes) const
+{
+	bytes = 0;
+	if(d_file == NULL)
+		return NULL;
+	const ModelImageHeader* header = (const ModelImageHeader*) d_file->data();
+	const ModelImageSection* table = (const ModelImageSection*) (header + 1);
+	for (uint32_t s = 0; s < header->nrSections; ++s)
+		if(table[s].id == (uint32_t)id)
+		{
+			bytes = table[s].bytes;
+			return d_file->data() + table[s].offset;
+		}
+	return NULL;
+}
+
+}
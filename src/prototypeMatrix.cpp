@@ -0,0 +1,576 @@
+/*
+ * prototypeMatrix.cpp
+ *
+ * Contiguous storage of the F2 prototypes
+ */
+
+#include "prototypeMatrix.h"
+#include "artKernels.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <algorithm>
+
+namespace almendeSensorFusion
+{
+
+//! The most memory readCompact() reserves for the rows a header announces
+static const size_t COMPACT_RESERVED_BYTES = 1 << 26;
+
+PrototypeMatrix::PrototypeMatrix(): d_data(NULL),
+		d_mapping(NULL),
+		d_rows(0),
+		d_capacity(0),
+		d_stride(0),
+		d_maxRowSize(0),
+		d_minRowSize(0),
+		d_rowSizes(0),
+		d_norms(0),
+		d_buckets(0),
+		d_wins(0),
+		d_lastWins(0),
+		d_version(0),
+		d_rowVersions(0),
+		d_layout(newLayout()),
+		d_syncLayout(0),
+		d_syncVersion(0)
+{
+}
+
+PrototypeMatrix::PrototypeMatrix(const PrototypeMatrix &other): d_data(NULL),
+		d_mapping(NULL),
+		d_rows(0),
+		d_capacity(0),
+		d_stride(0),
+		d_maxRowSize(0),
+		d_minRowSize(0),
+		d_rowSizes(0),
+		d_norms(0),
+		d_buckets(0),
+		d_wins(0),
+		d_lastWins(0),
+		d_version(0),
+		d_rowVersions(0),
+		d_layout(newLayout()),
+		d_syncLayout(0),
+		d_syncVersion(0)
+{
+	*this = other;
+}
+
+PrototypeMatrix& PrototypeMatrix::operator=(const PrototypeMatrix &other)
+{
+	if(this == &other)
+		return *this;
+
+	clear();
+	if(other.d_rows > 0)
+	{
+		reallocate(other.d_rows, other.d_stride);
+		memcpy(d_data, other.d_data, (size_t)other.d_rows * other.d_stride * sizeof(ART_TYPE));
+		d_rows = other.d_rows;
+		d_maxRowSize = other.d_maxRowSize;
+		d_minRowSize = other.d_minRowSize;
+		d_rowSizes = other.d_rowSizes;
+		d_norms = other.d_norms;
+		d_buckets = other.d_buckets;
+		d_wins = other.d_wins;
+		d_lastWins = other.d_lastWins;
+		d_rowVersions = other.d_rowVersions;
+	}
+	d_version = other.d_version;
+	d_syncLayout = other.d_layout;
+	d_syncVersion = other.d_version;
+	return *this;
+}
+
+PrototypeMatrix::~PrototypeMatrix()
+{
+	releaseData();
+}
+
+void PrototypeMatrix::releaseData()
+{
+	if(d_mapping != NULL)
+		d_mapping->release();
+	else
+		free(d_data);
+	d_mapping	= NULL;
+	d_data		= NULL;
+}
+
+//! Matrices are created on several threads (e.g. by the snapshots of ArtMapPublisher)
+unsigned int PrototypeMatrix::newLayout()
+{
+	static unsigned int layouts = 0;
+	return __sync_add_and_fetch(&layouts, 1);
+}
+
+/**
+ * Round the row length up to a whole number of cache lines. An empty row still gets one cache line
+ * so that the stride is never zero.
+ */
+int PrototypeMatrix::alignStride(int size)
+{
+	const int perLine = ALIGNMENT / sizeof(ART_TYPE);
+	if(size < 1)
+		size = 1;
+	return ((size + perLine - 1) / perLine) * perLine;
+}
+
+/**
+ * The rows are copied one by one, because the stride can change in the process. The new block is
+ * zeroed first, such that the padding of every row stays zero.
+ */
+void PrototypeMatrix::reallocate(int capacity, int stride)
+{
+	void* block = NULL;
+	size_t bytes = (size_t)capacity * stride * sizeof(ART_TYPE);
+	if(posix_memalign(&block, ALIGNMENT, bytes > 0 ? bytes : ALIGNMENT) != 0)
+		throw std::bad_alloc();
+	memset(block, 0, bytes);
+
+	ART_TYPE* data = (ART_TYPE*) block;
+	if(d_rows > 0 && stride == d_stride)
+		memcpy(data, d_data, (size_t)d_rows * d_stride * sizeof(ART_TYPE));
+	else
+		for (int row = 0; row < d_rows; ++row)
+			memcpy(data + (size_t)row * stride, getRowData(row), d_rowSizes[row] * sizeof(ART_TYPE));
+
+	releaseData();
+	d_data		= data;
+	d_capacity	= capacity;
+	d_stride	= stride;
+}
+
+void PrototypeMatrix::reserve(int rows)
+{
+	if(rows > d_capacity)
+		reallocate(rows, d_stride > 0 ? d_stride : alignStride(0));
+}
+
+/**
+ * Appending normally only copies the weights into the next row and computes their norm. Only when
+ * the matrix is full, or when the prototype is longer than the stride, the whole block is moved.
+ */
+ART_TYPE* PrototypeMatrix::newRow(int size)
+{
+	int stride = d_stride;
+	if(size > stride || stride == 0)
+		stride = alignStride(size);
+
+	if(d_rows == d_capacity || stride != d_stride)
+	{
+		int capacity = d_capacity;
+		if(d_rows == d_capacity)
+			capacity = d_capacity < 16 ? 16 : d_capacity * 2;
+		reallocate(capacity, stride);
+	}
+
+	d_rowSizes.push_back(size);
+	if(size > d_maxRowSize)
+		d_maxRowSize = size;
+	if(d_rows == 0 || size < d_minRowSize)
+		d_minRowSize = size;
+
+	addToBucket(d_rows, size);
+	d_wins.push_back(0);
+	d_lastWins.push_back(0);
+	d_rowVersions.push_back(++d_version);
+	return getRowData(d_rows);
+}
+
+int PrototypeMatrix::appendRow(const ART_TYPE* values, int size)
+{
+	ART_TYPE* row = newRow(size);
+	if(size > 0)
+		memcpy(row, values, size * sizeof(ART_TYPE));
+	d_norms.push_back(getArtKernels().absSum(row, size, 0));
+	return d_rows++;
+}
+
+int PrototypeMatrix::appendComplementRow(const ART_TYPE* values, int size)
+{
+	ART_TYPE* row = newRow(2 * size);
+	for (int x = 0; x < size; ++x)
+	{
+		row[x] = values[x];
+		row[size + x] = 1-values[x];
+	}
+	d_norms.push_back(getArtKernels().absSum(row, 2 * size, 0));
+	return d_rows++;
+}
+
+void PrototypeMatrix::clear()
+{
+	releaseData();
+	d_rows		= 0;
+	d_capacity	= 0;
+	d_stride	= 0;
+	d_maxRowSize = 0;
+	d_minRowSize = 0;
+	d_rowSizes.clear();
+	d_norms.clear();
+	d_buckets.clear();
+	d_wins.clear();
+	d_lastWins.clear();
+	d_rowVersions.clear();
+	d_layout	= newLayout();
+}
+
+void PrototypeMatrix::removeRows(const std::vector<bool> &remove, std::vector<int> &remap)
+{
+	remap.assign(d_rows, -1);
+	int next = 0;
+	for (int row = 0; row < d_rows; ++row)
+	{
+		if(row < (int)remove.size() && remove[row])
+			continue;
+		if(next != row)
+		{
+			// the whole stride, so the padding of the row stays zero
+			memcpy(getRowData(next), getRowData(row), d_stride * sizeof(ART_TYPE));
+			d_rowSizes[next]	= d_rowSizes[row];
+			d_norms[next]		= d_norms[row];
+			d_wins[next]		= d_wins[row];
+			d_lastWins[next]	= d_lastWins[row];
+			d_rowVersions[next]	= d_rowVersions[row];
+		}
+		remap[row] = next++;
+	}
+	if(next == d_rows)
+		return;
+	d_rows = next;
+	d_rowSizes.resize(next);
+	d_norms.resize(next);
+	d_wins.resize(next);
+	d_lastWins.resize(next);
+	d_rowVersions.resize(next);
+	d_layout = newLayout();
+
+	d_maxRowSize = 0;
+	d_minRowSize = 0;
+	for (int row = 0; row < d_rows; ++row)
+	{
+		if(d_rowSizes[row] > d_maxRowSize)
+			d_maxRowSize = d_rowSizes[row];
+		if(row == 0 || d_rowSizes[row] < d_minRowSize)
+			d_minRowSize = d_rowSizes[row];
+	}
+	rebuildBuckets();
+}
+
+/**
+ * The rows of a copy keep their index as long as the layout of the source stays the same, and rows
+ * are only added at the end. Only the stride has to be the same as well, the source moves to a
+ * larger one when a longer row is appended.
+ */
+void PrototypeMatrix::syncFrom(const PrototypeMatrix &source)
+{
+	if(this == &source)
+		return;
+	if(d_syncLayout != source.d_layout || d_stride != source.d_stride || d_rows > source.d_rows)
+	{
+		*this = source;
+		return;
+	}
+
+	for (int row = 0; row < d_rows; ++row)
+	{
+		if(source.d_rowVersions[row] <= d_syncVersion)
+			continue;
+		memcpy(getRowData(row), source.getRowData(row), d_stride * sizeof(ART_TYPE));
+		d_norms[row]		= source.d_norms[row];
+		d_wins[row]			= source.d_wins[row];
+		d_lastWins[row]		= source.d_lastWins[row];
+		d_rowVersions[row]	= source.d_rowVersions[row];
+	}
+	if(source.d_rows > d_capacity)
+		reallocate(source.d_capacity, d_stride);
+	for (int row = d_rows; row < source.d_rows; ++row)
+	{
+		memcpy(getRowData(row), source.getRowData(row), d_stride * sizeof(ART_TYPE));
+		d_rowSizes.push_back(source.d_rowSizes[row]);
+		d_norms.push_back(source.d_norms[row]);
+		d_wins.push_back(source.d_wins[row]);
+		d_lastWins.push_back(source.d_lastWins[row]);
+		d_rowVersions.push_back(source.d_rowVersions[row]);
+		addToBucket(row, source.d_rowSizes[row]);
+	}
+	d_rows			= source.d_rows;
+	d_maxRowSize	= source.d_maxRowSize;
+	d_minRowSize	= source.d_minRowSize;
+	d_version		= source.d_version;
+	d_syncVersion	= source.d_version;
+}
+
+//! The number of rows follows from the row sizes, the stride from the size of the rows
+void PrototypeMatrix::addToImage(ModelImageWriter &image) const
+{
+	image.addArray(SECTION_PROTOTYPE_ROW_SIZES, d_rowSizes);
+	image.addArray(SECTION_PROTOTYPE_NORMS, d_norms);
+	image.addArray(SECTION_PROTOTYPE_WINS, d_wins);
+	image.addArray(SECTION_PROTOTYPE_LAST_WINS, d_lastWins);
+	image.addSection(SECTION_PROTOTYPE_ROWS, d_data, (size_t)d_rows * d_stride * sizeof(ART_TYPE),
+			ModelImageWriter::PAGE_ALIGNMENT);
+}
+
+bool PrototypeMatrix::mapImage(const ModelImage &image)
+{
+	clear();
+	int rows = 0;
+	int nrNorms = 0;
+	size_t bytes = 0;
+	const int* rowSizes = image.getArray<int>(SECTION_PROTOTYPE_ROW_SIZES, rows);
+	const ART_TYPE* norms = image.getArray<ART_TYPE>(SECTION_PROTOTYPE_NORMS, nrNorms);
+	const void* data = image.getSection(SECTION_PROTOTYPE_ROWS, bytes);
+	if(rowSizes == NULL || norms == NULL || data == NULL || nrNorms != rows)
+		return false;
+	if(rows == 0)
+		return true;
+
+	int stride = bytes / ((size_t)rows * sizeof(ART_TYPE));
+	bool valid = stride > 0 && stride % (ALIGNMENT / sizeof(ART_TYPE)) == 0 &&
+			(size_t)rows * stride * sizeof(ART_TYPE) == bytes && ((size_t)data % ALIGNMENT) == 0;
+	for (int row = 0; row < rows && valid; ++row)
+		valid = rowSizes[row] >= 0 && rowSizes[row] <= stride;
+	if(!valid)
+	{
+		printf("The prototype matrix of the model image is not valid.\n");
+		return false;
+	}
+
+	d_mapping = image.getFile();
+	d_mapping->retain();
+	d_data		= (ART_TYPE*) data;
+	d_rows		= rows;
+	d_capacity	= rows;
+	d_stride	= stride;
+	d_rowSizes.assign(rowSizes, rowSizes + rows);
+	d_norms.assign(norms, norms + rows);
+	if(!image.getArray(SECTION_PROTOTYPE_WINS, d_wins) || (int)d_wins.size() != rows)
+		d_wins.assign(rows, 0);
+	if(!image.getArray(SECTION_PROTOTYPE_LAST_WINS, d_lastWins) || (int)d_lastWins.size() != rows)
+		d_lastWins.assign(rows, 0);
+	d_rowVersions.resize(rows);
+	for (int row = 0; row < rows; ++row)
+	{
+		d_rowVersions[row] = ++d_version;
+		if(row == 0 || d_rowSizes[row] > d_maxRowSize)
+			d_maxRowSize = d_rowSizes[row];
+		if(row == 0 || d_rowSizes[row] < d_minRowSize)
+			d_minRowSize = d_rowSizes[row];
+	}
+	rebuildBuckets();
+	return true;
+}
+
+/*
+ * A rounded weight takes the bytes its bits need, except for the upper bound of a complement coded
+ * row: that is written as its distance to the lower bound, which is small and never negative. The
+ * rows are in the order they were made in, the row before says nothing about the next one.
+ */
+static int quantizeWeight(ART_TYPE weight, ART_TYPE low, ART_TYPE scale)
+{
+	return (int)((weight - low) * scale + 0.5f);
+}
+
+void PrototypeMatrix::writeCompact(CompactWriter &output, bool complementCoded) const
+{
+	int bits = output.getWeightBits();
+	output.putUnsigned(d_rows);
+	output.putUnsigned(d_maxRowSize);
+
+	ART_TYPE low = 0, high = 0, scale = 0;
+	if(bits > 0)
+	{
+		for (int row = 0; row < d_rows; ++row)
+		{
+			int size = d_rowSizes[row];
+			const ART_TYPE* weights = getRowData(row);
+			int half = complementCoded && size % 2 == 0 ? size / 2 : size;
+			for (int x = 0; x < size; ++x)
+			{
+				ART_TYPE weight = x < half ? weights[x] : 1 - weights[x];
+				if((row == 0 && x == 0) || weight < low)
+					low = weight;
+				if((row == 0 && x == 0) || weight > high)
+					high = weight;
+			}
+		}
+		output.putFloat(low);
+		output.putFloat(high);
+		if(high > low)
+			scale = ((1 << bits) - 1) / (high - low);
+	}
+
+	int levelBytes = (bits + 7) / 8;
+	std::vector<int> levels(d_maxRowSize, 0);
+	for (int row = 0; row < d_rows; ++row)
+	{
+		int size = d_rowSizes[row];
+		const ART_TYPE* weights = getRowData(row);
+		int half = complementCoded && size % 2 == 0 ? size / 2 : size;
+		bool point = half < size;
+		for (int x = 0; x < half && point; ++x)
+			point = weights[half + x] == (ART_TYPE)(1 - weights[x]);
+		// the norm is only written if summing the weights again would not give exactly the same
+		bool norm = bits == 0 && getArtKernels().absSum(weights, size, 0) != d_norms[row];
+		output.putUnsigned(((uint64_t)size << 2) | (norm << 1) | point);
+
+		if(bits == 0)
+		{
+			for (int x = 0; x < (point ? half : size); ++x)
+				output.putFloat(weights[x]);
+			if(norm)
+				output.putFloat(d_norms[row]);
+		}
+		else
+		{
+			for (int x = 0; x < half; ++x)
+			{
+				levels[x] = quantizeWeight(weights[x], low, scale);
+				for (int b = 0; b < levelBytes; ++b)
+					output.putByte((uint8_t)(levels[x] >> (8 * b)));
+			}
+			for (int x = half; x < size && !point; ++x)
+				output.putSigned(quantizeWeight(1 - weights[x], low, scale) - levels[x - half]);
+		}
+		output.putUnsigned(d_wins[row]);
+		output.putUnsigned(d_lastWins[row]);
+	}
+}
+
+/**
+ * The counts in the header are not trusted with memory: a row is only stored once its weights
+ * were read, and the rows reserved up front take at most COMPACT_RESERVED_BYTES. Beyond that the
+ * matrix grows as for new rows.
+ */
+bool PrototypeMatrix::readCompact(CompactReader &input, bool complementCoded)
+{
+	clear();
+	int bits = input.getWeightBits();
+	int rows = input.getCount(1 << 30);
+	int maxRowSize = input.getCount(1 << 24);
+	ART_TYPE low = 0, step = 0;
+	if(bits > 0)
+	{
+		low = input.getFloat();
+		step = (input.getFloat() - low) / ((1 << bits) - 1);
+	}
+	if(input.failed())
+		return false;
+
+	int levelBytes = (bits + 7) / 8;
+	std::vector<ART_TYPE> values;
+	std::vector<int> levels;
+	for (int row = 0; row < rows && !input.failed(); ++row)
+	{
+		uint64_t code = input.getUnsigned();
+		int size = code >> 2;
+		bool norm = (code & 2) != 0;
+		bool point = (code & 1) != 0;
+		if(size > maxRowSize || (point && (!complementCoded || size % 2 != 0)))
+		{
+			clear();
+			return false;
+		}
+		int half = complementCoded && size % 2 == 0 ? size / 2 : size;
+		values.clear();
+		levels.clear();
+		if(bits == 0)
+		{
+			for (int x = 0; x < (point ? half : size) && !input.failed(); ++x)
+				values.push_back(input.getFloat());
+		}
+		else
+		{
+			for (int x = 0; x < half && !input.failed(); ++x)
+			{
+				int level = 0;
+				for (int b = 0; b < levelBytes; ++b)
+					level |= input.getByte() << (8 * b);
+				levels.push_back(level);
+				values.push_back(low + level * step);
+			}
+			for (int x = half; x < size && !point && !input.failed(); ++x)
+				values.push_back(1 - (low + (levels[x - half] + input.getSigned()) * step));
+		}
+		for (int x = half; x < size && point && !input.failed(); ++x)
+			values.push_back(1 - values[x - half]);
+		if(input.failed())
+			break;
+
+		if(d_capacity == 0)
+		{
+			int stride = alignStride(size);
+			int capacity = COMPACT_RESERVED_BYTES / ((size_t)stride * sizeof(ART_TYPE));
+			reallocate(std::max(1, std::min(rows, capacity)), stride);
+		}
+		ART_TYPE* weights = newRow(size);
+		if(size > 0)
+			memcpy(weights, &values[0], size * sizeof(ART_TYPE));
+		d_norms.push_back(norm ? input.getFloat() : getArtKernels().absSum(weights, size, 0));
+		d_wins[row]		= input.getUnsigned();
+		d_lastWins[row]	= input.getUnsigned();
+		++d_rows;
+	}
+	if(input.failed())
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+void PrototypeMatrix::swap(PrototypeMatrix &other)
+{
+	std::swap(d_data, other.d_data);
+	std::swap(d_mapping, other.d_mapping);
+	std::swap(d_rows, other.d_rows);
+	std::swap(d_capacity, other.d_capacity);
+	std::swap(d_stride, other.d_stride);
+	std::swap(d_maxRowSize, other.d_maxRowSize);
+	std::swap(d_minRowSize, other.d_minRowSize);
+	d_rowSizes.swap(other.d_rowSizes);
+	d_norms.swap(other.d_norms);
+	d_buckets.swap(other.d_buckets);
+	d_wins.swap(other.d_wins);
+	d_lastWins.swap(other.d_lastWins);
+	std::swap(d_version, other.d_version);
+	d_rowVersions.swap(other.d_rowVersions);
+	std::swap(d_layout, other.d_layout);
+	std::swap(d_syncLayout, other.d_syncLayout);
+	std::swap(d_syncVersion, other.d_syncVersion);
+}
+
+//! There are only a few buckets, a new row is appended to the one of its size
+void PrototypeMatrix::addToBucket(int row, int size)
+{
+	int bucket = 0;
+	while(bucket < (int)d_buckets.size() && d_buckets[bucket].size != size)
+		++bucket;
+	if(bucket == (int)d_buckets.size())
+	{
+		d_buckets.push_back(RowBucket());
+		d_buckets.back().size = size;
+	}
+	d_buckets[bucket].rows.push_back(row);
+}
+
+void PrototypeMatrix::rebuildBuckets()
+{
+	d_buckets.clear();
+	for (int row = 0; row < d_rows; ++row)
+		addToBucket(row, d_rowSizes[row]);
+}
+
+size_t PrototypeMatrix::getRowBytes() const
+{
+	// row size, norm, bucket entry and usage
+	return (size_t)d_stride * sizeof(ART_TYPE) + 2 * sizeof(int) + sizeof(ART_TYPE) + 2 * sizeof(unsigned int);
+}
+
+}
@@ -0,0 +1,314 @@
+/*
+ * quantizedArt.cpp
+ *
+ * Classifying with 8 bit or half precision prototypes
+ */
+
+#include "quantizedArt.h"
+
+#include <stdio.h>
+#include <cmath>
+
+using namespace std;
+
+namespace almendeSensorFusion
+{
+
+//! Rows of quantized weights start at a multiple of this many bytes, one NEON / SSE vector
+static const int QUANTIZED_ALIGNMENT = 16;
+
+QuantizedArt::QuantizedArt(const Art &art, ART_QUANTIZATION type, int recheck): d_type(type),
+		d_recheck(recheck > 0 ? recheck : 0),
+		d_valid(true),
+		d_nrFeatures(0),
+		d_rowSize(0),
+		d_stride(0),
+		d_nrCategories(0),
+		d_inputOffset(art.getInputOffset()),
+		d_inputScale(art.getInputScale()),
+		d_offset(0),
+		d_scale(1),
+		d_halfError(0),
+		d_bytes(0),
+		d_halves(0),
+		d_norms(0),
+		d_F2()
+{
+	const PrototypeMatrix &F2 = *art.getF2();
+	d_useInputComplement	= art.getUseInputComplement();
+	d_ACT					= art.getComputationType();
+	d_alpha					= art.getAlpha();
+	d_vigilance				= art.getBaseVigilance();
+
+	d_rowSize = F2.getMaxRowSize();
+	if(F2.getMinRowSize() != d_rowSize || (d_useInputComplement && d_rowSize % 2 != 0))
+	{
+		printf("Cannot quantize an ART network with prototypes of different sizes\n");
+		d_valid = false;
+		d_rowSize = 0;
+		return;
+	}
+	d_nrFeatures	= d_useInputComplement ? d_rowSize/2 : d_rowSize;
+	d_nrCategories	= F2.size();
+
+	ART_TYPE lo = 0, hi = 0;
+	for (int x = 0; x < d_nrCategories; ++x)
+	{
+		const ART_TYPE* w = F2.getRowData(x);
+		for (int i = 0; i < d_rowSize; ++i)
+		{
+			lo = min(lo, w[i]);
+			hi = max(hi, w[i]);
+		}
+	}
+	// One grid for weights and inputs: [0, 1] or the range of the weights if that is larger
+	d_offset	= lo;
+	d_scale		= (max(hi, (ART_TYPE)1) - lo) / 255;
+	// A half has 11 significant bits, so it is off by at most 2^-11 of the largest weight
+	d_halfError	= ldexp(max(fabs(lo), fabs(hi)), -11);
+
+	if(d_type == QUANTIZE_UINT8)
+	{
+		d_stride = ((d_rowSize + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT) * QUANTIZED_ALIGNMENT;
+		d_bytes.assign((size_t)d_nrCategories * d_stride, 0);
+		for (int x = 0; x < d_nrCategories; ++x)
+		{
+			const ART_TYPE* w = F2.getRowData(x);
+			ART_BYTE* q = &d_bytes[(size_t)x * d_stride];
+			for (int i = 0; i < d_rowSize; ++i)
+				q[i] = (ART_BYTE) floor((w[i] - d_offset) / d_scale + 0.5f);
+		}
+	}
+	else
+	{
+		const int perLine = QUANTIZED_ALIGNMENT / sizeof(ART_HALF);
+		d_stride = ((d_rowSize + perLine - 1) / perLine) * perLine;
+		d_halves.assign((size_t)d_nrCategories * d_stride, 0);
+		for (int x = 0; x < d_nrCategories; ++x)
+		{
+			const ART_TYPE* w = F2.getRowData(x);
+			ART_HALF* q = &d_halves[(size_t)x * d_stride];
+			for (int i = 0; i < d_rowSize; ++i)
+				q[i] = floatToHalf(w[i]);
+		}
+	}
+
+	d_norms.resize(d_nrCategories);
+	for (int x = 0; x < d_nrCategories; ++x)
+		d_norms[x] = F2.getNorm(x);
+
+	if(d_recheck > 0)
+		d_F2 = F2;
+}
+
+size_t QuantizedArt::getWeightBytes() const
+{
+	return d_bytes.size() * sizeof(ART_BYTE) + d_halves.size() * sizeof(ART_HALF);
+}
+
+void QuantizedArt::createF1(const ART_TYPE* input, ART_TYPE* F1, ART_BYTE* F1Bytes) const
+{
+	// as Art::createF1()
+	int nrScaled = min(d_nrFeatures, (int)d_inputScale.size());
+	for (int x = 0; x < nrScaled; ++x)
+	{
+		ART_TYPE value = (input[x] - d_inputOffset[x]) * d_inputScale[x];
+		F1[x] = value < 0 ? 0 : (value > 1 ? 1 : value);
+	}
+	for (int x = nrScaled; x < d_nrFeatures; ++x)
+		F1[x] = input[x];
+	if(d_useInputComplement)
+		for (int x = 0; x < d_nrFeatures; ++x)
+			F1[d_nrFeatures + x] = 1-F1[x];
+
+	if(d_type == QUANTIZE_UINT8)
+		for (int x = 0; x < d_rowSize; ++x)
+		{
+			ART_TYPE q = floor((F1[x] - d_offset) / d_scale + 0.5f);
+			F1Bytes[x] = (ART_BYTE) (q < 0 ? 0 : (q > 255 ? 255 : q));
+		}
+}
+
+ART_TYPE QuantizedArt::quantizedDiff(const ArtKernels &kernels, const ART_TYPE* F1, const ART_BYTE* F1Bytes, int x) const
+{
+	ART_TYPE diff;
+	if(d_type == QUANTIZE_UINT8)
+	{
+		const ART_BYTE* w = &d_bytes[(size_t)x * d_stride];
+		// min and distance commute with the grid: min(a, w) = offset + scale * min(qa, qw)
+		if(d_useInputComplement)
+			return d_rowSize * d_offset + d_scale * kernels.minSumU8(F1Bytes, w, d_rowSize);
+		diff = d_scale * kernels.absDiffSumU8(F1Bytes, w, d_rowSize);
+	}
+	else
+	{
+		const ART_HALF* w = &d_halves[(size_t)x * d_stride];
+		if(d_useInputComplement)
+			return kernels.fuzzyMinF16(F1, w, d_rowSize, 0);
+		diff = kernels.absDiffF16(F1, w, d_rowSize, 0);
+	}
+	float inputSize = d_nrFeatures;
+	diff = inputSize/(diff+1.0);
+	return diff;
+}
+
+bool QuantizedArt::activation(ART_TYPE diff, int x, PROTOTYPE_Activation &pa) const
+{
+	float inputSize = d_nrFeatures;
+	ART_TYPE sumWj = d_norms[x];
+	ART_TYPE Tj = 0;
+
+	if(d_ACT == DEFAULT_ARTMAP)
+		Tj = diff + (1 - d_alpha) * (inputSize - sumWj);
+
+	if(d_ACT == FUZZY_ARTMAP)
+		Tj = diff / (d_alpha + sumWj);
+
+	if((d_ACT == DEFAULT_ARTMAP && Tj > d_alpha*inputSize) || d_ACT == FUZZY_ARTMAP || !d_useInputComplement)
+	{
+		pa.id			= x;
+		pa.T			= Tj;
+		pa.resonance	= diff/inputSize;
+		return true;
+	}
+	return false;
+}
+
+int QuantizedArt::classify(const ART_TYPE* input, ART_TYPE* resonance) const
+{
+	int winner = -1;
+	classifyBatch(input, 1, &winner, resonance);
+	return winner;
+}
+
+/**
+ * Without recheck the best resonating node of the quantized scores wins. With recheck the best
+ * "recheck" nodes that come close to the vigilance are kept (within the rounding error of the
+ * quantization), and the float scores of those decide.
+ */
+void QuantizedArt::classifyBatch(const ART_TYPE* inputs, int nrInputs, int* winners, ART_TYPE* resonances) const
+{
+	const ArtKernels &kernels = getArtKernels();
+	ComparePrototype less;
+
+	// The largest error of |A n Wj| / M (or of the resonance without complement coding). Rounding
+	// both to the grid moves a minimum by at most half a step, but a difference by a whole step.
+	ART_TYPE error = d_halfError;
+	if(d_type == QUANTIZE_UINT8)
+		error = d_useInputComplement ? d_scale / 2 : d_scale;
+	error *= d_rowSize;
+	if(d_useInputComplement && d_nrFeatures > 0)
+		error /= d_nrFeatures;
+	ART_TYPE margin = d_recheck > 0 ? error : 0;
+
+	std::vector<ART_TYPE> F1(d_rowSize + 1);
+	std::vector<ART_BYTE> F1Bytes(d_stride + 1, 0);
+	std::vector<PROTOTYPE_Activation> top(d_recheck + 1);
+
+	for (int n = 0; n < nrInputs; ++n)
+	{
+		createF1(inputs + (size_t)n * d_nrFeatures, &F1[0], &F1Bytes[0]);
+
+		PROTOTYPE_Activation best;
+		best.id			= -1;
+		best.T			= 0;
+		best.resonance	= 0;
+		int nrTop = 0;
+
+		for (int x = 0; x < d_nrCategories; ++x)
+		{
+			PROTOTYPE_Activation pa;
+			if(!activation(quantizedDiff(kernels, &F1[0], &F1Bytes[0], x), x, pa) ||
+					pa.resonance < d_vigilance - margin)
+				continue;
+			if(d_recheck == 0)
+			{
+				if(best.id < 0 || less(best, pa))
+					best = pa;
+				continue;
+			}
+			// keep the best d_recheck, best first
+			if(nrTop == d_recheck && !less(top[nrTop - 1], pa))
+				continue;
+			int t = nrTop < d_recheck ? nrTop++ : nrTop - 1;
+			for (; t > 0 && less(top[t - 1], pa); --t)
+				top[t] = top[t - 1];
+			top[t] = pa;
+		}
+
+		for (int t = 0; t < nrTop; ++t)
+		{
+			// the float score, as in Art::scoreCategory()
+			int x = top[t].id;
+			ART_TYPE diff = 0;
+			if(d_useInputComplement)
+				diff = kernels.fuzzyMin(&F1[0], d_F2.getRowData(x), d_rowSize, diff);
+			else
+			{
+				diff = kernels.absDiff(&F1[0], d_F2.getRowData(x), d_rowSize, diff);
+				float inputSize = d_nrFeatures;
+				diff = inputSize/(diff+1.0);
+			}
+			PROTOTYPE_Activation pa;
+			if(activation(diff, x, pa) && pa.resonance >= d_vigilance && (best.id < 0 || less(best, pa)))
+				best = pa;
+		}
+
+		winners[n] = best.id;
+		if(resonances != NULL)
+			resonances[n] = best.id < 0 ? 0 : best.resonance;
+	}
+}
+
+QuantizationReport QuantizedArt::compare(const Art &art, const ART_TYPE* inputs, int nrInputs,
+		const int* labels, const std::vector<int>* categoryLabels) const
+{
+	QuantizationReport report;
+	report.nrInputs				= nrInputs;
+	report.agreement			= 0;
+	report.floatAccuracy		= -1;
+	report.quantizedAccuracy	= -1;
+	report.maxResonanceError	= 0;
+	report.meanResonanceError	= 0;
+	report.floatBytes			= (size_t)art.getF2()->size() * art.getF2()->getStride() * sizeof(ART_TYPE);
+	report.quantizedBytes		= getWeightBytes();
+	if(nrInputs <= 0)
+		return report;
+
+	std::vector<int> floatWinners(nrInputs), winners(nrInputs);
+	std::vector<ART_TYPE> floatResonances(nrInputs), resonances(nrInputs);
+	art.classifyBatch(inputs, nrInputs, d_nrFeatures, &floatWinners[0], &floatResonances[0]);
+	classifyBatch(inputs, nrInputs, &winners[0], &resonances[0]);
+
+	int same = 0, floatCorrect = 0, correct = 0;
+	double errorSum = 0;
+	for (int n = 0; n < nrInputs; ++n)
+	{
+		if(floatWinners[n] == winners[n])
+		{
+			++same;
+			ART_TYPE error = fabs(floatResonances[n] - resonances[n]);
+			errorSum += error;
+			report.maxResonanceError = max(report.maxResonanceError, error);
+		}
+		if(labels != NULL && categoryLabels != NULL)
+		{
+			int nrLabels = categoryLabels->size();
+			if(floatWinners[n] >= 0 && floatWinners[n] < nrLabels && (*categoryLabels)[floatWinners[n]] == labels[n])
+				++floatCorrect;
+			if(winners[n] >= 0 && winners[n] < nrLabels && (*categoryLabels)[winners[n]] == labels[n])
+				++correct;
+		}
+	}
+	report.agreement = same / (float)nrInputs;
+	if(same > 0)
+		report.meanResonanceError = errorSum / same;
+	if(labels != NULL && categoryLabels != NULL)
+	{
+		report.floatAccuracy		= floatCorrect / (float)nrInputs;
+		report.quantizedAccuracy	= correct / (float)nrInputs;
+	}
+	return report;
+}
+
+}
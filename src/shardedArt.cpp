@@ -0,0 +1,184 @@
+/*
+ * shardedArt.cpp
+ *
+ * Scatter-gather search of F2 over local worker processes
+ */
+
+#include "shardedArt.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+namespace almendeSensorFusion
+{
+
+ShardedArt::ShardedArt(const Art &art, int nrShards): d_art(art),
+		d_shards(0),
+		d_candidates(0)
+{
+	int nrCategories = art.getF2()->size();
+	if(nrShards < 1)
+		nrShards = 1;
+	for (int s = 0; s < nrShards; ++s)
+	{
+		Shard shard;
+		shard.begin	= (int)(((long long)nrCategories * s) / nrShards);
+		shard.end	= (int)(((long long)nrCategories * (s + 1)) / nrShards);
+
+		int sockets[2];
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+		{
+			printf("Cannot create the socket of ART shard %d.\n", s);
+			stop();
+			return;
+		}
+		shard.pid = fork();
+		if(shard.pid == 0)
+		{
+			// the shard only needs its own socket
+			close(sockets[0]);
+			for (int x = 0; x < (int)d_shards.size(); ++x)
+				close(d_shards[x].socket);
+			serve(art, sockets[1], shard.begin, shard.end);
+			_exit(0);
+		}
+		close(sockets[1]);
+		if(shard.pid < 0)
+		{
+			printf("Cannot start ART shard %d.\n", s);
+			close(sockets[0]);
+			stop();
+			return;
+		}
+		shard.socket = sockets[0];
+		d_shards.push_back(shard);
+	}
+}
+
+ShardedArt::~ShardedArt()
+{
+	stop();
+}
+
+void ShardedArt::stop()
+{
+	Request request;
+	request.nrFeatures	= -1;
+	request.vigilance	= 0;
+	request.k			= 0;
+	for (int s = 0; s < (int)d_shards.size(); ++s)
+	{
+		sendAll(d_shards[s].socket, &request, sizeof(request));
+		close(d_shards[s].socket);
+	}
+	for (int s = 0; s < (int)d_shards.size(); ++s)
+		while(waitpid(d_shards[s].pid, NULL, 0) < 0 && errno == EINTR)
+			;
+	d_shards.clear();
+}
+
+/**
+ * The shard answers every request with the number of candidates followed by the candidates. Its
+ * buffers are reused for every input, like those of the caller.
+ */
+void ShardedArt::serve(const Art &art, int socket, int begin, int end)
+{
+	ArtContext context;
+	std::vector<ART_TYPE> input;
+	std::vector<PROTOTYPE_Activation> candidates;
+	Request request;
+	while(receiveAll(socket, &request, sizeof(request)) && request.nrFeatures >= 0)
+	{
+		input.resize(request.nrFeatures);
+		if(request.nrFeatures > 0 && !receiveAll(socket, &input[0], request.nrFeatures * sizeof(ART_TYPE)))
+			break;
+		candidates.resize(request.k > 0 ? request.k : 1);
+		int n = art.predictRange(input.empty() ? NULL : &input[0], request.nrFeatures, begin, end,
+				request.vigilance, request.k, &candidates[0], context);
+		if(!sendAll(socket, &n, sizeof(n)) || !sendAll(socket, &candidates[0], n * sizeof(PROTOTYPE_Activation)))
+			break;
+	}
+	close(socket);
+}
+
+/**
+ * All shards get the input before any answer is read, so they search at the same time. Each one
+ * sends its best k candidates: the best k of all of them are among those, and the winner first.
+ * After a failed send, or an answer that is cut off or does not fit the request, the streams are
+ * no longer in step with the requests (and without a shard part of F2 is missing), so all shards
+ * are stopped and every later predict() fails.
+ */
+bool ShardedArt::predict(const ART_TYPE* input, int nrFeatures, ArtResult &result)
+{
+	result.clear();
+	if(d_shards.empty())
+		return false;
+
+	Request request;
+	request.nrFeatures	= nrFeatures;
+	request.vigilance	= d_art.getBaseVigilance();
+	request.k			= d_art.getDistributedOutput();
+
+	bool answered = true;
+	for (int s = 0; s < (int)d_shards.size(); ++s)
+		if(!sendAll(d_shards[s].socket, &request, sizeof(request)) ||
+				!sendAll(d_shards[s].socket, input, nrFeatures * sizeof(ART_TYPE)))
+			answered = false;
+
+	d_candidates.resize(d_shards.size() * request.k);
+	int count = 0;
+	for (int s = 0; s < (int)d_shards.size() && answered; ++s)
+	{
+		int n = 0;
+		if(!receiveAll(d_shards[s].socket, &n, sizeof(n)) || n < 0 || n > request.k ||
+				!receiveAll(d_shards[s].socket, &d_candidates[count], n * sizeof(PROTOTYPE_Activation)))
+			answered = false;
+		else
+			count += n;
+	}
+	if(!answered)
+	{
+		printf("An ART shard did not answer, the shards are stopped.\n");
+		stop();
+		return false;
+	}
+	return d_art.predictFrom(count > 0 ? &d_candidates[0] : NULL, count, request.vigilance, result, d_context);
+}
+
+bool ShardedArt::sendAll(int socket, const void* data, size_t bytes)
+{
+	const char* next = (const char*) data;
+	while(bytes > 0)
+	{
+		// a shard that is gone should not kill the caller with SIGPIPE
+		ssize_t sent = send(socket, next, bytes, MSG_NOSIGNAL);
+		if(sent < 0 && errno == EINTR)
+			continue;
+		if(sent <= 0)
+			return false;
+		next += sent;
+		bytes -= sent;
+	}
+	return true;
+}
+
+bool ShardedArt::receiveAll(int socket, void* data, size_t bytes)
+{
+	char* next = (char*) data;
+	while(bytes > 0)
+	{
+		ssize_t received = recv(socket, next, bytes, 0);
+		if(received < 0 && errno == EINTR)
+			continue;
+		if(received <= 0)
+			return false;
+		next += received;
+		bytes -= received;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,159 @@
+/*
+ * workerPool.cpp
+ *
+ * Persistent threads for splitting up the work of one input
+ */
+
+#include "workerPool.h"
+
+#include <map>
+
+namespace almendeSensorFusion
+{
+
+WorkerPool::WorkerPool(int nrThreads): d_threads(0),
+		d_task(NULL),
+		d_context(NULL),
+		d_nrTasks(0),
+		d_nextTask(0),
+		d_busy(0),
+		d_generation(0),
+		d_stop(false)
+{
+	pthread_mutex_init(&d_jobMutex, NULL);
+	pthread_mutex_init(&d_mutex, NULL);
+	pthread_cond_init(&d_start, NULL);
+	pthread_cond_init(&d_done, NULL);
+
+	for (int i = 0; i < nrThreads; ++i)
+	{
+		pthread_t thread;
+		if(pthread_create(&thread, NULL, &WorkerPool::threadMain, this) != 0)
+			break;		// run with fewer threads, the caller always helps
+		d_threads.push_back(thread);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock(&d_mutex);
+	d_stop = true;
+	pthread_cond_broadcast(&d_start);
+	pthread_mutex_unlock(&d_mutex);
+
+	for (int i = 0; i < (int)d_threads.size(); ++i)
+		pthread_join(d_threads[i], NULL);
+
+	pthread_cond_destroy(&d_done);
+	pthread_cond_destroy(&d_start);
+	pthread_mutex_destroy(&d_mutex);
+	pthread_mutex_destroy(&d_jobMutex);
+}
+
+void* WorkerPool::threadMain(void* pool)
+{
+	WorkerPool* self = (WorkerPool*) pool;
+	unsigned seen = 0;
+
+	pthread_mutex_lock(&self->d_mutex);
+	while(true)
+	{
+		while(!self->d_stop && self->d_generation == seen)
+			pthread_cond_wait(&self->d_start, &self->d_mutex);
+		if(self->d_stop)
+			break;
+		seen = self->d_generation;
+		self->work(seen);
+	}
+	pthread_mutex_unlock(&self->d_mutex);
+	return NULL;
+}
+
+/**
+ * Called with d_mutex locked. The tasks are handed out one by one, the lock is released while a
+ * task runs. The last one to finish wakes up the caller of run().
+ */
+void WorkerPool::work(unsigned generation)
+{
+	while(d_generation == generation && d_nextTask < d_nrTasks)
+	{
+		int task = d_nextTask++;
+		++d_busy;
+		pthread_mutex_unlock(&d_mutex);
+
+		d_task(d_context, task);
+
+		pthread_mutex_lock(&d_mutex);
+		if(--d_busy == 0 && d_nextTask >= d_nrTasks)
+			pthread_cond_signal(&d_done);
+	}
+}
+
+void WorkerPool::run(TASK task, void* context, int nrTasks)
+{
+	if(nrTasks <= 0)
+		return;
+	if(d_threads.empty() || nrTasks == 1)
+	{
+		for (int i = 0; i < nrTasks; ++i)
+			task(context, i);
+		return;
+	}
+
+	pthread_mutex_lock(&d_jobMutex);
+	execute(task, context, nrTasks);
+}
+
+bool WorkerPool::tryRun(TASK task, void* context, int nrTasks)
+{
+	if(d_threads.empty() || nrTasks <= 1)
+	{
+		run(task, context, nrTasks);
+		return true;
+	}
+	if(pthread_mutex_trylock(&d_jobMutex) != 0)
+		return false;
+	execute(task, context, nrTasks);
+	return true;
+}
+
+//! The job of run(), with d_jobMutex locked by the caller. It is unlocked when the job is done.
+void WorkerPool::execute(TASK task, void* context, int nrTasks)
+{
+	pthread_mutex_lock(&d_mutex);
+	d_task		= task;
+	d_context	= context;
+	d_nrTasks	= nrTasks;
+	d_nextTask	= 0;
+	d_busy		= 0;
+	++d_generation;
+	pthread_cond_broadcast(&d_start);
+
+	work(d_generation);
+	while(d_busy > 0 || d_nextTask < d_nrTasks)
+		pthread_cond_wait(&d_done, &d_mutex);
+
+	d_task		= NULL;
+	d_context	= NULL;
+	d_nrTasks	= 0;
+	pthread_mutex_unlock(&d_mutex);
+	pthread_mutex_unlock(&d_jobMutex);
+}
+
+WorkerPool* WorkerPool::getShared(int nrThreads)
+{
+	static pthread_mutex_t sharedMutex = PTHREAD_MUTEX_INITIALIZER;
+	static std::map<int, WorkerPool*> pools;
+
+	if(nrThreads < 0)
+		nrThreads = 0;
+
+	pthread_mutex_lock(&sharedMutex);
+	WorkerPool* &pool = pools[nrThreads];
+	if(pool == NULL)
+		pool = new WorkerPool(nrThreads);
+	pthread_mutex_unlock(&sharedMutex);
+	return pool;
+}
+
+}